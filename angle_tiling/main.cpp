@@ -4,8 +4,13 @@
 #include "debug.h"
 #include "misc_utils.h"
 #include "time_utils.h"
+#include "frame_ring.h"
 
 #include <queue>
+#include <cmath>
+
+/* the frames in flight, see frame_ring.h */
+#define FRAME_CNT 2
 
 static auto create_vbuff(auto dev, auto cp, const std::vector<vku_vertex2d_t>& vertices) {
     size_t verts_sz = vertices.size() * sizeof(vertices[0]);
@@ -31,6 +36,75 @@ static auto create_vbuff(auto dev, auto cp, const std::vector<vku_vertex2d_t>& v
     return vbuff;
 }
 
+/* The points already reached, two points closer than eps are the same. The points are hashed by
+the cell of size 2 * eps they fall in, a point closer than eps can then only be in the cell of p or
+in the ones on the sides of the cell p is closest to, 4 cells are looked at instead of all the
+points. The table is open addressing (linear probing) of cell keys, a cell can have many entries. */
+struct point_set_t {
+    static constexpr uint32_t none = -1;
+
+    float eps;
+    std::vector<glm::vec2> points;      /* by id, in the order of insertion */
+    std::vector<uint64_t> keys;         /* by slot, the cell of the point */
+    std::vector<uint32_t> ids;          /* by slot, none for the empty ones */
+
+    point_set_t(float eps) : eps(eps), keys(1024), ids(1024, none) {}
+
+    /* the id of a point closer than eps or none */
+    uint32_t find(glm::vec2 p) const {
+        float fx = p.x / (2 * eps), fy = p.y / (2 * eps);
+        int64_t cx = std::floor(fx), cy = std::floor(fy);
+        int64_t nx = fx - cx < 0.5f ? cx - 1 : cx + 1;
+        int64_t ny = fy - cy < 0.5f ? cy - 1 : cy + 1;
+        for (int64_t y : {cy, ny})
+            for (int64_t x : {cx, nx}) {
+                uint64_t k = key(x, y);
+                for (size_t i = slot(k); ids[i] != none; i = (i + 1) & (ids.size() - 1))
+                    if (keys[i] == k && glm::length(points[ids[i]] - p) < eps)
+                        return ids[i];
+            }
+        return none;
+    }
+
+    /* a new point, find() must not have found it */
+    uint32_t insert(glm::vec2 p) {
+        if (2 * (points.size() + 1) > ids.size())
+            grow();
+        points.push_back(p);
+        put(cell_key(p), points.size() - 1);
+        return points.size() - 1;
+    }
+
+private:
+    uint64_t cell_key(glm::vec2 p) const {
+        return key(std::floor(p.x / (2 * eps)), std::floor(p.y / (2 * eps)));
+    }
+
+    static uint64_t key(int64_t x, int64_t y) { return uint64_t(uint32_t(x)) << 32 | uint32_t(y); }
+
+    size_t slot(uint64_t k) const {
+        k ^= k >> 33;
+        k *= 0xff51afd7ed558ccdull;
+        k ^= k >> 33;
+        return k & (ids.size() - 1);
+    }
+
+    void put(uint64_t k, uint32_t id) {
+        size_t i = slot(k);
+        while (ids[i] != none)
+            i = (i + 1) & (ids.size() - 1);
+        keys[i] = k;
+        ids[i] = id;
+    }
+
+    void grow() {
+        keys.assign(ids.size() * 2, 0);
+        ids.assign(ids.size() * 2, none);
+        for (uint32_t id = 0; id < points.size(); id++)
+            put(cell_key(points[id]), id);
+    }
+};
+
 int main(int argc, char const *argv[])
 {
     DBG_SCOPE();
@@ -47,7 +121,9 @@ int main(int argc, char const *argv[])
         glm::vec3(0, 1, 1), /* cyan */
     };
 
+    /* the colors repeat past the 7th level */
     auto add_line = [&](glm::vec2 a, glm::vec2 b, int color) {
+        color %= std::size(colors);
         vertices.push_back(vku_vertex2d_t{ .pos = a, .color = colors[color] });
         vertices.push_back(vku_vertex2d_t{ .pos = b, .color = colors[color] });
     };
@@ -56,31 +132,39 @@ int main(int argc, char const *argv[])
     float ang_rad = ang_deg / 180. * 3.141592653589;
     float side = 0.25;
     int iter_cnt = 360 / ang_deg;
-    int rec_cnt = 3;
-
-    std::vector<glm::vec2> visited;
-    std::queue<std::pair<glm::vec2, int>> points;
-    points.push({glm::vec2(0, 0), rec_cnt});
+    int rec_cnt = argc > 1 ? atoi(argv[1]) : 3;
+
+    std::vector<glm::vec2> dirs;
+    for (int i = 0; i < iter_cnt; i++)
+        dirs.push_back(glm::vec2(cos(i * ang_rad), sin(i * ang_rad)) * side);
+
+    /* A point is visited when it's queued, so two neighbors can't queue it twice. Each line is
+    drawn once, by the first of it's ends to be expanded: a point draws the lines to the points
+    that are new or still in the queue, the expanded ones already drew theirs. */
+    point_set_t visited(0.00001);
+    std::vector<bool> expanded;
+    std::queue<std::pair<uint32_t, int>> points;
+    points.push({visited.insert(glm::vec2(0, 0)), rec_cnt});
     while (points.size()) {
-        auto [origin, level] = points.front();
-        visited.push_back(origin);
+        auto [id, level] = points.front();
         points.pop();
+        glm::vec2 origin = visited.points[id];
+        expanded.resize(visited.points.size());
+        expanded[id] = true;
+
+        for (auto &dir : dirs) {
+            glm::vec2 new_point = origin + dir;
+            uint32_t new_id = visited.find(new_point);
+            if (new_id != visited.none && expanded[new_id])
+                continue;
 
-        for (int i = 0; i < iter_cnt; i++) {
-            glm::vec2 new_point = origin + glm::vec2(cos(i * ang_rad), sin(i * ang_rad)) * side;
-    
             add_line(origin, new_point, rec_cnt - level);
 
-            bool was_visited = false;
-            for (auto &p : visited)
-                if (glm::length(p - new_point) < 0.00001) {
-                    was_visited = true;
-                    break;
-                }
-            if (level - 1 >= 0 && !was_visited)
-                points.push({new_point, level - 1});
+            if (new_id == visited.none && level - 1 >= 0)
+                points.push({visited.insert(new_point), level - 1});
         }
     }
+    DBG("points: %ld lines: %ld", visited.points.size(), vertices.size() / 2);
 
     vku_opts_t opts;
     auto inst = new vku_instance_t(opts);
@@ -139,11 +223,7 @@ int main(int argc, char const *argv[])
     );
     auto fbs =      new vku_framebuffs_t(rp);
 
-    auto img_sem =  new vku_sem_t(dev);
-    auto draw_sem = new vku_sem_t(dev);
-    auto fence =    new vku_fence_t(dev);
-
-    auto cbuff =    new vku_cmdbuff_t(cp);
+    frame_ring_t frames(cp, FRAME_CNT);
 
     auto vbuff = create_vbuff(dev, cp, vertices);
 
@@ -156,8 +236,10 @@ int main(int argc, char const *argv[])
         glfwPollEvents();
 
         try {
+            auto &frame = frames.begin();
+            auto cbuff = frame.cbuff;
             uint32_t img_idx;
-            vku_aquire_next_img(swc, img_sem, &img_idx);
+            vku_aquire_next_img(swc, frame.img_sem, &img_idx);
 
             cbuff->begin(0);
             cbuff->begin_rpass(fbs, img_idx);
@@ -166,17 +248,13 @@ int main(int argc, char const *argv[])
             cbuff->end_rpass();
             cbuff->end();
 
-            vku_submit_cmdbuff({{img_sem, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT}},
-                    cbuff, fence, {draw_sem});
-            vku_present(swc, {draw_sem}, img_idx);
-
-            vku_wait_fences({fence});
-            vku_reset_fences({fence});
+            vku_present(swc, {frames.submit(img_idx)}, img_idx);
         }
         catch (vku_err_t &e) {
             /* TODO: fix this (next time write what's wrong with it) */
             if (e.vk_err == VK_SUBOPTIMAL_KHR) {
                 vk_device_wait_idle(dev->vk_dev);
+                frames.reset();
 
                 delete swc;
                 swc = new vku_swapchain_t(dev);
@@ -196,6 +274,7 @@ int main(int argc, char const *argv[])
         }
     }
 
+    frames.wait_idle();
     delete inst;
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,117 @@
+#ifndef FRAME_RING_H
+#define FRAME_RING_H
+
+#include "vulkan_utils.h"
+
+/* The per frame objects of a render loop with more than one frame in flight: while the gpu draws
+frame N the cpu already records frame N+1 in another command buffer, it only waits when it comes
+back to a frame that is still being drawn.
+
+    frame_ring_t(cp, frame_cnt) - frame_cnt frames, each with it's command buffer, acquire
+            semaphore and fence
+    begin() - the next frame, it waits for the fence of the last submission of that frame, so it's
+            command buffer and anything else indexed by frame_ctx_t::idx (the regions of an
+            upload_ring_t) can be reused
+    submit(img_idx) - submits the command buffer of the current frame, it waits for the image of
+            the frame to be acquired and returns the semaphore it signals, for vku_present()
+    wait_idle() - waits for all the frames in flight, before changing something they use
+    reset() - after vk_device_wait_idle(), when the swapchain was recreated: the semaphores are
+            remade, an image acquired for a frame that was never submitted would keep img_sem
+            signaled
+
+The semaphores waited on by the present are by swapchain image, not by frame: the present of an
+image is only known to be done with it's semaphore when that image is acquired again, which can be
+after the frame slot comes back, so a semaphore by frame could be signaled again while a present
+still waits on it. They are made the first time an image index is seen.
+
+A loop looks like:
+
+    auto &frame = frames.begin();
+    vku_aquire_next_img(swc, frame.img_sem, &img_idx);
+    frame.cbuff->begin(0);
+    ...
+    frame.cbuff->end();
+    vku_present(swc, {frames.submit(img_idx)}, img_idx);
+*/
+
+struct frame_ctx_t {
+    uint32_t idx;
+    vku_cmdbuff_t *cbuff;
+    vku_sem_t *img_sem;         /* signaled when the swapchain image can be drawn to */
+    vku_fence_t *fence;         /* signaled when the commands are done */
+    bool submitted = false;     /* the fence will be signaled */
+};
+
+struct frame_ring_t {
+    vku_device_t *dev;
+    std::vector<frame_ctx_t> frames;
+    std::vector<vku_sem_t *> present_sems;     /* by swapchain image */
+    uint32_t curr = 0;
+
+    frame_ring_t(vku_cmdpool_t *cp, uint32_t frame_cnt = 2) : dev(cp->dev) {
+        for (uint32_t i = 0; i < frame_cnt; i++)
+            frames.push_back({i, new vku_cmdbuff_t(cp), new vku_sem_t(dev),
+                    new vku_fence_t(dev)});
+        curr = frame_cnt - 1;
+    }
+
+    ~frame_ring_t() {
+        wait_idle();
+        for (auto &f : frames) {
+            delete f.cbuff;
+            delete f.img_sem;
+            delete f.fence;
+        }
+        for (auto sem : present_sems)
+            delete sem;
+    }
+
+    frame_ring_t(const frame_ring_t&) = delete;
+    frame_ring_t& operator = (const frame_ring_t&) = delete;
+
+    uint32_t frame_cnt() const { return frames.size(); }
+
+    frame_ctx_t& begin() {
+        curr = (curr + 1) % frames.size();
+        auto &f = frames[curr];
+        wait(f);
+        return f;
+    }
+
+    vku_sem_t *submit(uint32_t img_idx) {
+        auto &f = frames[curr];
+        while (present_sems.size() <= img_idx)
+            present_sems.push_back(new vku_sem_t(dev));
+        vku_submit_cmdbuff({{f.img_sem, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT}},
+                f.cbuff, f.fence, {present_sems[img_idx]});
+        f.submitted = true;
+        return present_sems[img_idx];
+    }
+
+    void wait_idle() {
+        for (auto &f : frames)
+            wait(f);
+    }
+
+    void reset() {
+        wait_idle();
+        for (auto &f : frames) {
+            delete f.img_sem;
+            f.img_sem = new vku_sem_t(dev);
+        }
+        for (auto sem : present_sems)
+            delete sem;
+        present_sems.clear();
+    }
+
+private:
+    void wait(frame_ctx_t& f) {
+        if (!f.submitted)
+            return;
+        vku_wait_fences({f.fence});
+        vku_reset_fences({f.fence});
+        f.submitted = false;
+    }
+};
+
+#endif
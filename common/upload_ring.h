@@ -0,0 +1,98 @@
+#ifndef UPLOAD_RING_H
+#define UPLOAD_RING_H
+
+#include "vulkan_utils.h"
+
+#include <stdexcept>
+
+/* Per frame memory for the data that changes every frame (uniforms, instances, dynamic vertices).
+It's one region per frame in flight, each a host visible, host coherent buffer that stays mapped,
+so an upload is a memcpy into the region of the current frame, there is no staging buffer and no
+transfer to wait for. Each region is it's own buffer, so a descriptor set can point at the start of
+it (make one set per frame), the sub allocations are for offsets the draws can take (vertex buffer
+offsets, firstInstance).
+
+    upload_ring_t(dev, region_size, frame_cnt, usage) - usage is the VK_BUFFER_USAGE_* of the data
+    begin_frame(frame) - frees all the allocations of the region of frame (frame < frame_cnt), the
+            fence of the last submission that used that region must have been waited on
+    alloc(size, align) - space in the region of the current frame, throws if it's full
+    push(data, size, align) - alloc() and a copy of data into it
+
+A region is only reused frame_cnt frames later, after the fence of the frame that used it, so the
+gpu never reads a region while it's written.
+*/
+
+struct upload_ring_t {
+    struct alloc_t {
+        vku_buffer_t *buff = nullptr;
+        vk_device_size_t offset = 0;
+        void *ptr = nullptr;
+    };
+
+    /* the largest minUniformBufferOffsetAlignment the spec allows, so it's fine for any device */
+    static constexpr vk_device_size_t default_align = 256;
+
+    vk_device_size_t region_size;
+    uint32_t frame_cnt;
+    uint32_t frame = 0;
+    vk_device_size_t used = 0;          /* in the region of the current frame */
+    vk_device_size_t peak_used = 0;     /* the most used in one frame since the start */
+
+    upload_ring_t(vku_device_t *dev, vk_device_size_t region_size, uint32_t frame_cnt,
+            VkBufferUsageFlags usage)
+    : region_size(region_size), frame_cnt(frame_cnt)
+    {
+        for (uint32_t i = 0; i < frame_cnt; i++) {
+            auto buff = new vku_buffer_t(
+                dev,
+                region_size,
+                usage,
+                VK_SHARING_MODE_EXCLUSIVE,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+            );
+            regions.push_back({buff, (uint8_t *)buff->map_data(0, region_size)});
+        }
+    }
+
+    ~upload_ring_t() {
+        for (auto &r : regions) {
+            r.buff->unmap_data();
+            delete r.buff;
+        }
+    }
+
+    upload_ring_t(const upload_ring_t&) = delete;
+    upload_ring_t& operator = (const upload_ring_t&) = delete;
+
+    vku_buffer_t *buffer(uint32_t frame) const { return regions[frame].buff; }
+
+    void begin_frame(uint32_t new_frame) {
+        frame = new_frame;
+        used = 0;
+    }
+
+    alloc_t alloc(vk_device_size_t size, vk_device_size_t align = default_align) {
+        vk_device_size_t offset = (used + align - 1) / align * align;
+        if (offset + size > region_size)
+            throw std::runtime_error("upload ring: the region of the frame is full");
+        used = offset + size;
+        peak_used = std::max(peak_used, used);
+        auto &r = regions[frame];
+        return alloc_t{r.buff, offset, r.ptr + offset};
+    }
+
+    alloc_t push(const void *data, vk_device_size_t size, vk_device_size_t align = default_align) {
+        auto ret = alloc(size, align);
+        memcpy(ret.ptr, data, size);
+        return ret;
+    }
+
+private:
+    struct region_t {
+        vku_buffer_t *buff;
+        uint8_t *ptr;
+    };
+    std::vector<region_t> regions;
+};
+
+#endif
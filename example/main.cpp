@@ -4,10 +4,15 @@
 #include "debug.h"
 #include "misc_utils.h"
 #include "time_utils.h"
+#include "upload_ring.h"
+#include "frame_ring.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+/* the frames in flight, see frame_ring.h */
+#define FRAME_CNT 2
+
 struct part_t {
     glm::vec2 pos;
     glm::vec2 vel;
@@ -161,28 +166,26 @@ int main(int argc, char const *argv[])
     auto view = new vku_img_view_t(img, VK_IMAGE_ASPECT_COLOR_BIT);
     auto sampl = new vku_img_sampl_t(dev);
 
-    auto mvp_buff = new vku_buffer_t(
-        dev,
-        sizeof(mvp),
-        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-        VK_SHARING_MODE_EXCLUSIVE,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-    );
-    auto mvp_pbuff = mvp_buff->map_data(0, sizeof(vku_mvp_t));
-
-    vku_binding_desc_t bindings = {
-        .binds = {
-            vku_binding_desc_t::buff_binding_t::make_bind(
-                vku_ubo_t::get_desc_set(0, VK_SHADER_STAGE_VERTEX_BIT),
-                mvp_buff
-            ),
-            vku_binding_desc_t::sampl_binding_t::make_bind(
-                vku_img_sampl_t::get_desc_set(1, VK_SHADER_STAGE_FRAGMENT_BIT),
-                view,
-                sampl
-            ),
-        },
-    };
+    /* the mvp of a frame is written at the start of the region of the frame, so the gpu never
+    reads a matrix that is being written, each region has it's own descriptor set */
+    upload_ring_t mvp_ring(dev, sizeof(vku_mvp_t), FRAME_CNT, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+
+    std::vector<vku_binding_desc_t> bindings;
+    for (uint32_t i = 0; i < FRAME_CNT; i++) {
+        bindings.push_back({
+            .binds = {
+                vku_binding_desc_t::buff_binding_t::make_bind(
+                    vku_ubo_t::get_desc_set(0, VK_SHADER_STAGE_VERTEX_BIT),
+                    mvp_ring.buffer(i)
+                ),
+                vku_binding_desc_t::sampl_binding_t::make_bind(
+                    vku_img_sampl_t::get_desc_set(1, VK_SHADER_STAGE_FRAGMENT_BIT),
+                    view,
+                    sampl
+                ),
+            },
+        });
+    }
 
     auto sh_vert =  new vku_shader_t(dev, vert);
     auto sh_frag =  new vku_shader_t(dev, frag);
@@ -194,29 +197,23 @@ int main(int argc, char const *argv[])
         {sh_vert, sh_frag},
         VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
         vku_vertex3d_t::get_input_desc(),
-        bindings
+        bindings[0]
     );
     auto fbs =      new vku_framebuffs_t(rp);
 
-    auto img_sem =  new vku_sem_t(dev);
-    auto draw_sem = new vku_sem_t(dev);
-    auto fence =    new vku_fence_t(dev);
-
-    auto cbuff =      new vku_cmdbuff_t(cp);
+    frame_ring_t frames(cp, FRAME_CNT);
 
     auto vbuff = create_vbuff(dev, cp, vertices);
     auto ibuff = create_ibuff(dev, cp, indices);
 
-    auto desc_pool = new vku_desc_pool_t(dev, bindings, 1);
-    auto desc_set = new vku_desc_set_t(desc_pool, pl->vk_desc_set_layout, bindings);
+    std::vector<vku_desc_set_t *> desc_sets;
+    for (auto &b : bindings) {
+        auto desc_pool = new vku_desc_pool_t(dev, b, 1);
+        desc_sets.push_back(new vku_desc_set_t(desc_pool, pl->vk_desc_set_layout, b));
+    }
 
     /* TODO: print a lot more info on vulkan, available extensions, size of memory, etc. */
 
-    /* TODO: the program ever only draws on one image and waits on the fence, we need to use
-    at least two images to speed up the draw process */
-    // std::map<uint32_t, vku_sem_t *> img_sems;
-    // std::map<uint32_t, vku_sem_t *> draw_sems;
-    // std::map<uint32_t, vku_fence_t *> fences;
     double start_time = get_time_ms();
    
     DBG("Starting main loop"); 
@@ -226,8 +223,10 @@ int main(int argc, char const *argv[])
         glfwPollEvents();
 
         try {
+            auto &frame = frames.begin();
+            auto cbuff = frame.cbuff;
             uint32_t img_idx;
-            vku_aquire_next_img(swc, img_sem, &img_idx);
+            vku_aquire_next_img(swc, frame.img_sem, &img_idx);
 
             float curr_time = ((double)get_time_ms() - start_time)/100000.;
             curr_time *= 100;
@@ -238,28 +237,26 @@ int main(int argc, char const *argv[])
             mvp.proj = glm::perspective(glm::radians(45.0f),
                     swc->vk_extent.width / (float)swc->vk_extent.height, 0.1f, 10.0f);
             mvp.proj[1][1] *= -1;
-            memcpy(mvp_pbuff, &mvp, sizeof(mvp));
+            mvp_ring.begin_frame(frame.idx);
+            mvp_ring.push(&mvp, sizeof(mvp));
 
             cbuff->begin(0);
             cbuff->begin_rpass(fbs, img_idx);
             cbuff->bind_vert_buffs(0, {{vbuff, 0}});
             cbuff->bind_idx_buff(ibuff, 0, VK_INDEX_TYPE_UINT16);
-            cbuff->bind_desc_set(VK_PIPELINE_BIND_POINT_GRAPHICS, pl->vk_layout, desc_set);
+            cbuff->bind_desc_set(VK_PIPELINE_BIND_POINT_GRAPHICS, pl->vk_layout,
+                    desc_sets[frame.idx]);
             cbuff->draw_idx(pl, indices.size());
             cbuff->end_rpass();
             cbuff->end();
 
-            vku_submit_cmdbuff({{img_sem, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT}},
-                    cbuff, fence, {draw_sem});
-            vku_present(swc, {draw_sem}, img_idx);
-
-            vku_wait_fences({fence});
-            vku_reset_fences({fence});
+            vku_present(swc, {frames.submit(img_idx)}, img_idx);
         }
         catch (vku_err_t &e) {
             /* TODO: fix this (next time write what's wrong with it) */
             if (e.vk_err == VK_SUBOPTIMAL_KHR) {
                 vk_device_wait_idle(dev->vk_dev);
+                frames.reset();
 
                 delete swc;
                 swc = new vku_swapchain_t(dev);
@@ -270,7 +267,7 @@ int main(int argc, char const *argv[])
                     {sh_vert, sh_frag},
                     VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
                     vku_vertex3d_t::get_input_desc(),
-                    bindings
+                    bindings[0]
                 );
                 fbs = new vku_framebuffs_t(rp);
             }
@@ -279,6 +276,7 @@ int main(int argc, char const *argv[])
         }
     }
 
+    frames.wait_idle();
     delete inst;
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,221 @@
+#ifndef ANY_ANGLE_H
+#define ANY_ANGLE_H
+
+#include "path_finding.h"
+
+/* Any-angle paths over a matrix_graph_wraper_t in the uniform cost mode: instead of a node for each
+cell, the paths are short lists of waypoints joined by straight lines that only cross free cells,
+so a unit can move along them at any angle instead of zig-zagging from cell to cell.
+
+    line_of_sight(grid, a, b) - true if the segment between the centers of the cells a and b only
+            crosses free cells. A segment that goes exactly through the corner of four cells needs
+            both cells beside the corner to be free, like a diagonal move of the graph.
+    smooth_path(grid, path) - removes from a cell path (a_star_path, jps) every node that can be
+            skipped with a straight line, greedily from the goal
+    theta_star_t - Theta* (Nash, Daniel, Koenig and Felner): A* where a node takes the parent of
+            it's parent when it can see it, so the paths are any-angle while they are searched
+    waypoint_walker_t - moves a point at constant speed along a path of waypoints
+
+The paths are in the format of a_star_path (goal to start) and their cost is the euclidean length.
+Neither is guaranteed to be the shortest any-angle path, but both are close and much shorter than
+the grid paths.
+*/
+
+/* walks the cells crossed by the segment, a step in x is taken when the segment crosses a vertical
+cell border before a horizontal one: at t = (2i + 1) / 2dx against t = (2j + 1) / 2dy */
+inline bool line_of_sight(const passable_grid_t& grid, int32_t x0, int32_t y0, int32_t x1,
+        int32_t y1)
+{
+    int64_t dx = std::abs(x1 - x0), dy = std::abs(y1 - y0);
+    int32_t sx = x1 > x0 ? 1 : -1, sy = y1 > y0 ? 1 : -1;
+    int32_t step_x = sx, step_y = sy * grid.stride;
+    uint32_t idx = grid.index(x0, y0);
+    if (!grid.is_free(idx))
+        return false;
+
+    int64_t i = 0, j = 0;
+    while (i < dx || j < dy) {
+        int64_t tx = (2 * i + 1) * dy, ty = (2 * j + 1) * dx;
+        if (tx < ty) {
+            idx += step_x;
+            i++;
+        }
+        else if (tx > ty) {
+            idx += step_y;
+            j++;
+        }
+        else {
+            if (!grid.is_free(idx + step_x) || !grid.is_free(idx + step_y))
+                return false;
+            idx += step_x + step_y;
+            i++;
+            j++;
+        }
+        if (!grid.is_free(idx))
+            return false;
+    }
+    return true;
+}
+
+template <typename node_t>
+bool line_of_sight(const passable_grid_t& grid, const node_t& a, const node_t& b) {
+    return line_of_sight(grid, a.x, a.y, b.x, b.y);
+}
+
+template <typename node_t>
+std::vector<node_t> smooth_path(const passable_grid_t& grid, const std::vector<node_t>& path) {
+    if (path.size() < 3)
+        return path;
+    std::vector<node_t> ret{path[0]};
+    size_t anchor = 0;
+    for (size_t i = 1; i < path.size() - 1; i++) {
+        if (!line_of_sight(grid, path[anchor], path[i + 1])) {
+            ret.push_back(path[i]);
+            anchor = i;
+        }
+    }
+    ret.push_back(path.back());
+    return ret;
+}
+
+template <typename node_t>
+double path_length(const std::vector<node_t>& path) {
+    double ret = 0;
+    for (size_t i = 1; i < path.size(); i++)
+        ret += std::hypot(path[i].x - path[i - 1].x, path[i].y - path[i - 1].y);
+    return ret;
+}
+
+template <typename graph_t>
+struct theta_star_t {
+    using node_t = typename graph_t::node_t;
+    using cost_t = typename graph_t::cost_t;
+
+    static_assert(graph_t::uniform_cost, "any-angle paths need PATH_FINDING_FLAG_UNIFORM_COST");
+    static constexpr bool diag = graph_t::neigh_cnt == 8;
+    static constexpr uint32_t invalid_idx = grid_search_ctx_t<cost_t>::invalid_idx;
+
+    passable_grid_t grid;
+    grid_search_ctx_t<cost_t> ctx;
+    uint64_t expanded = 0;
+    uint64_t los_checks = 0;
+
+    /* the grid is a copy of the walls, call it again after the map changes */
+    void build(const graph_t& graph) { grid.build(graph); }
+
+    std::vector<node_t> path(const node_t& start, const node_t& goal) {
+        expanded = 0;
+        los_checks = 0;
+        uint32_t start_idx = grid.index(start.x, start.y);
+        uint32_t goal_idx = grid.index(goal.x, goal.y);
+        if (!grid.is_free(start_idx) || !grid.is_free(goal_idx))
+            return {};
+
+        auto dist = [&](uint32_t a, uint32_t b) {
+            return cost_t(std::hypot(grid.x_of(a) - grid.x_of(b), grid.y_of(a) - grid.y_of(b)));
+        };
+
+        ctx.begin(grid.cells.size());
+        heap_open_set_t<cost_t> open_set(ctx.open_set);
+        ctx.set_score(start_idx, cost_t{0}, invalid_idx);
+        open_set.push(start_idx, dist(start_idx, goal_idx));
+
+        static constexpr std::array<std::array<int32_t, 2>, 8> dirs{{
+            {1, 0}, {-1, 0}, {0, 1}, {0, -1}, {1, 1}, {1, -1}, {-1, 1}, {-1, -1}
+        }};
+        const cost_t diag_cost = cost_t(sqrt(2));
+
+        while (!open_set.empty()) {
+            uint32_t curr = open_set.pop();
+            if (ctx.is_closed(curr))
+                continue;
+            ctx.closed[curr] = ctx.generation;
+            expanded++;
+
+            if (curr == goal_idx) {
+                std::vector<node_t> ret;
+                for (uint32_t idx = curr; idx != invalid_idx; idx = ctx.node_prev[idx])
+                    ret.push_back(node_t{grid.x_of(idx), grid.y_of(idx)});
+                return ret;
+            }
+
+            uint32_t parent = ctx.node_prev[curr];
+            for (int d = 0; d < (diag ? 8 : 4); d++) {
+                int32_t step_x = dirs[d][0], step_y = dirs[d][1] * grid.stride;
+                uint32_t neigh = curr + step_x + step_y;
+                if (!grid.is_free(neigh) || ctx.is_closed(neigh))
+                    continue;
+                bool is_diag = d >= 4;
+                if (is_diag && (!grid.is_free(curr + step_x) || !grid.is_free(curr + step_y)))
+                    continue;
+
+                /* path 2: straight from the parent of curr, if it can see the neighbor */
+                cost_t score;
+                uint32_t prev;
+                los_checks += parent != invalid_idx;
+                if (parent != invalid_idx && line_of_sight(grid, grid.x_of(parent),
+                        grid.y_of(parent), grid.x_of(neigh), grid.y_of(neigh)))
+                {
+                    score = ctx.g_score[parent] + dist(parent, neigh);
+                    prev = parent;
+                }
+                else {
+                    score = ctx.g_score[curr] + (is_diag ? diag_cost : cost_t(1));
+                    prev = curr;
+                }
+                if (!ctx.has_score(neigh) || score < ctx.g_score[neigh]) {
+                    ctx.set_score(neigh, score, prev);
+                    open_set.push(neigh, score + dist(neigh, goal_idx));
+                }
+            }
+        }
+        return {};
+    }
+};
+
+/* Follows a path in the a_star_path format (goal to start), from the start, with a cursor on the
+current segment, so each advance() costs O(1) unless a lot of short segments are crossed at once.
+At the end of the path it starts again from the start, like the units of the viewer. */
+template <typename node_t>
+struct waypoint_walker_t {
+    const std::vector<node_t> *path = nullptr;
+    size_t seg = 0;                 /* from path[size - 1 - seg] to path[size - 2 - seg] */
+    double along = 0;               /* the distance already walked on the segment */
+
+    float x = 0, y = 0;
+    float angle = 0;                /* of the current segment, in radians */
+
+    void reset(const std::vector<node_t>& new_path) {
+        path = &new_path;
+        seg = 0;
+        along = 0;
+        advance(0);
+    }
+
+    void advance(double dist) {
+        auto &p = *path;
+        if (p.size() < 2) {
+            if (p.size()) {
+                x = p[0].x;
+                y = p[0].y;
+            }
+            return;
+        }
+        along += dist;
+        while (true) {
+            auto &a = p[p.size() - 1 - seg], &b = p[p.size() - 2 - seg];
+            double len = std::hypot(b.x - a.x, b.y - a.y);
+            if (along <= len) {
+                double t = len > 0 ? along / len : 0;
+                x = a.x + (b.x - a.x) * t;
+                y = a.y + (b.y - a.y) * t;
+                angle = std::atan2(b.y - a.y, b.x - a.x);
+                return;
+            }
+            along -= len;
+            seg = (seg + 1) % (p.size() - 1);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,837 @@
+#define LOGGER_VERBOSE_LVL 0
+
+#include "debug.h"
+#include "misc_utils.h"
+#include "path_finding.h"
+#include "jump_point.h"
+#include "hpa_star.h"
+#include "path_batch.h"
+#include "flow_field.h"
+#include "dstar_lite.h"
+#include "components.h"
+#include "terrain_grid.h"
+#include "map_file.h"
+#include "scenario.h"
+#include "sliced_search.h"
+#include "path_service.h"
+#include "grid_kernel.h"
+#include "hda_star.h"
+#include "csr_graph.h"
+#include "any_angle.h"
+#include "unit_sim.h"
+
+#include <chrono>
+#include <random>
+
+/* Headless benchmark for the path finding code, it doesn't need a window or a vulkan device.
+    usage: ./bench.out [map_size] [query_cnt] - the micro benchmarks of this file
+           ./bench.out suite [query_cnt] [sizes...] - all the search modes on generated maps
+           ./bench.out scen <file.scen> [file.map] [query_cnt] - all the search modes on a MovingAI
+                   scenario, the map is looked for next to the .scen file if it's not given
+           ./bench.out check - the correctness checks of check.cpp, exits with 1 if one fails
+The output is one line of key=value pairs per result, see suite.cpp for the suite ones. */
+
+using terrain_t = std::vector<std::vector<double>>;
+
+static double get_time_s() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+static terrain_t gen_random_map(int size, double wall_ratio, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> dist(0, 1);
+    terrain_t map(size, std::vector<double>(size));
+    for (auto &line : map)
+        for (auto &cell : line)
+            cell = dist(rng) < wall_ratio ? 100000 : 1;
+    return map;
+}
+
+/* expands every cell of the map once, with the old allocating neighbors() and with the visitor */
+template <size_t graph_flags>
+static void bench_neighbors(terrain_t& map, int size) {
+    using graph_t = matrix_graph_wraper_t<graph_flags, terrain_t>;
+    graph_t graph(map, size, size);
+    const int rounds = 4;
+
+    double sum_vec = 0;
+    double t0 = get_time_s();
+    for (int r = 0; r < rounds; r++)
+        for (int i = 0; i < size; i++)
+            for (int j = 0; j < size; j++)
+                for (auto &[neigh, cost] : graph.neighbors({j, i}))
+                    sum_vec += cost;
+    double t1 = get_time_s();
+
+    double sum_visit = 0;
+    for (int r = 0; r < rounds; r++)
+        for (int i = 0; i < size; i++)
+            for (int j = 0; j < size; j++)
+                graph.for_each_neighbor({j, i}, [&](const auto&, auto cost) {
+                    sum_visit += cost;
+                });
+    double t2 = get_time_s();
+
+    double expansions = double(rounds) * size * size;
+    printf("bench=neighbors neigh_cnt=%d mode=vector expansions_per_s=%.0f checksum=%.0f\n",
+            graph_t::neigh_cnt, expansions / (t1 - t0), sum_vec);
+    printf("bench=neighbors neigh_cnt=%d mode=visitor expansions_per_s=%.0f checksum=%.0f\n",
+            graph_t::neigh_cnt, expansions / (t2 - t1), sum_visit);
+}
+
+/* full queries, map based a_star_path against the dense grid_a_star_path */
+template <size_t graph_flags>
+static void bench_queries(terrain_t& map, int size, int query_cnt) {
+    using graph_t = matrix_graph_wraper_t<graph_flags, terrain_t>;
+    using node_t = typename graph_t::node_t;
+    using cost_t = typename graph_t::cost_t;
+    graph_t graph(map, size, size);
+
+    std::mt19937 rng(1234);
+    std::vector<std::pair<node_t, node_t>> queries;
+    for (int i = 0; i < query_cnt; i++)
+        queries.push_back({
+            node_t{int32_t(rng() % size), int32_t(rng() % size)},
+            node_t{int32_t(rng() % size), int32_t(rng() % size)}
+        });
+
+    size_t len_map = 0;
+    double t0 = get_time_s();
+    for (auto &[start, goal] : queries)
+        len_map += a_star_path<typename graph_t::heuristic_t, cost_t>(
+                graph, start, goal, graph.get_heuristic(goal)).size();
+    double t1 = get_time_s();
+
+    size_t len_grid = 0;
+    grid_search_ctx_t<cost_t> ctx;
+    for (auto &[start, goal] : queries)
+        len_grid += grid_a_star_path<typename graph_t::heuristic_t, cost_t>(
+                ctx, graph, start, goal, graph.get_heuristic(goal)).size();
+    double t2 = get_time_s();
+
+    size_t len_kernel = 0;
+    kernel_a_star_t<graph_t> kernel;
+    kernel.build(graph);
+    double t3 = get_time_s();
+    for (auto &[start, goal] : queries)
+        len_kernel += kernel.path(start, goal).size();
+    double t4 = get_time_s();
+
+    printf("bench=queries neigh_cnt=%d mode=map queries_per_s=%.2f path_nodes=%ld\n",
+            graph_t::neigh_cnt, query_cnt / (t1 - t0), len_map);
+    printf("bench=queries neigh_cnt=%d mode=grid queries_per_s=%.2f path_nodes=%ld\n",
+            graph_t::neigh_cnt, query_cnt / (t2 - t1), len_grid);
+    printf("bench=queries neigh_cnt=%d mode=kernel queries_per_s=%.2f path_nodes=%ld "
+            "build_s=%.4f\n", graph_t::neigh_cnt, query_cnt / (t4 - t3), len_kernel, t3 - t2);
+}
+
+/* the counters of search_stats.h summed over the queries, only with make STATS=1 */
+template <size_t graph_flags>
+static void bench_stats(terrain_t& map, int size, int query_cnt) {
+    using graph_t = matrix_graph_wraper_t<graph_flags, terrain_t>;
+    using node_t = typename graph_t::node_t;
+    using cost_t = typename graph_t::cost_t;
+    if (!search_stats_t::enabled)
+        return;
+    graph_t graph(map, size, size);
+
+    std::mt19937 rng(1234);
+    grid_search_ctx_t<cost_t> ctx;
+    uint64_t expanded = 0, pushes = 0, repushes = 0, stale_pops = 0, peak_open = 0;
+    double neigh_s = 0, queue_s = 0;
+    for (int i = 0; i < query_cnt; i++) {
+        node_t start{int32_t(rng() % size), int32_t(rng() % size)};
+        node_t goal{int32_t(rng() % size), int32_t(rng() % size)};
+        grid_a_star_path<typename graph_t::heuristic_t, cost_t>(ctx, graph, start, goal,
+                graph.get_heuristic(goal));
+        auto &st = ctx.stats;
+        expanded += st.expanded;
+        pushes += st.pushes;
+        repushes += st.repushes;
+        stale_pops += st.stale_pops;
+        peak_open = std::max(peak_open, st.peak_open);
+        neigh_s += st.neigh_s;
+        queue_s += st.queue_s;
+    }
+
+    printf("bench=stats neigh_cnt=%d queries=%d expanded=%ld pushes=%ld repushes=%ld "
+            "stale_pops=%ld peak_open=%ld neigh_s=%.4f queue_s=%.4f\n", graph_t::neigh_cnt,
+            query_cnt, expanded, pushes, repushes, stale_pops, peak_open, neigh_s, queue_s);
+}
+
+/* uniform cost queries, grid_a_star_path against the jump point search */
+template <size_t graph_flags>
+static void bench_jps(terrain_t& map, int size, int query_cnt) {
+    using graph_t = matrix_graph_wraper_t<graph_flags | PATH_FINDING_FLAG_UNIFORM_COST, terrain_t>;
+    using node_t = typename graph_t::node_t;
+    using cost_t = typename graph_t::cost_t;
+    graph_t graph(map, size, size);
+
+    std::mt19937 rng(1234);
+    std::vector<std::pair<node_t, node_t>> queries;
+    while (queries.size() < size_t(query_cnt)) {
+        node_t start{int32_t(rng() % size), int32_t(rng() % size)};
+        node_t goal{int32_t(rng() % size), int32_t(rng() % size)};
+        if (graph.passable(start.x, start.y) && graph.passable(goal.x, goal.y))
+            queries.push_back({start, goal});
+    }
+
+    size_t len_grid = 0;
+    uint64_t expanded_grid = 0;
+    grid_search_ctx_t<cost_t> ctx;
+    double t0 = get_time_s();
+    for (auto &[start, goal] : queries) {
+        len_grid += grid_a_star_path<typename graph_t::heuristic_t, cost_t>(
+                ctx, graph, start, goal, graph.get_heuristic(goal)).size();
+        expanded_grid += std::count(ctx.closed.begin(), ctx.closed.end(), ctx.generation);
+    }
+    double t1 = get_time_s();
+
+    jps_search_t<graph_t> jps;
+    jps.build(graph);
+    double t2 = get_time_s();
+
+    size_t len_jps = 0;
+    uint64_t expanded_jps = 0;
+    for (auto &[start, goal] : queries) {
+        len_jps += jps.path(start, goal).size();
+        expanded_jps += jps.expanded;
+    }
+    double t3 = get_time_s();
+
+    hpa_graph_t<graph_t> hpa(graph);
+    double t4 = get_time_s();
+    hpa.build();
+    double t5 = get_time_s();
+
+    size_t len_hpa = 0;
+    uint64_t expanded_hpa = 0;
+    for (auto &[start, goal] : queries) {
+        len_hpa += hpa.path(start, goal).size();
+        expanded_hpa += hpa.expanded;
+    }
+    double t6 = get_time_s();
+
+    /* a few walls change in one place, only the clusters around them are rebuilt */
+    std::vector<node_t> changed;
+    for (int32_t i = 0; i < 8; i++) {
+        node_t cell{size / 2 + i, size / 2};
+        map[cell.y][cell.x] = map[cell.y][cell.x] < PATH_FINDING_WALL_VALUE ?
+                PATH_FINDING_WALL_VALUE : 1;
+        changed.push_back(cell);
+    }
+    double t7 = get_time_s();
+    hpa.update_cells(changed);
+    double t8 = get_time_s();
+    for (auto &cell : changed)
+        map[cell.y][cell.x] = map[cell.y][cell.x] < PATH_FINDING_WALL_VALUE ?
+                PATH_FINDING_WALL_VALUE : 1;
+
+    printf("bench=uniform neigh_cnt=%d mode=grid queries_per_s=%.2f expanded=%ld path_nodes=%ld\n",
+            graph_t::neigh_cnt, query_cnt / (t1 - t0), expanded_grid, len_grid);
+    printf("bench=uniform neigh_cnt=%d mode=jps queries_per_s=%.2f expanded=%ld path_nodes=%ld "
+            "build_s=%.4f\n", graph_t::neigh_cnt, query_cnt / (t3 - t2), expanded_jps, len_jps,
+            t2 - t1);
+    printf("bench=uniform neigh_cnt=%d mode=hpa queries_per_s=%.2f expanded=%ld path_nodes=%ld "
+            "build_s=%.4f update_s=%.6f\n", graph_t::neigh_cnt, query_cnt / (t6 - t5),
+            expanded_hpa, len_hpa, t5 - t4, t8 - t7);
+}
+
+/* the same batch of queries solved with a growing number of threads */
+template <size_t graph_flags>
+static void bench_batch(terrain_t& map, int size, int query_cnt) {
+    using graph_t = matrix_graph_wraper_t<graph_flags | PATH_FINDING_FLAG_UNIFORM_COST, terrain_t>;
+    using batch_t = path_batch_t<graph_t>;
+    graph_t graph(map, size, size);
+
+    std::mt19937 rng(4321);
+    std::vector<typename batch_t::query_t> queries;
+    for (int i = 0; i < query_cnt; i++)
+        queries.push_back({
+            {int32_t(rng() % size), int32_t(rng() % size)},
+            {int32_t(rng() % size), int32_t(rng() % size)}
+        });
+
+    uint32_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<uint32_t> thread_cnts;
+    for (uint32_t thread_cnt = 1; thread_cnt < max_threads; thread_cnt *= 2)
+        thread_cnts.push_back(thread_cnt);
+    thread_cnts.push_back(max_threads);
+
+    for (auto thread_cnt : thread_cnts) {
+        batch_t batch(graph, thread_cnt);
+        double t0 = get_time_s();
+        auto result = batch.solve(queries);
+        double t1 = get_time_s();
+        printf("bench=batch neigh_cnt=%d threads=%d queries_per_s=%.2f path_nodes=%ld\n",
+                graph_t::neigh_cnt, thread_cnt, query_cnt / (t1 - t0), result.nodes.size());
+    }
+}
+
+/* many units going to the same goal: one a_star_path per unit against a single flow field */
+template <size_t graph_flags>
+static void bench_flow(terrain_t& map, int size, int unit_cnt) {
+    using graph_t = matrix_graph_wraper_t<graph_flags | PATH_FINDING_FLAG_UNIFORM_COST, terrain_t>;
+    using node_t = typename graph_t::node_t;
+    using cost_t = typename graph_t::cost_t;
+    graph_t graph(map, size, size);
+
+    std::mt19937 rng(777);
+    auto rand_free = [&] {
+        while (true) {
+            node_t n{int32_t(rng() % size), int32_t(rng() % size)};
+            if (graph.passable(n.x, n.y))
+                return n;
+        }
+    };
+    node_t goal = rand_free();
+    std::vector<node_t> units;
+    for (int i = 0; i < unit_cnt; i++)
+        units.push_back(rand_free());
+
+    grid_search_ctx_t<cost_t> ctx;
+    size_t len_a_star = 0;
+    double t0 = get_time_s();
+    for (auto &unit : units)
+        len_a_star += grid_a_star_path<typename graph_t::heuristic_t, cost_t>(
+                ctx, graph, unit, goal, graph.get_heuristic(goal)).size();
+    double t1 = get_time_s();
+
+    flow_field_cache_t<graph_t> cache(graph);
+    auto field = cache.get(goal);
+    double t2 = get_time_s();
+    size_t len_flow = 0;
+    for (auto unit : units) {
+        if (field->cost(unit) == field->inf)
+            continue;
+        for (len_flow++; !(unit == goal); len_flow++)
+            unit = field->next(unit);
+    }
+    double t3 = get_time_s();
+    cache.get(goal);
+    double t4 = get_time_s();
+
+    printf("bench=flow neigh_cnt=%d units=%d a_star_s=%.4f a_star_len=%ld field_s=%.4f "
+            "passes=%d walk_s=%.4f flow_len=%ld cached_s=%.6f\n", graph_t::neigh_cnt, unit_cnt,
+            t1 - t0, len_a_star, t2 - t1, field->passes, t3 - t2, len_flow, t4 - t3);
+}
+
+/* a unit walking to it's goal while walls appear and disappear around it's path, replanned with
+D* Lite and with a new A* after each change */
+template <size_t graph_flags>
+static void bench_dstar(terrain_t map, int size, int step_cnt) {
+    using graph_t = matrix_graph_wraper_t<graph_flags | PATH_FINDING_FLAG_UNIFORM_COST, terrain_t>;
+    using node_t = typename graph_t::node_t;
+    using cost_t = typename graph_t::cost_t;
+    using planner_t = dstar_lite_t<graph_t>;
+    graph_t graph(map, size, size);
+
+    std::mt19937 rng(999);
+    node_t start{0, 0}, goal{size - 1, size - 1};
+    map[start.y][start.x] = map[goal.y][goal.x] = 1;
+
+    planner_t planner(graph);
+    grid_search_ctx_t<cost_t> ctx;
+    double t0 = get_time_s();
+    planner.plan(start, goal);
+    auto path = planner.path();
+    double t1 = get_time_s();
+    uint64_t plan_expanded = planner.expanded;
+
+    double dstar_s = 0, a_star_s = 0;
+    for (int i = 0; i < step_cnt && path.size() > 2; i++) {
+        planner.move_start(path[path.size() - 2]);
+
+        /* toggles a few cells close to the remaining path */
+        std::vector<typename planner_t::cell_update_t> updates;
+        for (int j = 0; j < 4; j++) {
+            auto n = path[rng() % path.size()];
+            n.x = std::clamp<int32_t>(n.x + int32_t(rng() % 5) - 2, 0, size - 1);
+            n.y = std::clamp<int32_t>(n.y + int32_t(rng() % 5) - 2, 0, size - 1);
+            if (n == planner.start || n == goal)
+                continue;
+            updates.push_back({n, graph.passable(n.x, n.y) ? PATH_FINDING_WALL_VALUE : 1.});
+        }
+
+        double t2 = get_time_s();
+        planner.update_cells(updates);
+        path = planner.path();
+        double t3 = get_time_s();
+        auto a_star = grid_a_star_path<typename graph_t::heuristic_t, cost_t>(
+                ctx, graph, planner.start, goal, graph.get_heuristic(goal));
+        double t4 = get_time_s();
+        dstar_s += t3 - t2;
+        a_star_s += t4 - t3;
+    }
+
+    printf("bench=dstar neigh_cnt=%d plan_s=%.4f plan_expanded=%ld replan_expanded=%ld "
+            "replan_s=%.4f a_star_s=%.4f\n", graph_t::neigh_cnt, t1 - t0, plan_expanded,
+            planner.expanded - plan_expanded, dstar_s, a_star_s);
+}
+
+/* the same queries with each of the open sets of open_set.h */
+template <size_t graph_flags, typename open_set_t>
+static void bench_open_set(terrain_t& map, int size, int query_cnt, const char *name,
+        open_set_t open_set)
+{
+    using graph_t = matrix_graph_wraper_t<graph_flags | PATH_FINDING_FLAG_UNIFORM_COST, terrain_t>;
+    using cost_t = typename graph_t::cost_t;
+    graph_t graph(map, size, size);
+
+    std::mt19937 rng(2468);
+    grid_search_ctx_t<cost_t> ctx;
+    size_t path_len = 0;
+    double t0 = get_time_s();
+    for (int i = 0; i < query_cnt; i++) {
+        typename graph_t::node_t start{int32_t(rng() % size), int32_t(rng() % size)};
+        typename graph_t::node_t goal{int32_t(rng() % size), int32_t(rng() % size)};
+        path_len += grid_a_star_path<typename graph_t::heuristic_t, cost_t>(
+                ctx, open_set, graph, start, goal, graph.get_heuristic(goal)).size();
+    }
+    double t1 = get_time_s();
+    printf("bench=open_set neigh_cnt=%d open_set=%s queries_per_s=%.2f path_len=%ld\n",
+            graph_t::neigh_cnt, name, query_cnt / (t1 - t0), path_len);
+}
+
+template <size_t graph_flags>
+static void bench_open_sets(terrain_t& map, int size, int query_cnt) {
+    using cost_t = float;
+    bench_open_set<graph_flags>(map, size, query_cnt, "heap", heap_open_set_t<cost_t>{});
+    bench_open_set<graph_flags>(map, size, query_cnt, "indexed_heap",
+            indexed_heap_open_set_t<cost_t>{});
+    bench_open_set<graph_flags>(map, size, query_cnt, "radix", radix_heap_open_set_t<cost_t>{});
+    bench_open_set<graph_flags>(map, size, query_cnt, "bucket", bucket_open_set_t<cost_t>{});
+}
+
+/* the same queries on the nested vectors of doubles and on a terrain_grid_t of bytes */
+template <size_t graph_flags>
+static void bench_terrain(terrain_t& map, int size, int query_cnt) {
+    terrain_grid_t<uint8_t> grid(size, size, 1, 255);
+    for (int y = 0; y < size; y++)
+        for (int x = 0; x < size; x++)
+            grid[y][x] = map[y][x] < PATH_FINDING_WALL_VALUE ? 1 : 255;
+    grid.build_obstacles(255);
+
+    auto run = [&](auto& terrain, double wall_value, const char *name, size_t bytes) {
+        using graph_t = matrix_graph_wraper_t<graph_flags | PATH_FINDING_FLAG_UNIFORM_COST,
+                std::remove_reference_t<decltype(terrain)>>;
+        using cost_t = typename graph_t::cost_t;
+        graph_t graph(terrain, size, size, wall_value);
+
+        std::mt19937 rng(1357);
+        grid_search_ctx_t<cost_t> ctx;
+        size_t path_len = 0;
+        double t0 = get_time_s();
+        for (int i = 0; i < query_cnt; i++) {
+            typename graph_t::node_t start{int32_t(rng() % size), int32_t(rng() % size)};
+            typename graph_t::node_t goal{int32_t(rng() % size), int32_t(rng() % size)};
+            path_len += grid_a_star_path<typename graph_t::heuristic_t, cost_t>(
+                    ctx, graph, start, goal, graph.get_heuristic(goal)).size();
+        }
+        double t1 = get_time_s();
+        printf("bench=terrain neigh_cnt=%d terrain=%s bytes=%ld queries_per_s=%.2f path_len=%ld\n",
+                graph_t::neigh_cnt, name, bytes, query_cnt / (t1 - t0), path_len);
+    };
+
+    size_t nested_bytes = sizeof(map) + map.size() * (sizeof(map[0]) + size * sizeof(double));
+    run(map, PATH_FINDING_WALL_VALUE, "nested_double", nested_bytes);
+    run(grid, 255, "grid_u8", grid.memory_bytes());
+}
+
+/* building the terrain and the hpa graph against loading them from a map file */
+static void bench_map_file(terrain_t& map, int size) {
+    using graph_t = matrix_graph_wraper_t<PATH_FINDING_FLAG_UNIFORM_COST, terrain_grid_t<uint8_t>>;
+    std::string path = "/tmp/bench_map.pfmap";
+
+    double t0 = get_time_s();
+    terrain_grid_t<uint8_t> grid(size, size, 1, TERRAIN_WALL);
+    for (int y = 0; y < size; y++)
+        for (int x = 0; x < size; x++)
+            grid[y][x] = map[y][x] < PATH_FINDING_WALL_VALUE ? 1 : TERRAIN_WALL;
+    grid.build_obstacles(TERRAIN_WALL);
+    graph_t graph(grid, size, size, TERRAIN_WALL);
+    hpa_graph_t<graph_t> hpa(graph);
+    hpa.build();
+    double t1 = get_time_s();
+
+    map_file_writer_t writer(grid, TERRAIN_WALL);
+    grid_components_t<graph_t> components(graph);
+    components.build();
+    writer.add_hpa(hpa);
+    writer.add_components(components);
+    writer.write(path);
+
+    double t2 = get_time_s();
+    map_file_t file(path);
+    auto mapped = file.terrain();
+    graph_t mapped_graph(mapped, size, size, TERRAIN_WALL);
+    hpa_graph_t<graph_t> mapped_hpa(mapped_graph);
+    map_file_load_hpa(file, mapped_hpa);
+    grid_components_t<graph_t> mapped_components(mapped_graph);
+    map_file_load_components(file, mapped_components);
+    double t3 = get_time_s();
+
+    printf("bench=map_file build_s=%.4f load_s=%.4f file_bytes=%ld hpa_nodes=%ld\n", t1 - t0,
+            t3 - t2, file.size, mapped_hpa.nodes.size());
+    remove(path.c_str());
+}
+
+/* queries to goals inside a walled box: A* floods all the reachable cells to find out that there is
+no path, the components answer at once. Then the cost of keeping the labels up to date while cells
+are toggled, against building them again. */
+template <size_t graph_flags>
+static void bench_components(terrain_t map, int size, int query_cnt) {
+    using graph_t = matrix_graph_wraper_t<graph_flags | PATH_FINDING_FLAG_UNIFORM_COST, terrain_t>;
+    using node_t = typename graph_t::node_t;
+    using cost_t = typename graph_t::cost_t;
+    graph_t graph(map, size, size);
+
+    int box_min = size / 2 - size / 8, box_max = size / 2 + size / 8;
+    for (int i = box_min; i <= box_max; i++) {
+        map[box_min][i] = map[box_max][i] = 100000;
+        map[i][box_min] = map[i][box_max] = 100000;
+    }
+
+    double t0 = get_time_s();
+    grid_components_t<graph_t> components(graph);
+    components.build();
+    double t1 = get_time_s();
+
+    std::mt19937 rng(99);
+    std::vector<std::pair<node_t, node_t>> queries;
+    for (int i = 0; i < query_cnt; i++) {
+        node_t start{int32_t(rng() % size), int32_t(rng() % (box_min - 1))};
+        node_t goal{box_min + 1 + int32_t(rng() % (box_max - box_min - 1)),
+                box_min + 1 + int32_t(rng() % (box_max - box_min - 1))};
+        queries.push_back({start, goal});
+    }
+
+    grid_search_ctx_t<cost_t> ctx;
+    size_t len_a_star = 0;
+    double t2 = get_time_s();
+    for (auto [start, goal] : queries)
+        len_a_star += grid_a_star_path<typename graph_t::heuristic_t, cost_t>(
+                ctx, graph, start, goal, graph.get_heuristic(goal)).size();
+    double t3 = get_time_s();
+    int connected_cnt = 0;
+    for (auto [start, goal] : queries)
+        connected_cnt += components.connected(start, goal);
+    double t4 = get_time_s();
+
+    int update_cnt = query_cnt * 64;
+    double t5 = get_time_s();
+    for (int i = 0; i < update_cnt; i++) {
+        node_t cell{int32_t(rng() % size), int32_t(rng() % size)};
+        map[cell.y][cell.x] = map[cell.y][cell.x] < PATH_FINDING_WALL_VALUE ? 100000 : 1;
+        components.update_cells({cell});
+    }
+    double t6 = get_time_s();
+    grid_components_t<graph_t> rebuilt(graph);
+    rebuilt.build();
+    double t7 = get_time_s();
+
+    printf("bench=components neigh_cnt=%d build_s=%.4f comp_cnt=%d a_star_unreachable_s=%.4f "
+            "a_star_len=%ld check_s=%.7f connected=%d updates=%d update_s=%.4f "
+            "rebuild_s=%.4f rebuild_comp_cnt=%d\n", graph_t::neigh_cnt, t1 - t0,
+            components.comp_cnt, t3 - t2, len_a_star, t4 - t3, connected_cnt, update_cnt,
+            t6 - t5, t7 - t6, rebuilt.comp_cnt);
+}
+
+/* many searches spread over frames with a fixed budget per frame, against all of them at once: the
+total time should stay close, while no frame takes much more than it's budget */
+template <size_t graph_flags>
+static void bench_sliced(terrain_t& map, int size, int query_cnt) {
+    using graph_t = matrix_graph_wraper_t<graph_flags | PATH_FINDING_FLAG_UNIFORM_COST, terrain_t>;
+    using node_t = typename graph_t::node_t;
+    using cost_t = typename graph_t::cost_t;
+    graph_t graph(map, size, size);
+
+    std::mt19937 rng(8642);
+    std::vector<std::pair<node_t, node_t>> queries;
+    for (int i = 0; i < query_cnt; i++)
+        queries.push_back({
+            node_t{int32_t(rng() % size), int32_t(rng() % size)},
+            node_t{int32_t(rng() % size), int32_t(rng() % size)}
+        });
+
+    grid_search_ctx_t<cost_t> ctx;
+    double t0 = get_time_s();
+    for (auto &[start, goal] : queries)
+        grid_a_star_path<typename graph_t::heuristic_t, cost_t>(ctx, graph, start, goal,
+                graph.get_heuristic(goal));
+    double t1 = get_time_s();
+
+    const uint64_t frame_us = 1000;
+    search_scheduler_t<graph_t> scheduler(graph);
+    for (auto &[start, goal] : queries)
+        scheduler.submit(start, goal);
+    int frames = 0;
+    double max_frame_s = 0;
+    double t2 = get_time_s();
+    while (scheduler.running.size()) {
+        double f0 = get_time_s();
+        for (auto id : scheduler.run(0, frame_us))
+            scheduler.release(id);
+        max_frame_s = std::max(max_frame_s, get_time_s() - f0);
+        frames++;
+    }
+    double t3 = get_time_s();
+
+    printf("bench=sliced neigh_cnt=%d queries=%d sync_s=%.4f sliced_s=%.4f frames=%d "
+            "frame_budget_us=%ld max_frame_us=%.0f\n", graph_t::neigh_cnt, query_cnt, t1 - t0,
+            t3 - t2, frames, frame_us, max_frame_s * 1e6);
+}
+
+/* a burst of orders through the service: each unit is ordered again a few frames later, before it's
+first path arrived, so the first orders are superseded. The time the loop spends in request() and
+poll() in a frame is what matters, the searches themselves run on the workers. */
+template <size_t graph_flags>
+static void bench_service(terrain_t& map, int size, int query_cnt) {
+    using graph_t = matrix_graph_wraper_t<graph_flags | PATH_FINDING_FLAG_UNIFORM_COST, terrain_t>;
+    using node_t = typename graph_t::node_t;
+    graph_t graph(map, size, size);
+
+    std::mt19937 rng(9753);
+    auto rand_node = [&]{ return node_t{int32_t(rng() % size), int32_t(rng() % size)}; };
+    uint32_t thread_cnt = std::max(1u, std::thread::hardware_concurrency() - 1);
+    path_service_t<graph_t> service(graph, query_cnt, thread_cnt, query_cnt * 2);
+
+    const int reorder_frame = 2;
+    int frames = 0, received = 0, requested = 0, full = 0;
+    double max_frame_s = 0;
+    double t0 = get_time_s();
+    while (frames <= reorder_frame || service.in_flight()) {
+        double f0 = get_time_s();
+        if (frames == 0 || frames == reorder_frame) {
+            for (int i = 0; i < query_cnt; i++) {
+                bool ok = service.request(i, rand_node(), rand_node(),
+                        i % 4 ? PATH_PRIORITY_NORMAL : PATH_PRIORITY_HIGH);
+                requested += ok;
+                full += !ok;
+            }
+        }
+        received += service.poll([&](uint32_t, std::vector<node_t>&&) {});
+        max_frame_s = std::max(max_frame_s, get_time_s() - f0);
+        frames++;
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+    double t1 = get_time_s();
+
+    printf("bench=service neigh_cnt=%d threads=%d requested=%d full=%d received=%d dropped=%d "
+            "total_s=%.4f frames=%d max_frame_us=%.0f\n", graph_t::neigh_cnt, thread_cnt,
+            requested, full, received, requested - received, t1 - t0, frames, max_frame_s * 1e6);
+}
+
+/* long queries, from one side of the map to the other, grid_a_star_path against hda_star_t with
+more and more threads, the costs must be the same */
+template <size_t graph_flags>
+static void bench_hda(terrain_t& map, int size, int query_cnt) {
+    using graph_t = matrix_graph_wraper_t<graph_flags | PATH_FINDING_FLAG_UNIFORM_COST, terrain_t>;
+    using node_t = typename graph_t::node_t;
+    using cost_t = typename graph_t::cost_t;
+    graph_t graph(map, size, size);
+
+    std::mt19937 rng(8642);
+    auto rand_free = [&](int32_t x0, int32_t x1) {
+        while (true) {
+            node_t n{int32_t(x0 + rng() % (x1 - x0)), int32_t(rng() % size)};
+            if (graph.passable(n.x, n.y))
+                return n;
+        }
+    };
+    std::vector<std::pair<node_t, node_t>> queries;
+    for (int i = 0; i < query_cnt; i++)
+        queries.push_back({rand_free(0, size / 8), rand_free(size - size / 8, size)});
+
+    auto path_cost = [](const std::vector<node_t>& path) {
+        double ret = 0;
+        for (size_t i = 1; i < path.size(); i++)
+            ret += path[i].x != path[i - 1].x && path[i].y != path[i - 1].y ? sqrt(2) : 1;
+        return ret;
+    };
+
+    std::vector<double> costs;
+    grid_search_ctx_t<cost_t> ctx;
+    double t0 = get_time_s();
+    for (auto &[start, goal] : queries)
+        costs.push_back(path_cost(grid_a_star_path<typename graph_t::heuristic_t, cost_t>(
+                ctx, graph, start, goal, graph.get_heuristic(goal))));
+    double t1 = get_time_s();
+    printf("bench=hda neigh_cnt=%d mode=grid threads=1 ms_per_query=%.3f\n", graph_t::neigh_cnt,
+            (t1 - t0) * 1e3 / query_cnt);
+
+    /* 2 and 4 threads always run, even on smaller machines, the costs are checked with messages
+    between the threads */
+    std::vector<uint32_t> thread_cnts{1, 2, 4};
+    for (uint32_t cnt = 8; cnt <= std::thread::hardware_concurrency(); cnt *= 2)
+        thread_cnts.push_back(cnt);
+    for (uint32_t thread_cnt : thread_cnts) {
+        hda_star_t<graph_t> hda(graph, thread_cnt);
+        uint64_t expanded = 0, messages = 0;
+        int mismatches = 0;
+        double t2 = get_time_s();
+        for (int i = 0; i < query_cnt; i++) {
+            double cost = path_cost(hda.path(queries[i].first, queries[i].second));
+            mismatches += std::abs(cost - costs[i]) > 1e-3 * std::max(1.0, costs[i]);
+            expanded += hda.expanded;
+            messages += hda.messages;
+        }
+        double t3 = get_time_s();
+        printf("bench=hda neigh_cnt=%d mode=hda threads=%d ms_per_query=%.3f expanded=%ld "
+                "messages=%ld mismatches=%d\n", graph_t::neigh_cnt, thread_cnt,
+                (t3 - t2) * 1e3 / query_cnt, expanded, messages, mismatches);
+    }
+}
+
+/* the same queries on the matrix graph and on it's csr copy, built in memory and mapped from a file */
+template <size_t graph_flags>
+static void bench_csr(terrain_t& map, int size, int query_cnt) {
+    using graph_t = matrix_graph_wraper_t<graph_flags | PATH_FINDING_FLAG_UNIFORM_COST, terrain_t>;
+    using node_t = typename graph_t::node_t;
+    using cost_t = typename graph_t::cost_t;
+    graph_t graph(map, size, size);
+
+    double t0 = get_time_s();
+    auto csr = csr_graph_t::from_graph(graph);
+    double t1 = get_time_s();
+    std::string path = "/tmp/bench_csr.pfgraph";
+    csr.write(path);
+    csr_graph_file_t file(path);
+    double t2 = get_time_s();
+
+    std::mt19937 rng(4321);
+    std::vector<std::pair<node_t, node_t>> queries;
+    for (int i = 0; i < query_cnt; i++)
+        queries.push_back({
+            node_t{int32_t(rng() % size), int32_t(rng() % size)},
+            node_t{int32_t(rng() % size), int32_t(rng() % size)}
+        });
+
+    grid_search_ctx_t<cost_t> ctx;
+    size_t len_grid = 0, len_csr = 0, len_file = 0;
+    double t3 = get_time_s();
+    for (auto &[start, goal] : queries)
+        len_grid += grid_a_star_path<typename graph_t::heuristic_t, cost_t>(
+                ctx, graph, start, goal, graph.get_heuristic(goal)).size();
+    double t4 = get_time_s();
+    for (auto &[start, goal] : queries) {
+        uint32_t goal_idx = graph.node_index(goal);
+        len_csr += grid_a_star_path<csr_graph_t::heuristic_t, cost_t>(ctx, csr,
+                graph.node_index(start), goal_idx, csr.get_heuristic(goal_idx)).size();
+    }
+    double t5 = get_time_s();
+    for (auto &[start, goal] : queries) {
+        uint32_t goal_idx = graph.node_index(goal);
+        len_file += grid_a_star_path<csr_graph_t::heuristic_t, cost_t>(ctx, file.graph(),
+                graph.node_index(start), goal_idx, file.graph().get_heuristic(goal_idx)).size();
+    }
+    double t6 = get_time_s();
+    unlink(path.c_str());
+
+    printf("bench=csr neigh_cnt=%d nodes=%u edges=%u build_s=%.4f write_map_s=%.4f bytes=%ld\n",
+            graph_t::neigh_cnt, csr.node_cnt, csr.edge_cnt, t1 - t0, t2 - t1, csr.memory_bytes());
+    printf("bench=csr neigh_cnt=%d mode=grid queries_per_s=%.2f path_nodes=%ld\n",
+            graph_t::neigh_cnt, query_cnt / (t4 - t3), len_grid);
+    printf("bench=csr neigh_cnt=%d mode=csr queries_per_s=%.2f path_nodes=%ld\n",
+            graph_t::neigh_cnt, query_cnt / (t5 - t4), len_csr);
+    printf("bench=csr neigh_cnt=%d mode=mapped queries_per_s=%.2f path_nodes=%ld\n",
+            graph_t::neigh_cnt, query_cnt / (t6 - t5), len_file);
+}
+
+/* unit_cnt units walking the paths of query_cnt queries, in a loop, one waypoint_walker_t per unit
+against unit_sim_t, both move the units by the same distance per tick */
+static void bench_units(terrain_t& map, int size, int query_cnt, int unit_cnt) {
+    using graph_t = matrix_graph_wraper_t<PATH_FINDING_FLAG_DIAG_ENABLE, terrain_t>;
+    using node_t = typename graph_t::node_t;
+    using cost_t = typename graph_t::cost_t;
+    graph_t graph(map, size, size);
+
+    std::mt19937 rng(31);
+    grid_search_ctx_t<cost_t> ctx;
+    std::vector<std::vector<node_t>> paths;
+    while (paths.size() < size_t(query_cnt)) {
+        node_t start{int32_t(rng() % size), int32_t(rng() % size)};
+        node_t goal{int32_t(rng() % size), int32_t(rng() % size)};
+        auto path = grid_a_star_path<typename graph_t::heuristic_t, cost_t>(
+                ctx, graph, start, goal, graph.get_heuristic(goal));
+        if (path.size() > 1)
+            paths.push_back(path);
+    }
+
+    const int tick_cnt = 600;
+    const float tick_s = 1 / 60.f;
+    std::vector<waypoint_walker_t<node_t>> walkers(unit_cnt);
+    std::vector<float> speeds(unit_cnt);
+    unit_sim_t sim(tick_s);
+    for (int i = 0; i < unit_cnt; i++) {
+        speeds[i] = 1 + i % 8;
+        walkers[i].reset(paths[i % paths.size()]);
+        sim.add_unit(0, 0);
+        sim.set_path(i, paths[i % paths.size()], speeds[i], true);
+    }
+
+    double t0 = get_time_s();
+    for (int t = 0; t < tick_cnt; t++)
+        for (int i = 0; i < unit_cnt; i++)
+            walkers[i].advance(speeds[i] * tick_s);
+    double t1 = get_time_s();
+    for (int t = 0; t < tick_cnt; t++)
+        sim.tick();
+    double t2 = get_time_s();
+
+    double walker_sum = 0, sim_sum = 0;
+    for (int i = 0; i < unit_cnt; i++) {
+        walker_sum += walkers[i].x + walkers[i].y;
+        sim_sum += sim.x[i] + sim.y[i];
+    }
+    printf("bench=units units=%d ticks=%d mode=walker ms_per_tick=%.4f checksum=%.0f\n",
+            unit_cnt, tick_cnt, (t1 - t0) * 1000 / tick_cnt, walker_sum);
+    printf("bench=units units=%d ticks=%d mode=soa ms_per_tick=%.4f checksum=%.0f\n",
+            unit_cnt, tick_cnt, (t2 - t1) * 1000 / tick_cnt, sim_sum);
+}
+
+int main(int argc, char const *argv[])
+{
+    if (argc > 1 && (std::string(argv[1]) == "suite" || std::string(argv[1]) == "scen"))
+        return bench_suite(argc, argv);
+    if (argc > 1 && std::string(argv[1]) == "check")
+        return bench_check(argc, argv);
+
+    int size = argc > 1 ? atoi(argv[1]) : 512;
+    int query_cnt = argc > 2 ? atoi(argv[2]) : 20;
+
+    auto map = gen_random_map(size, 0.2, 42);
+
+    bench_neighbors<0>(map, size);
+    bench_neighbors<PATH_FINDING_FLAG_DIAG_ENABLE>(map, size);
+    bench_queries<0>(map, size, query_cnt);
+    bench_queries<PATH_FINDING_FLAG_DIAG_ENABLE>(map, size, query_cnt);
+    bench_stats<0>(map, size, query_cnt);
+    bench_stats<PATH_FINDING_FLAG_DIAG_ENABLE>(map, size, query_cnt);
+    bench_open_sets<0>(map, size, query_cnt);
+    bench_open_sets<PATH_FINDING_FLAG_DIAG_ENABLE>(map, size, query_cnt);
+    bench_terrain<0>(map, size, query_cnt);
+    bench_terrain<PATH_FINDING_FLAG_DIAG_ENABLE>(map, size, query_cnt);
+    bench_map_file(map, size);
+    bench_csr<0>(map, size, query_cnt);
+    bench_csr<PATH_FINDING_FLAG_DIAG_ENABLE>(map, size, query_cnt);
+    bench_components<0>(map, size, query_cnt);
+    bench_components<PATH_FINDING_FLAG_DIAG_ENABLE>(map, size, query_cnt);
+    bench_sliced<0>(map, size, query_cnt);
+    bench_sliced<PATH_FINDING_FLAG_DIAG_ENABLE>(map, size, query_cnt);
+    bench_service<0>(map, size, query_cnt);
+    bench_service<PATH_FINDING_FLAG_DIAG_ENABLE>(map, size, query_cnt);
+    bench_hda<0>(map, size, query_cnt);
+    bench_hda<PATH_FINDING_FLAG_DIAG_ENABLE>(map, size, query_cnt);
+    bench_jps<0>(map, size, query_cnt);
+    bench_jps<PATH_FINDING_FLAG_DIAG_ENABLE>(map, size, query_cnt);
+    bench_batch<PATH_FINDING_FLAG_DIAG_ENABLE>(map, size, query_cnt * 8);
+    bench_flow<0>(map, size, query_cnt * 8);
+    bench_flow<PATH_FINDING_FLAG_DIAG_ENABLE>(map, size, query_cnt * 8);
+    bench_dstar<0>(map, size, query_cnt * 8);
+    bench_dstar<PATH_FINDING_FLAG_DIAG_ENABLE>(map, size, query_cnt * 8);
+    bench_units(map, size, query_cnt, 10000);
+
+    return 0;
+}
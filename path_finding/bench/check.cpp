@@ -0,0 +1,215 @@
+#define LOGGER_VERBOSE_LVL 0
+
+#include "debug.h"
+#include "misc_utils.h"
+#include "path_finding.h"
+#include "path_service.h"
+#include "dstar_lite.h"
+#include "components.h"
+#include "map_file.h"
+#include "scenario.h"
+
+#include <random>
+
+/* Checks of the behaviour the benchmarks don't see, for the races and the incremental updates that
+give wrong answers instead of slow ones. One line per check:
+
+    bench=check name=<name> ok=<0|1> ...
+
+and the exit code is 1 if one of them failed.
+*/
+
+using grid_t = terrain_grid_t<uint8_t>;
+
+/* A small queue that is always full while one worker drains it: every request() that fails must
+leave the last accepted request of the owner current, so poll() only ever hands out the path of
+that request, never an empty one, and every owner gets it in the end. */
+static bool check_service_full_queue() {
+    const int size = 32;
+    const uint32_t owner_cnt = 8;
+    const int round_cnt = 200000;
+
+    grid_t grid(size, size, 1, TERRAIN_WALL);
+    grid.build_obstacles(TERRAIN_WALL);
+    using graph_t = matrix_graph_wraper_t<PATH_FINDING_FLAG_UNIFORM_COST, grid_t>;
+    using node_t = typename graph_t::node_t;
+    graph_t graph(grid, size, size, TERRAIN_WALL);
+    path_service_t<graph_t> service(graph, owner_cnt, 1, 2);
+
+    std::mt19937 rng(1357);
+    std::vector<node_t> goals(owner_cnt);
+    std::vector<bool> waiting(owner_cnt, false);
+    int accepted = 0, full = 0, empty = 0, wrong_goal = 0, twice = 0;
+    auto on_path = [&](uint32_t owner, std::vector<node_t>&& path) {
+        empty += path.empty();
+        wrong_goal += !path.empty() && !(path.front() == goals[owner]);
+        twice += !waiting[owner];
+        waiting[owner] = false;
+    };
+
+    for (int i = 0; i < round_cnt; i++) {
+        uint32_t owner = rng() % owner_cnt;
+        node_t start{int32_t(rng() % size), int32_t(rng() % size)};
+        node_t goal{int32_t(rng() % size), int32_t(rng() % size)};
+        if (service.request(owner, start, goal)) {
+            goals[owner] = goal;
+            waiting[owner] = true;
+            accepted++;
+        }
+        else {
+            full++;
+            std::this_thread::yield();
+        }
+        if (i % 16 == 0)
+            service.poll(on_path);
+    }
+    while (service.in_flight()) {
+        service.poll(on_path);
+        std::this_thread::yield();
+    }
+
+    int unanswered = std::count(waiting.begin(), waiting.end(), true);
+    bool ok = full && !empty && !wrong_goal && !twice && !unanswered;
+    printf("bench=check name=service_full_queue ok=%d accepted=%d full=%d empty=%d wrong_goal=%d "
+            "twice=%d unanswered=%d\n", ok, accepted, full, empty, wrong_goal, twice, unanswered);
+    return ok;
+}
+
+/* A components section with a label past the sizes, a size that is not the count of it's label or
+a size for no_label must be refused by map_file_load_components(), the good one loaded. */
+static bool check_components_file() {
+    const int size = 64;
+    using graph_t = matrix_graph_wraper_t<PATH_FINDING_FLAG_UNIFORM_COST, grid_t>;
+    std::string path = "/tmp/check_components.pfmap";
+
+    grid_t grid = gen_rooms_grid(size, 8, 2468);
+    graph_t graph(grid, size, size, TERRAIN_WALL);
+    grid_components_t<graph_t> components(graph);
+    components.build();
+
+    /* returns 1 if the file was loaded, 0 if it was refused with an exception */
+    auto load = [&](auto&& corrupt) {
+        map_file_writer_t writer(grid, TERRAIN_WALL);
+        writer.add_components(components);
+        auto words = (uint32_t *)writer.sections.back().data.data();
+        corrupt(words, words + components.labels.size());
+        writer.write(path);
+        map_file_t file(path);
+        grid_components_t<graph_t> loaded(graph);
+        try {
+            map_file_load_components(file, loaded);
+            return 1;
+        }
+        catch (std::runtime_error&) {
+            return 0;
+        }
+    };
+    uint32_t label_cnt = components.sizes.size();
+    uint32_t free_idx = std::find_if(components.labels.begin(), components.labels.end(),
+            [](uint32_t l) { return l != 0; }) - components.labels.begin();
+    int good = load([](uint32_t *, uint32_t *) {});
+    int big_label = load([&](uint32_t *labels, uint32_t *) { labels[0] = label_cnt; });
+    int bad_size = load([&](uint32_t *labels, uint32_t *sizes) { sizes[labels[free_idx]]++; });
+    int no_label_size = load([](uint32_t *, uint32_t *sizes) { sizes[0] = 1; });
+    remove(path.c_str());
+
+    bool ok = good && !big_label && !bad_size && !no_label_size;
+    printf("bench=check name=components_file ok=%d good=%d big_label=%d bad_size=%d "
+            "no_label_size=%d\n", ok, good, big_label, bad_size, no_label_size);
+    return ok;
+}
+
+/* D* Lite on a terrain_grid_t with it's obstacle layer: the unit walks, cells on the path become
+walls and some walls are opened, after each change the path must be legal by the cells themselves
+and have the cost of a new search. The bits that passable() reads must follow the writes of update_cells(). */
+static bool check_dstar_terrain() {
+    const int size = 96;
+    const int round_cnt = 60;
+    using graph_t = matrix_graph_wraper_t<PATH_FINDING_FLAG_DIAG_ENABLE |
+            PATH_FINDING_FLAG_UNIFORM_COST, grid_t>;
+    using node_t = typename graph_t::node_t;
+    using cost_t = typename graph_t::cost_t;
+
+    grid_t grid = gen_random_grid(size, 0.2, 8642);
+    graph_t graph(grid, size, size, TERRAIN_WALL);
+    auto free_cell = [&](int32_t x, int32_t y) {
+        return x >= 0 && y >= 0 && x < size && y < size && grid[y][x] < TERRAIN_WALL;
+    };
+
+    /* the cost of the path if every step is a legal move of the cells, -1 otherwise */
+    auto checked_cost = [&](const std::vector<node_t>& path) {
+        double cost = 0;
+        for (size_t i = 0; i < path.size(); i++) {
+            if (!free_cell(path[i].x, path[i].y))
+                return -1.;
+            if (!i)
+                continue;
+            int32_t dx = path[i].x - path[i - 1].x, dy = path[i].y - path[i - 1].y;
+            if (std::abs(dx) > 1 || std::abs(dy) > 1 || (!dx && !dy))
+                return -1.;
+            if (dx && dy && (!free_cell(path[i - 1].x + dx, path[i - 1].y) ||
+                    !free_cell(path[i - 1].x, path[i - 1].y + dy)))
+                return -1.;
+            cost += dx && dy ? std::sqrt(2.) : 1.;
+        }
+        return cost;
+    };
+
+    std::mt19937 rng(97531);
+    auto rand_free = [&] {
+        while (true) {
+            node_t n{int32_t(rng() % size), int32_t(rng() % size)};
+            if (free_cell(n.x, n.y))
+                return n;
+        }
+    };
+    node_t start = rand_free(), goal = rand_free();
+
+    dstar_lite_t<graph_t> dstar(graph);
+    dstar.plan(start, goal);
+    grid_search_ctx_t<cost_t> ctx;
+    int invalid = 0, wrong_cost = 0, replans = 0;
+    auto path = dstar.path();
+    for (int r = 0; r < round_cnt; r++) {
+        /* every other round the unit takes a step, so the keys go through km */
+        if (path.size() > 2 && r % 2) {
+            start = path[path.size() - 2];
+            dstar.move_start(start);
+        }
+        std::vector<typename dstar_lite_t<graph_t>::cell_update_t> updates;
+        if (path.size() > 3) {
+            auto &n = path[1 + rng() % (path.size() - 3)];
+            updates.push_back({n, double(TERRAIN_WALL)});
+        }
+        for (int i = 0; i < 4; i++) {
+            node_t n{int32_t(rng() % size), int32_t(rng() % size)};
+            if (!free_cell(n.x, n.y) && !(n == start) && !(n == goal))
+                updates.push_back({n, 1.});
+        }
+        dstar.update_cells(updates);
+        path = dstar.path();
+        replans++;
+
+        auto ref = grid_a_star_path<typename graph_t::heuristic_t, cost_t>(ctx, graph, start,
+                goal, graph.get_heuristic(goal));
+        double cost = checked_cost(path);
+        invalid += !path.empty() && cost < 0;
+        wrong_cost += path.empty() != ref.empty() ||
+                (!path.empty() && std::abs(cost - checked_cost(ref)) > 1e-3);
+    }
+
+    bool ok = !invalid && !wrong_cost;
+    printf("bench=check name=dstar_terrain ok=%d replans=%d invalid=%d wrong_cost=%d\n", ok,
+            replans, invalid, wrong_cost);
+    return ok;
+}
+
+int bench_check(int argc, char const *argv[]) {
+    (void)argc;
+    (void)argv;
+    bool ok = true;
+    ok &= check_service_full_queue();
+    ok &= check_components_file();
+    ok &= check_dstar_terrain();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,174 @@
+#ifndef BENCH_SCENARIO_H
+#define BENCH_SCENARIO_H
+
+#include "misc_utils.h"
+#include "terrain_grid.h"
+
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+/* The maps and the queries of the benchmark suite (suite.cpp). They are all terrain_grid_t<uint8_t>
+with TERRAIN_WALL walls and free cells of cost 1, like the maps of the viewer.
+
+    load_movingai_map(path) - a map of the MovingAI benchmarks (https://movingai.com/benchmarks),
+            '.', 'G' and 'S' are free, everything else ('@', 'O', 'T', 'W') is a wall
+    load_movingai_scen(path) - the queries of a .scen file, with their optimal lengths, those are
+            octile lengths without corner cutting, the same as the 8 neighbor graph
+    gen_random_grid(size, wall_ratio, seed) - walls spread at random
+    gen_maze_grid(size, corridor, seed) - a perfect maze with corridors of the given width
+    gen_rooms_grid(size, room, seed) - square rooms, each wall between two rooms has a door
+*/
+
+struct scen_query_t {
+    int32_t sx, sy;
+    int32_t gx, gy;
+    double optimal;         /* < 0 if it's not known yet */
+};
+
+struct scen_file_t {
+    std::string map;        /* as written in the file, usually relative to the maps directory */
+    std::vector<scen_query_t> queries;
+};
+
+inline terrain_grid_t<uint8_t> load_movingai_map(const std::string& path) {
+    std::ifstream in(path);
+    if (!in)
+        throw std::runtime_error("can't open " + path);
+
+    int32_t width = -1, height = -1;
+    std::string key;
+    while (in >> key && key != "map") {
+        if (key == "height")
+            in >> height;
+        else if (key == "width")
+            in >> width;
+        else
+            std::getline(in, key);      /* type octile */
+    }
+    if (key != "map" || width <= 0 || height <= 0)
+        throw std::runtime_error(path + " has a bad header");
+
+    terrain_grid_t<uint8_t> ret(width, height, 1, TERRAIN_WALL);
+    std::string line;
+    std::getline(in, line);
+    for (int32_t y = 0; y < height; y++) {
+        if (!std::getline(in, line) || int32_t(line.size()) < width)
+            throw std::runtime_error(path + " is truncated");
+        for (int32_t x = 0; x < width; x++) {
+            char c = line[x];
+            ret[y][x] = (c == '.' || c == 'G' || c == 'S') ? 1 : TERRAIN_WALL;
+        }
+    }
+    ret.build_obstacles(TERRAIN_WALL);
+    return ret;
+}
+
+inline scen_file_t load_movingai_scen(const std::string& path) {
+    std::ifstream in(path);
+    if (!in)
+        throw std::runtime_error("can't open " + path);
+
+    scen_file_t ret;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line.starts_with("version"))
+            continue;
+        std::istringstream ss(line);
+        int bucket, w, h;
+        scen_query_t q;
+        std::string map;
+        if (!(ss >> bucket >> map >> w >> h >> q.sx >> q.sy >> q.gx >> q.gy >> q.optimal))
+            throw std::runtime_error(path + " has a bad line: " + line);
+        if (ret.map.empty())
+            ret.map = map;
+        ret.queries.push_back(q);
+    }
+    return ret;
+}
+
+inline terrain_grid_t<uint8_t> gen_random_grid(int32_t size, double wall_ratio, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> dist(0, 1);
+    terrain_grid_t<uint8_t> ret(size, size, 1, TERRAIN_WALL);
+    for (int32_t y = 0; y < size; y++)
+        for (int32_t x = 0; x < size; x++)
+            ret[y][x] = dist(rng) < wall_ratio ? TERRAIN_WALL : 1;
+    ret.build_obstacles(TERRAIN_WALL);
+    return ret;
+}
+
+/* depth first backtracker over a grid of corridor x corridor cells separated by 1 cell walls */
+inline terrain_grid_t<uint8_t> gen_maze_grid(int32_t size, int32_t corridor, uint32_t seed) {
+    std::mt19937 rng(seed);
+    terrain_grid_t<uint8_t> ret(size, size, TERRAIN_WALL, TERRAIN_WALL);
+    int32_t pitch = corridor + 1;
+    int32_t cells = size / pitch;
+    auto carve = [&](int32_t x0, int32_t y0, int32_t w, int32_t h) {
+        for (int32_t y = y0; y < std::min(size, y0 + h); y++)
+            for (int32_t x = x0; x < std::min(size, x0 + w); x++)
+                ret[y][x] = 1;
+    };
+
+    std::vector<bool> seen(cells * cells, false);
+    std::vector<std::pair<int32_t, int32_t>> stack{{0, 0}};
+    seen[0] = true;
+    carve(0, 0, corridor, corridor);
+    while (stack.size()) {
+        auto [cx, cy] = stack.back();
+        std::array<std::pair<int32_t, int32_t>, 4> next;
+        int cnt = 0;
+        for (auto [dx, dy] : {std::pair{1, 0}, {-1, 0}, {0, 1}, {0, -1}}) {
+            int32_t nx = cx + dx, ny = cy + dy;
+            if (nx >= 0 && ny >= 0 && nx < cells && ny < cells && !seen[ny * cells + nx])
+                next[cnt++] = {nx, ny};
+        }
+        if (!cnt) {
+            stack.pop_back();
+            continue;
+        }
+        auto [nx, ny] = next[rng() % cnt];
+        seen[ny * cells + nx] = true;
+        carve(std::min(cx, nx) * pitch, std::min(cy, ny) * pitch,
+                (std::abs(nx - cx) + 1) * pitch - 1, (std::abs(ny - cy) + 1) * pitch - 1);
+        stack.push_back({nx, ny});
+    }
+    ret.build_obstacles(TERRAIN_WALL);
+    return ret;
+}
+
+inline terrain_grid_t<uint8_t> gen_rooms_grid(int32_t size, int32_t room, uint32_t seed) {
+    std::mt19937 rng(seed);
+    terrain_grid_t<uint8_t> ret(size, size, 1, TERRAIN_WALL);
+    int32_t pitch = room + 1;
+    for (int32_t y = 0; y < size; y++)
+        for (int32_t x = 0; x < size; x++)
+            if (x % pitch == room || y % pitch == room)
+                ret[y][x] = TERRAIN_WALL;
+
+    /* one door of a random width on each wall between two rooms */
+    for (int32_t ry = 0; ry * pitch < size; ry++) {
+        for (int32_t rx = 0; rx * pitch < size; rx++) {
+            int32_t x0 = rx * pitch, y0 = ry * pitch;
+            int32_t door = 1 + rng() % std::max(1, room / 3);
+            int32_t at = rng() % std::max(1, room - door);
+            for (int32_t i = at; i < at + door; i++) {
+                if (x0 + room < size && y0 + i < size)
+                    ret[y0 + i][x0 + room] = 1;
+                if (y0 + room < size && x0 + i < size)
+                    ret[y0 + room][x0 + i] = 1;
+            }
+        }
+    }
+    ret.build_obstacles(TERRAIN_WALL);
+    return ret;
+}
+
+/* the benchmark suite, bench.cpp calls it for the suite and scen commands */
+int bench_suite(int argc, char const *argv[]);
+
+/* the correctness checks of check.cpp, bench.cpp calls it for the check command */
+int bench_check(int argc, char const *argv[]);
+
+#endif
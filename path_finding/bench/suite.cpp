@@ -0,0 +1,464 @@
+#define LOGGER_VERBOSE_LVL 0
+
+#include "debug.h"
+#include "misc_utils.h"
+#include "path_finding.h"
+#include "jump_point.h"
+#include "hpa_star.h"
+#include "path_batch.h"
+#include "flow_field.h"
+#include "dstar_lite.h"
+#include "components.h"
+#include "any_angle.h"
+#include "grid_kernel.h"
+#include "hda_star.h"
+#include "sliced_search.h"
+#include "path_service.h"
+#include "csr_graph.h"
+#include "scenario.h"
+
+#include <chrono>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+/* Runs every search mode over the same queries of one map and prints one line per mode:
+
+    bench=suite map=<name> width= height= neigh_cnt= mode=<mode> queries= solved= failed=
+            invalid= build_s= queries_per_s= expanded= path_nodes= peak_rss_kb= mem_kb= optimal=
+            subopt_mean= subopt_max=
+
+failed are the queries that have a path that the mode didn't find, invalid the paths that don't
+go from the start to the goal with legal moves. optimal counts the paths that have the cost of the
+reference, subopt_* are cost / reference - 1 over the solved queries. The reference is the optimal
+length of the .scen file, or the cost of grid_a_star_path for the generated maps. expanded is -1 for
+the modes that don't count it, for flow it's the cells swept by the wavefront. The any-angle modes
+(theta and smooth) are checked with line_of_sight() and their cost is the euclidean length, so it
+can be lower than the reference and subopt_* can be negative.
+
+Each mode runs in it's own process, so peak_rss_kb (getrusage) is the peak of that mode alone on
+top of the loaded map, mem_kb is the part of it that the mode allocated itself.
+*/
+
+using grid_t = terrain_grid_t<uint8_t>;
+
+static double suite_time_s() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+static long current_rss_kb() {
+    long pages = 0, resident = 0;
+    if (FILE *f = fopen("/proc/self/statm", "r")) {
+        if (fscanf(f, "%ld %ld", &pages, &resident) != 2)
+            resident = 0;
+        fclose(f);
+    }
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+template <typename graph_t>
+struct suite_map_t {
+    using node_t = typename graph_t::node_t;
+
+    std::string name;
+    graph_t &graph;
+    std::vector<scen_query_t> queries;
+
+    node_t start(const scen_query_t& q) const { return node_t{q.sx, q.sy}; }
+    node_t goal(const scen_query_t& q) const { return node_t{q.gx, q.gy}; }
+};
+
+/* the octile cost of the path, or -1 if a step is not a legal move of the graph */
+template <typename graph_t>
+static double path_cost(const graph_t& graph, const std::vector<typename graph_t::node_t>& path) {
+    double cost = 0;
+    for (size_t i = 1; i < path.size(); i++) {
+        auto a = path[i - 1], b = path[i];
+        int32_t dx = b.x - a.x, dy = b.y - a.y;
+        if (std::abs(dx) > 1 || std::abs(dy) > 1 || (!dx && !dy) || !graph.passable(b.x, b.y))
+            return -1;
+        if (dx && dy) {
+            if (graph_t::neigh_cnt != 8 || !graph.passable(a.x + dx, a.y) ||
+                    !graph.passable(a.x, a.y + dy))
+                return -1;
+            cost += sqrt(2);
+        }
+        else
+            cost += 1;
+    }
+    return cost;
+}
+
+/* the euclidean length of an any-angle path, or -1 if a segment crosses a wall */
+template <typename node_t>
+static double any_angle_cost(const passable_grid_t& grid, const std::vector<node_t>& path) {
+    for (size_t i = 1; i < path.size(); i++)
+        if (!line_of_sight(grid, path[i - 1], path[i]))
+            return -1;
+    return path_length(path);
+}
+
+/* make_solver() is called once, it's time is the build time of the mode, it returns the solver:
+solve(start, goal, expanded) that returns a path in the format of a_star_path and adds the nodes it
+expanded to expanded */
+template <typename graph_t, typename make_fn_t>
+static void run_mode(const suite_map_t<graph_t>& map, const char *mode, make_fn_t&& make_solver,
+        bool any_angle = false)
+{
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return;
+    }
+    if (pid > 0) {
+        int status = 0;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status))
+            printf("bench=suite map=%s mode=%s error=crashed\n", map.name.c_str(), mode);
+        return;
+    }
+
+    passable_grid_t los_grid;
+    if (any_angle)
+        los_grid.build(map.graph);
+
+    long base_kb = current_rss_kb();
+    double t0 = suite_time_s();
+    auto solve = make_solver();
+    double t1 = suite_time_s();
+
+    double search_s = 0;
+    int64_t expanded = 0;
+    size_t path_nodes = 0;
+    uint32_t solved = 0, failed = 0, invalid = 0, optimal = 0;
+    double subopt_sum = 0, subopt_max = 0;
+    for (auto &q : map.queries) {
+        auto start = map.start(q), goal = map.goal(q);
+        double q0 = suite_time_s();
+        auto path = solve(start, goal, expanded);
+        search_s += suite_time_s() - q0;
+        path_nodes += path.size();
+
+        if (path.empty()) {
+            failed += q.optimal >= 0;
+            continue;
+        }
+        double cost = any_angle ? any_angle_cost(los_grid, path) : path_cost(map.graph, path);
+        if (cost < 0 || !(path.front() == goal) || !(path.back() == start)) {
+            invalid++;
+            continue;
+        }
+        solved++;
+        double subopt = q.optimal > 0 ? cost / q.optimal - 1 : 0;
+        if (subopt < 0 && subopt > -1e-6)
+            subopt = 0;
+        optimal += subopt < 1e-4;
+        subopt_sum += subopt;
+        subopt_max = std::max(subopt_max, subopt);
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("bench=suite map=%s width=%d height=%d neigh_cnt=%d mode=%s queries=%ld solved=%d "
+            "failed=%d invalid=%d build_s=%.4f queries_per_s=%.2f expanded=%ld path_nodes=%ld "
+            "peak_rss_kb=%ld mem_kb=%ld optimal=%d subopt_mean=%.5f subopt_max=%.5f\n",
+            map.name.c_str(), map.graph.max_cols, map.graph.max_lines, graph_t::neigh_cnt, mode,
+            map.queries.size(), solved, failed, invalid, t1 - t0,
+            map.queries.size() / std::max(search_s, 1e-9), expanded, path_nodes, usage.ru_maxrss,
+            std::max(0l, usage.ru_maxrss - base_kb), optimal,
+            solved ? subopt_sum / solved : 0., subopt_max);
+    fflush(stdout);
+    _exit(0);
+}
+
+template <typename graph_t>
+static void run_all_modes(const suite_map_t<graph_t>& map) {
+    using node_t = typename graph_t::node_t;
+    using cost_t = typename graph_t::cost_t;
+    using heuristic_t = typename graph_t::heuristic_t;
+    graph_t &graph = map.graph;
+
+    run_mode(map, "a_star_map", [&] {
+        return [&](const node_t& start, const node_t& goal, int64_t& expanded) {
+            expanded = -1;
+            return a_star_path<heuristic_t, cost_t>(graph, start, goal,
+                    graph.get_heuristic(goal));
+        };
+    });
+    run_mode(map, "a_star", [&] {
+        return [&, ctx = grid_search_ctx_t<cost_t>{}](const node_t& start, const node_t& goal,
+                int64_t& expanded) mutable
+        {
+            auto ret = grid_a_star_path<heuristic_t, cost_t>(ctx, graph, start, goal,
+                    graph.get_heuristic(goal));
+            expanded += std::count(ctx.closed.begin(), ctx.closed.end(), ctx.generation);
+            return ret;
+        };
+    });
+    run_mode(map, "a_star_radix", [&] {
+        return [&, ctx = grid_search_ctx_t<cost_t>{}, open_set = radix_heap_open_set_t<cost_t>{}](
+                const node_t& start, const node_t& goal, int64_t& expanded) mutable
+        {
+            auto ret = grid_a_star_path<heuristic_t, cost_t>(ctx, open_set, graph, start, goal,
+                    graph.get_heuristic(goal));
+            expanded += std::count(ctx.closed.begin(), ctx.closed.end(), ctx.generation);
+            return ret;
+        };
+    });
+    run_mode(map, "a_star_bucket", [&] {
+        return [&, ctx = grid_search_ctx_t<cost_t>{}, open_set = bucket_open_set_t<cost_t>{}](
+                const node_t& start, const node_t& goal, int64_t& expanded) mutable
+        {
+            auto ret = grid_a_star_path<heuristic_t, cost_t>(ctx, open_set, graph, start, goal,
+                    graph.get_heuristic(goal));
+            expanded += std::count(ctx.closed.begin(), ctx.closed.end(), ctx.generation);
+            return ret;
+        };
+    });
+    run_mode(map, "a_star_kernel", [&] {
+        auto kernel = std::make_shared<kernel_a_star_t<graph_t>>();
+        kernel->build(graph);
+        return [kernel](const node_t& start, const node_t& goal, int64_t& expanded) {
+            auto ret = kernel->path(start, goal);
+            auto &ctx = kernel->ctx;
+            expanded += std::count(ctx.closed.begin(), ctx.closed.end(), ctx.generation);
+            return ret;
+        };
+    });
+    run_mode(map, "a_star_csr", [&] {
+        auto csr = std::make_shared<csr_graph_t>(csr_graph_t::from_graph(graph));
+        return [&, csr, ctx = grid_search_ctx_t<csr_graph_t::cost_t>{}](const node_t& start,
+                const node_t& goal, int64_t& expanded) mutable
+        {
+            uint32_t goal_idx = graph.node_index(goal);
+            auto path = grid_a_star_path<csr_graph_t::heuristic_t, csr_graph_t::cost_t>(ctx,
+                    *csr, graph.node_index(start), goal_idx, csr->get_heuristic(goal_idx));
+            expanded += std::count(ctx.closed.begin(), ctx.closed.end(), ctx.generation);
+            std::vector<node_t> ret;
+            for (uint32_t idx : path)
+                ret.push_back(graph.index_node(idx));
+            return ret;
+        };
+    });
+
+    /* the searches are sliced in steps of 256 expansions, like a frame budget would do */
+    run_mode(map, "sliced", [&] {
+        auto search = std::make_shared<sliced_search_t<graph_t>>(graph);
+        return [search](const node_t& start, const node_t& goal, int64_t& expanded) {
+            search->begin(start, goal);
+            while (search->step(256, 0) == SLICED_SEARCH_RUNNING)
+                ;
+            expanded += search->expanded;
+            if (search->status != SLICED_SEARCH_FOUND)
+                return std::vector<node_t>{};
+            return search->path();
+        };
+    });
+
+    /* one request at a time, the time of a query includes the trip through the queues */
+    run_mode(map, "service", [&] {
+        auto service = std::make_shared<path_service_t<graph_t>>(graph, 1, 2);
+        return [service](const node_t& start, const node_t& goal, int64_t& expanded) {
+            expanded = -1;
+            std::vector<node_t> ret;
+            service->request(0, start, goal);
+            while (service->in_flight()) {
+                service->poll([&](uint32_t, std::vector<node_t>&& path) { ret = std::move(path); });
+                std::this_thread::yield();
+            }
+            return ret;
+        };
+    });
+    run_mode(map, "jps", [&] {
+        auto jps = std::make_shared<jps_search_t<graph_t>>();
+        jps->build(graph);
+        return [jps](const node_t& start, const node_t& goal, int64_t& expanded) {
+            auto ret = jps->path(start, goal);
+            expanded += jps->expanded;
+            return ret;
+        };
+    });
+    run_mode(map, "jps_radix", [&] {
+        auto jps = std::make_shared<jps_search_t<graph_t, radix_heap_open_set_t<cost_t>>>();
+        jps->build(graph);
+        return [jps](const node_t& start, const node_t& goal, int64_t& expanded) {
+            auto ret = jps->path(start, goal);
+            expanded += jps->expanded;
+            return ret;
+        };
+    });
+    run_mode(map, "hpa", [&] {
+        auto hpa = std::make_shared<hpa_graph_t<graph_t>>(graph);
+        hpa->build();
+        return [hpa](const node_t& start, const node_t& goal, int64_t& expanded) {
+            auto ret = hpa->path(start, goal);
+            expanded += hpa->expanded;
+            return ret;
+        };
+    });
+    run_mode(map, "hda", [&] {
+        auto hda = std::make_shared<hda_star_t<graph_t>>(graph, 4);
+        return [hda](const node_t& start, const node_t& goal, int64_t& expanded) {
+            auto ret = hda->path(start, goal);
+            expanded += hda->expanded;
+            return ret;
+        };
+    });
+    run_mode(map, "theta", [&] {
+        auto theta = std::make_shared<theta_star_t<graph_t>>();
+        theta->build(graph);
+        return [theta](const node_t& start, const node_t& goal, int64_t& expanded) {
+            auto ret = theta->path(start, goal);
+            expanded += theta->expanded;
+            return ret;
+        };
+    }, true);
+    run_mode(map, "smooth", [&] {
+        auto grid = std::make_shared<passable_grid_t>();
+        grid->build(graph);
+        return [&, grid, ctx = grid_search_ctx_t<cost_t>{}](const node_t& start,
+                const node_t& goal, int64_t& expanded) mutable
+        {
+            auto ret = grid_a_star_path<heuristic_t, cost_t>(ctx, graph, start, goal,
+                    graph.get_heuristic(goal));
+            expanded += std::count(ctx.closed.begin(), ctx.closed.end(), ctx.generation);
+            return smooth_path(*grid, ret);
+        };
+    }, true);
+    run_mode(map, "flow", [&] {
+        auto cache = std::make_shared<flow_field_cache_t<graph_t>>(graph);
+        return [&, cache](const node_t& start, const node_t& goal, int64_t& expanded) {
+            auto field = cache->get(goal);
+            expanded += int64_t(field->passes) * graph.node_count();
+            std::vector<node_t> ret;
+            if (field->cost(start) == field->inf)
+                return ret;
+            for (auto node = start; !(node == goal); node = field->next(node))
+                ret.push_back(node);
+            ret.push_back(goal);
+            std::reverse(ret.begin(), ret.end());
+            return ret;
+        };
+    });
+    run_mode(map, "dstar", [&] {
+        auto planner = std::make_shared<dstar_lite_t<graph_t>>(graph);
+        return [planner](const node_t& start, const node_t& goal, int64_t& expanded) {
+            planner->plan(start, goal);
+            auto ret = planner->path();
+            expanded += planner->expanded;
+            return ret;
+        };
+    });
+
+    /* the whole batch is solved by the first query, so the time of all the queries is the time
+    of the batch and queries_per_s is it's throughput */
+    run_mode(map, "batch", [&] {
+        using batch_t = path_batch_t<graph_t>;
+        auto batch = std::make_shared<batch_t>(graph);
+        auto result = std::make_shared<typename batch_t::result_t>();
+        auto next = std::make_shared<size_t>(0);
+        return [&, batch, result, next](const node_t&, const node_t&, int64_t& expanded) {
+            expanded = -1;
+            if (!result->size()) {
+                std::vector<typename batch_t::query_t> queries;
+                for (auto &q : map.queries)
+                    queries.push_back({map.start(q), map.goal(q)});
+                *result = batch->solve(queries);
+            }
+            auto path = result->path((*next)++);
+            return std::vector<node_t>(path.begin(), path.end());
+        };
+    });
+}
+
+/* random queries between cells that are connected, their reference is the cost of a grid A* */
+template <typename graph_t>
+static std::vector<scen_query_t> gen_queries(graph_t& graph, int query_cnt, uint32_t seed) {
+    using node_t = typename graph_t::node_t;
+    using cost_t = typename graph_t::cost_t;
+    grid_components_t<graph_t> components(graph);
+    components.build();
+
+    std::mt19937 rng(seed);
+    grid_search_ctx_t<cost_t> ctx;
+    std::vector<scen_query_t> ret;
+    for (int tries = 0; int(ret.size()) < query_cnt && tries < query_cnt * 1000; tries++) {
+        node_t start{int32_t(rng() % graph.max_cols), int32_t(rng() % graph.max_lines)};
+        node_t goal{int32_t(rng() % graph.max_cols), int32_t(rng() % graph.max_lines)};
+        if (start == goal || !components.connected(start, goal))
+            continue;
+        auto path = grid_a_star_path<typename graph_t::heuristic_t, cost_t>(ctx, graph, start,
+                goal, graph.get_heuristic(goal));
+        ret.push_back({start.x, start.y, goal.x, goal.y, path_cost(graph, path)});
+    }
+    return ret;
+}
+
+template <size_t graph_flags>
+static void run_generated(const std::string& name, grid_t& grid, int query_cnt) {
+    using graph_t = matrix_graph_wraper_t<graph_flags | PATH_FINDING_FLAG_UNIFORM_COST, grid_t>;
+    graph_t graph(grid, grid.height, grid.width, TERRAIN_WALL);
+    suite_map_t<graph_t> map{name, graph, gen_queries(graph, query_cnt, 1234)};
+    run_all_modes(map);
+}
+
+static int run_scen(const std::string& scen_path, std::string map_path, int query_cnt) {
+    auto scen = load_movingai_scen(scen_path);
+    if (map_path.empty()) {
+        /* the map is looked for next to the scenario */
+        auto dir = scen_path.substr(0, scen_path.find_last_of('/') + 1);
+        map_path = dir + scen.map.substr(scen.map.find_last_of('/') + 1);
+    }
+    auto grid = load_movingai_map(map_path);
+
+    /* a subset spread over all the buckets, the last ones hold the longest queries */
+    std::vector<scen_query_t> queries;
+    size_t step = query_cnt > 0 ? std::max<size_t>(1, scen.queries.size() / query_cnt) : 1;
+    for (size_t i = 0; i < scen.queries.size(); i += step)
+        queries.push_back(scen.queries[i]);
+
+    using graph_t = matrix_graph_wraper_t<PATH_FINDING_FLAG_DIAG_ENABLE |
+            PATH_FINDING_FLAG_UNIFORM_COST, grid_t>;
+    graph_t graph(grid, grid.height, grid.width, TERRAIN_WALL);
+    auto name = map_path.substr(map_path.find_last_of('/') + 1);
+    run_all_modes(suite_map_t<graph_t>{name, graph, queries});
+    return 0;
+}
+
+int bench_suite(int argc, char const *argv[]) {
+    std::string cmd = argv[1];
+    try {
+        if (cmd == "scen") {
+            if (argc < 3) {
+                printf("usage: %s scen <file.scen> [file.map] [query_cnt]\n", argv[0]);
+                return 1;
+            }
+            return run_scen(argv[2], argc > 3 ? argv[3] : "", argc > 4 ? atoi(argv[4]) : 200);
+        }
+
+        int query_cnt = argc > 2 ? atoi(argv[2]) : 100;
+        std::vector<int> sizes;
+        for (int i = 3; i < argc; i++)
+            sizes.push_back(atoi(argv[i]));
+        if (sizes.empty())
+            sizes = {128, 256, 512};
+
+        for (int size : sizes) {
+            std::vector<std::pair<std::string, grid_t>> maps;
+            maps.push_back({"random", gen_random_grid(size, 0.25, 42)});
+            maps.push_back({"maze", gen_maze_grid(size, 2, 42)});
+            maps.push_back({"rooms", gen_rooms_grid(size, 16, 42)});
+            for (auto &[kind, grid] : maps) {
+                auto name = kind + std::to_string(size);
+                run_generated<0>(name, grid, query_cnt);
+                run_generated<PATH_FINDING_FLAG_DIAG_ENABLE>(name, grid, query_cnt);
+            }
+        }
+    }
+    catch (std::exception& e) {
+        printf("%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
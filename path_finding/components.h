@@ -0,0 +1,306 @@
+#ifndef COMPONENTS_H
+#define COMPONENTS_H
+
+#include "path_finding.h"
+
+/* Connected components of the passable cells of a matrix_graph_wraper_t. Two cells are connected
+only if a path exists between them, so a query with the start and the goal in different
+components can be answered with an empty path in O(1), instead of a search that floods everything
+that can be reached from the start.
+
+The labels are computed with 4-connectivity, also for the graphs with 8 neighbors: a diagonal move
+needs both cells beside it to be free, so the two cells of a diagonal are always also connected
+through one of those cells. Walls have the label no_label.
+
+    build() - labels the whole map
+    update_cells(cells) - the given cells were changed in the map, repair the labels
+    connected(a, b) - true if both cells are free and in the same component
+
+A cell that becomes free joins the components around it, the smaller ones are relabeled to the
+label of the largest. A cell that becomes a wall may split it's component. If the free cells
+around it are still connected through the 3x3 ring around the cell nothing can split, otherwise
+a flood starts from each of it's free neighbors, one step at a time for each flood. Floods that
+meet are merged and a flood that runs out of cells is a new component. When only one flood is
+left that one keeps the old label, so the cost is the size of the smaller parts, not the size of
+the whole component.
+*/
+
+template <typename graph_t>
+struct grid_components_t {
+    using node_t = typename graph_t::node_t;
+
+    static constexpr uint32_t no_label = 0;
+
+    const graph_t &graph;
+    std::vector<uint32_t> labels;       /* by graph.node_index() */
+    std::vector<uint32_t> sizes;        /* by label, sizes[no_label] is not used */
+    uint32_t comp_cnt = 0;
+    std::vector<uint32_t> free_labels;  /* the labels of the components that disappeared */
+
+    grid_components_t(const graph_t &graph) : graph(graph) {}
+
+    void build() {
+        labels.assign(graph.node_count(), no_label);
+        sizes.assign(1, 0);
+        free_labels.clear();
+        comp_cnt = 0;
+        for (int32_t y = 0; y < graph.max_lines; y++) {
+            for (int32_t x = 0; x < graph.max_cols; x++) {
+                uint32_t idx = graph.node_index(node_t{x, y});
+                if (labels[idx] != no_label || !graph.passable(x, y))
+                    continue;
+                uint32_t label = new_label();
+                std::vector<uint32_t> cells{idx};
+                labels[idx] = label;
+                for (size_t head = 0; head < cells.size(); head++) {
+                    for_each_neigh(cells[head], [&](uint32_t n) {
+                        node_t nn = graph.index_node(n);
+                        if (labels[n] == no_label && graph.passable(nn.x, nn.y)) {
+                            labels[n] = label;
+                            cells.push_back(n);
+                        }
+                    });
+                }
+                sizes[label] = cells.size();
+            }
+        }
+    }
+
+    bool connected(const node_t& a, const node_t& b) const {
+        uint32_t la = labels[graph.node_index(a)];
+        return la != no_label && la == labels[graph.node_index(b)];
+    }
+
+    uint32_t label(const node_t& node) const { return labels[graph.node_index(node)]; }
+
+    /* recomputes comp_cnt and the free labels from the sizes, after they were loaded */
+    void recount() {
+        comp_cnt = 0;
+        free_labels.clear();
+        for (uint32_t l = 1; l < sizes.size(); l++) {
+            if (sizes[l])
+                comp_cnt++;
+            else
+                free_labels.push_back(l);
+        }
+    }
+
+    void update_cells(const std::vector<node_t>& cells) {
+        for (auto &cell : cells) {
+            uint32_t idx = graph.node_index(cell);
+            bool free = graph.passable(cell.x, cell.y);
+            if (free && labels[idx] == no_label)
+                add_cell(idx);
+            else if (!free && labels[idx] != no_label)
+                remove_cell(idx);
+        }
+    }
+
+private:
+    static constexpr std::array<std::array<int32_t, 2>, 4> dirs{{{0, -1}, {1, 0}, {0, 1}, {-1, 0}}};
+
+    /* the floods of remove_cell, they are kept here only to reuse their memory */
+    struct flood_t {
+        std::vector<uint32_t> cells;    /* all the visited cells, the queue starts at head */
+        size_t head;
+        uint32_t group;
+    };
+    std::array<flood_t, 4> floods;
+    std::vector<uint32_t> visit_stamp;
+    std::vector<uint8_t> visit_flood;
+    uint32_t visit_gen = 0;
+
+    uint32_t new_label() {
+        comp_cnt++;
+        if (free_labels.size()) {
+            uint32_t ret = free_labels.back();
+            free_labels.pop_back();
+            return ret;
+        }
+        sizes.push_back(0);
+        return sizes.size() - 1;
+    }
+
+    void drop_label(uint32_t label) {
+        sizes[label] = 0;
+        free_labels.push_back(label);
+        comp_cnt--;
+    }
+
+    bool inside(int32_t x, int32_t y) const {
+        return x >= 0 && y >= 0 && x < graph.max_cols && y < graph.max_lines;
+    }
+
+    /* the updates only look at the labels, not at the map, so the cells of a batch that were not
+    updated yet are seen as they were before and the batch is the same as one cell at a time */
+    bool is_labeled(int32_t x, int32_t y) const {
+        return inside(x, y) && labels[graph.node_index(node_t{x, y})] != no_label;
+    }
+
+    template <typename fn_t>
+    void for_each_neigh(uint32_t idx, fn_t&& fn) const {
+        node_t node = graph.index_node(idx);
+        for (auto [dx, dy] : dirs)
+            if (inside(node.x + dx, node.y + dy))
+                fn(graph.node_index(node_t{node.x + dx, node.y + dy}));
+    }
+
+    void relabel(uint32_t from_idx, uint32_t label) {
+        uint32_t old = labels[from_idx];
+        std::vector<uint32_t> cells{from_idx};
+        labels[from_idx] = label;
+        for (size_t head = 0; head < cells.size(); head++) {
+            for_each_neigh(cells[head], [&](uint32_t n) {
+                if (labels[n] == old) {
+                    labels[n] = label;
+                    cells.push_back(n);
+                }
+            });
+        }
+        sizes[label] += cells.size();
+        drop_label(old);
+    }
+
+    void add_cell(uint32_t idx) {
+        uint32_t best = no_label;
+        for_each_neigh(idx, [&](uint32_t n) {
+            if (labels[n] != no_label && (best == no_label || sizes[labels[n]] > sizes[best]))
+                best = labels[n];
+        });
+        if (best == no_label)
+            best = new_label();
+        labels[idx] = best;
+        sizes[best]++;
+        for_each_neigh(idx, [&](uint32_t n) {
+            if (labels[n] != no_label && labels[n] != best)
+                relabel(n, best);
+        });
+    }
+
+    void remove_cell(uint32_t idx) {
+        uint32_t old = labels[idx];
+        labels[idx] = no_label;
+        sizes[old]--;
+        if (!sizes[old]) {
+            drop_label(old);
+            return;
+        }
+
+        /* the 8 cells around, clockwise from north, and if they are free */
+        node_t node = graph.index_node(idx);
+        static constexpr std::array<std::array<int32_t, 2>, 8> ring{{
+            {0, -1}, {1, -1}, {1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}
+        }};
+        std::array<bool, 8> ring_free;
+        for (int i = 0; i < 8; i++)
+            ring_free[i] = is_labeled(node.x + ring[i][0], node.y + ring[i][1]);
+
+        /* the free straight neighbors that are joined by free cells of the ring are in one run,
+        if there is only one run nothing can be split */
+        int runs = 0;
+        for (int i = 0; i < 8; i += 2) {
+            if (!ring_free[i])
+                continue;
+            int prev = (i + 6) % 8;
+            bool joined = ring_free[prev] && ring_free[(i + 7) % 8];
+            runs += !joined;
+        }
+        int straight_free = ring_free[0] + ring_free[2] + ring_free[4] + ring_free[6];
+        if (runs == 0 && straight_free)
+            runs = 1;   /* all the ring is free, the runs wrap around */
+        if (runs <= 1)
+            return;
+
+        split(node, old);
+    }
+
+    void split(const node_t& node, uint32_t old) {
+        if (visit_stamp.size() < labels.size()) {
+            visit_stamp.resize(labels.size(), 0);
+            visit_flood.resize(labels.size(), 0);
+        }
+        if (++visit_gen == 0) {
+            std::fill(visit_stamp.begin(), visit_stamp.end(), 0);
+            visit_gen = 1;
+        }
+
+        uint32_t flood_cnt = 0;
+        for (auto [dx, dy] : dirs) {
+            if (!is_labeled(node.x + dx, node.y + dy))
+                continue;
+            uint32_t n = graph.node_index(node_t{node.x + dx, node.y + dy});
+            auto &f = floods[flood_cnt];
+            f.cells.assign(1, n);
+            f.head = 0;
+            f.group = flood_cnt;
+            visit_stamp[n] = visit_gen;
+            visit_flood[n] = flood_cnt;
+            flood_cnt++;
+        }
+
+        auto find = [&](uint32_t f) {
+            while (floods[f].group != f)
+                f = floods[f].group;
+            return f;
+        };
+        auto group_active = [&](uint32_t g) {
+            for (uint32_t f = 0; f < flood_cnt; f++)
+                if (find(f) == g && floods[f].head < floods[f].cells.size())
+                    return true;
+            return false;
+        };
+
+        std::array<bool, 4> done{};
+        while (true) {
+            uint32_t active = 0;
+            for (uint32_t f = 0; f < flood_cnt; f++)
+                active += find(f) == f && !done[f];
+            if (active <= 1)
+                break;
+
+            for (uint32_t f = 0; f < flood_cnt; f++) {
+                auto &fl = floods[f];
+                if (done[find(f)] || fl.head >= fl.cells.size())
+                    continue;
+                uint32_t curr = fl.cells[fl.head++];
+                for_each_neigh(curr, [&](uint32_t n) {
+                    if (labels[n] == no_label)
+                        return;
+                    if (visit_stamp[n] != visit_gen) {
+                        visit_stamp[n] = visit_gen;
+                        visit_flood[n] = f;
+                        fl.cells.push_back(n);
+                    }
+                    else {
+                        uint32_t a = find(f), b = find(visit_flood[n]);
+                        if (a != b)
+                            floods[std::max(a, b)].group = std::min(a, b);
+                    }
+                });
+            }
+
+            /* a group that can't grow anymore is cut from the others, it becomes a component */
+            for (uint32_t g = 0; g < flood_cnt; g++) {
+                if (find(g) != g || done[g] || group_active(g))
+                    continue;
+                active = 0;
+                for (uint32_t f = 0; f < flood_cnt; f++)
+                    active += find(f) == f && !done[f];
+                if (active <= 1)
+                    break;
+                done[g] = true;
+                uint32_t label = new_label();
+                for (uint32_t f = 0; f < flood_cnt; f++) {
+                    if (find(f) != g)
+                        continue;
+                    for (auto c : floods[f].cells)
+                        labels[c] = label;
+                    sizes[label] += floods[f].cells.size();
+                    sizes[old] -= floods[f].cells.size();
+                }
+            }
+        }
+    }
+};
+
+#endif
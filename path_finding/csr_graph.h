@@ -0,0 +1,387 @@
+#ifndef CSR_GRAPH_H
+#define CSR_GRAPH_H
+
+#include "misc_utils.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* A graph of any shape (navmesh polygons, road crossings, waypoints) in compressed sparse row form:
+the nodes are the ids 0..node_cnt-1, the edges of node n are edges offsets[n]..offsets[n+1]-1 of
+targets and weights. A search reads the edges of a node in one block, instead of chasing a pointer
+per node like with adjacency lists. The nodes can have coordinates, they are only used by the
+heuristic.
+
+    csr_graph_t::build(node_cnt, edges, coords) - sorts the edges by their source, coords is empty
+            or has one entry per node
+    csr_graph_t::from_graph(graph) - the same graph as another one with node_count(),
+            node_index() and index_node(), like matrix_graph_wraper_t, with it's x, y as coords
+    csr_graph_t::view(...) - uses arrays that live somewhere else (a mapped file), nothing is freed
+    write(path) / csr_graph_file_t(path) - the binary form of the graph (.pfgraph), the arrays are
+            written as they are and the file is mapped and used without decoding
+
+It has the interface of matrix_graph_wraper_t, node_t is the id of the node and node_index() is
+the identity, so a_star_path, grid_a_star_path, sliced_search_t and the open sets of open_set.h
+work on it. The heuristic is the straight distance to the goal times heuristic_scale, the smallest
+weight / distance over all the edges, so it never overestimates even if the weights are not
+lengths (travel times for example), and it's consistent. Without coords it's 0 (Dijkstra).
+*/
+
+struct csr_coord_t {
+    float x;
+    float y;
+    float z;
+};
+
+struct csr_edge_t {
+    uint32_t from;
+    uint32_t to;
+    float weight;
+};
+
+#define CSR_GRAPH_FILE_VERSION 1
+
+inline constexpr char csr_graph_file_magic[8] = {'P', 'F', 'G', 'R', 'A', 'P', 'H', 0};
+
+/* the arrays follow the header in this order, each aligned to 64 bytes: offsets (node_cnt + 1),
+targets (edge_cnt), weights (edge_cnt) and, if has_coords, coords (node_cnt) */
+struct csr_graph_file_header_t {
+    char magic[8];
+    uint32_t version;
+    uint32_t node_cnt;
+    uint32_t edge_cnt;
+    uint32_t has_coords;
+    float heuristic_scale;
+    uint32_t reserved;
+};
+
+struct csr_graph_t {
+    using node_t = uint32_t;
+    using cost_t = float;
+
+    static constexpr uint32_t invalid_node = 0xffff'ffff;
+
+    uint32_t node_cnt = 0;
+    uint32_t edge_cnt = 0;
+    const uint32_t *offsets = nullptr;
+    const uint32_t *targets = nullptr;
+    const float *weights = nullptr;
+    const csr_coord_t *coords = nullptr;    /* nullptr if the nodes have no coordinates */
+    float heuristic_scale = 0;
+
+    static csr_graph_t build(uint32_t node_cnt, const std::vector<csr_edge_t>& edges,
+            std::vector<csr_coord_t> coords = {})
+    {
+        if (!coords.empty() && coords.size() != node_cnt)
+            throw std::runtime_error("csr graph: one coord per node is needed");
+
+        /* counting sort of the edges by their source, the order of the edges of a node is kept */
+        csr_graph_t ret;
+        ret.node_cnt = node_cnt;
+        ret.edge_cnt = edges.size();
+        ret.owned_offsets.assign(node_cnt + 1, 0);
+        for (auto &e : edges) {
+            if (e.from >= node_cnt || e.to >= node_cnt)
+                throw std::runtime_error("csr graph: edge to a node that doesn't exist");
+            if (!(e.weight >= 0))
+                throw std::runtime_error("csr graph: negative edge weight");
+            ret.owned_offsets[e.from + 1]++;
+        }
+        for (uint32_t n = 0; n < node_cnt; n++)
+            ret.owned_offsets[n + 1] += ret.owned_offsets[n];
+
+        std::vector<uint32_t> next(ret.owned_offsets.begin(), ret.owned_offsets.end() - 1);
+        ret.owned_targets.resize(edges.size());
+        ret.owned_weights.resize(edges.size());
+        for (auto &e : edges) {
+            uint32_t slot = next[e.from]++;
+            ret.owned_targets[slot] = e.to;
+            ret.owned_weights[slot] = e.weight;
+        }
+        ret.owned_coords = std::move(coords);
+        ret.point_to_owned();
+        ret.heuristic_scale = ret.compute_heuristic_scale();
+        return ret;
+    }
+
+    template <typename graph_t>
+    static csr_graph_t from_graph(const graph_t& graph) {
+        uint32_t node_cnt = graph.node_count();
+        std::vector<csr_edge_t> edges;
+        std::vector<csr_coord_t> coords(node_cnt);
+        for (uint32_t idx = 0; idx < node_cnt; idx++) {
+            auto node = graph.index_node(idx);
+            coords[idx] = {float(node.x), float(node.y), 0};
+            graph.for_each_neighbor(node, [&](const auto& neigh, auto cost) {
+                edges.push_back({idx, graph.node_index(neigh), float(cost)});
+            });
+        }
+        return build(node_cnt, edges, std::move(coords));
+    }
+
+    static csr_graph_t view(uint32_t node_cnt, uint32_t edge_cnt, const uint32_t *offsets,
+            const uint32_t *targets, const float *weights, const csr_coord_t *coords,
+            float heuristic_scale)
+    {
+        csr_graph_t ret;
+        ret.node_cnt = node_cnt;
+        ret.edge_cnt = edge_cnt;
+        ret.offsets = offsets;
+        ret.targets = targets;
+        ret.weights = weights;
+        ret.coords = coords;
+        ret.heuristic_scale = heuristic_scale;
+        return ret;
+    }
+
+    /* the views stay views, the copies of an owning graph point in their own arrays */
+    csr_graph_t() {}
+    csr_graph_t(const csr_graph_t& oth) { *this = oth; }
+    csr_graph_t(csr_graph_t&& oth) { *this = std::move(oth); }
+
+    csr_graph_t& operator = (const csr_graph_t& oth) {
+        copy_fields(oth);
+        owned_offsets = oth.owned_offsets;
+        owned_targets = oth.owned_targets;
+        owned_weights = oth.owned_weights;
+        owned_coords = oth.owned_coords;
+        if (oth.is_owner())
+            point_to_owned();
+        return *this;
+    }
+
+    csr_graph_t& operator = (csr_graph_t&& oth) {
+        copy_fields(oth);
+        bool owner = oth.is_owner();
+        owned_offsets = std::move(oth.owned_offsets);
+        owned_targets = std::move(oth.owned_targets);
+        owned_weights = std::move(oth.owned_weights);
+        owned_coords = std::move(oth.owned_coords);
+        if (owner)
+            point_to_owned();
+        return *this;
+    }
+
+    bool passable(node_t node) const { return node < node_cnt; }
+
+    uint32_t node_count() const { return node_cnt; }
+    uint32_t node_index(node_t node) const { return node; }
+    node_t index_node(uint32_t idx) const { return idx; }
+    uint32_t degree(node_t node) const { return offsets[node + 1] - offsets[node]; }
+
+    template <typename fn_t>
+    void for_each_neighbor(node_t node, fn_t&& fn) const {
+        uint32_t end = offsets[node + 1];
+        for (uint32_t e = offsets[node]; e < end; e++)
+            fn(targets[e], weights[e]);
+    }
+
+    std::vector<std::pair<node_t, cost_t>> neighbors(node_t node) const {
+        std::vector<std::pair<node_t, cost_t>> ret;
+        ret.reserve(degree(node));
+        for_each_neighbor(node, [&ret](node_t neigh, cost_t cost) { ret.push_back({neigh, cost}); });
+        return ret;
+    }
+
+    struct heuristic_t {
+        const csr_coord_t *coords;
+        csr_coord_t goal;
+        float scale;
+
+        cost_t operator () (node_t node) const {
+            if (!coords)
+                return 0;
+            auto &c = coords[node];
+            float dx = c.x - goal.x, dy = c.y - goal.y, dz = c.z - goal.z;
+            return scale * sqrtf(dx * dx + dy * dy + dz * dz);
+        }
+    };
+
+    heuristic_t get_heuristic(node_t goal) const {
+        if (!coords)
+            return heuristic_t{nullptr, {}, 0};
+        return heuristic_t{coords, coords[goal], heuristic_scale};
+    }
+
+    void write(const std::string& path) const {
+        csr_graph_file_header_t head{};
+        memcpy(head.magic, csr_graph_file_magic, sizeof(head.magic));
+        head.version = CSR_GRAPH_FILE_VERSION;
+        head.node_cnt = node_cnt;
+        head.edge_cnt = edge_cnt;
+        head.has_coords = coords != nullptr;
+        head.heuristic_scale = heuristic_scale;
+
+        FILE *f = fopen(path.c_str(), "wb");
+        if (!f)
+            throw std::runtime_error("can't open " + path + " for writing");
+        std::vector<uint8_t> zeros(64, 0);
+        uint64_t pos = 0;
+        bool ok = true;
+        auto append = [&](const void *src, size_t size) {
+            uint64_t pad = align(pos) - pos;
+            ok &= fwrite(zeros.data(), 1, pad, f) == pad;
+            ok &= fwrite(src, 1, size, f) == size;
+            pos += pad + size;
+        };
+        append(&head, sizeof(head));
+        append(offsets, (node_cnt + 1) * sizeof(uint32_t));
+        append(targets, edge_cnt * sizeof(uint32_t));
+        append(weights, edge_cnt * sizeof(float));
+        if (coords)
+            append(coords, node_cnt * sizeof(csr_coord_t));
+        ok &= fclose(f) == 0;
+        if (!ok)
+            throw std::runtime_error("failed to write " + path);
+    }
+
+    static uint64_t align(uint64_t offset) { return (offset + 63) / 64 * 64; }
+
+    /* the largest scale for which scale * distance is never more than the weight of an edge, the
+    edges between nodes at the same place don't limit it */
+    float compute_heuristic_scale() const {
+        if (!coords)
+            return 0;
+        float scale = std::numeric_limits<float>::max();
+        for (uint32_t n = 0; n < node_cnt; n++) {
+            for (uint32_t e = offsets[n]; e < offsets[n + 1]; e++) {
+                auto &a = coords[n], &b = coords[targets[e]];
+                float dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z;
+                float dist = sqrtf(dx * dx + dy * dy + dz * dz);
+                if (dist > 0)
+                    scale = std::min(scale, weights[e] / dist);
+            }
+        }
+        /* the float rounding of the distances could make it overestimate by an ulp */
+        return scale == std::numeric_limits<float>::max() ? 0 : scale * (1 - 1e-6f);
+    }
+
+    size_t memory_bytes() const {
+        return owned_offsets.size() * sizeof(uint32_t) + owned_targets.size() * sizeof(uint32_t) +
+                owned_weights.size() * sizeof(float) + owned_coords.size() * sizeof(csr_coord_t);
+    }
+
+private:
+    std::vector<uint32_t> owned_offsets;
+    std::vector<uint32_t> owned_targets;
+    std::vector<float> owned_weights;
+    std::vector<csr_coord_t> owned_coords;
+
+    bool is_owner() const { return offsets && offsets == owned_offsets.data(); }
+
+    void copy_fields(const csr_graph_t& oth) {
+        node_cnt = oth.node_cnt;
+        edge_cnt = oth.edge_cnt;
+        offsets = oth.offsets;
+        targets = oth.targets;
+        weights = oth.weights;
+        coords = oth.coords;
+        heuristic_scale = oth.heuristic_scale;
+    }
+
+    void point_to_owned() {
+        offsets = owned_offsets.data();
+        targets = owned_targets.data();
+        weights = owned_weights.data();
+        coords = owned_coords.empty() ? nullptr : owned_coords.data();
+    }
+
+};
+
+/* A .pfgraph file mapped in memory, graph() is a view of the arrays in the mapping, it must not
+outlive this object. Like map_file_t a file of another version is refused. The arrays are checked
+once when the file is opened (offsets that don't decrease, targets that exist, weights >= 0), and
+the heuristic_scale of the header is lowered to the one computed from the edges if it's larger, so
+a bad file can't make a search read out of the mapping or return a path that is not optimal. */
+struct csr_graph_file_t {
+    uint8_t *base = nullptr;
+    size_t size = 0;
+
+    csr_graph_file_t(const std::string& path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("can't open " + path);
+        struct stat st;
+        if (fstat(fd, &st) < 0) {
+            close(fd);
+            throw std::runtime_error("can't stat " + path);
+        }
+        size = st.st_size;
+        void *addr = size >= sizeof(csr_graph_file_header_t) ?
+                mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+        close(fd);
+        if (addr == MAP_FAILED)
+            throw std::runtime_error("can't map " + path);
+        base = (uint8_t *)addr;
+
+        auto head = (const csr_graph_file_header_t *)base;
+        if (memcmp(head->magic, csr_graph_file_magic, sizeof(head->magic)) != 0)
+            fail(path + " is not a graph file");
+        if (head->version != CSR_GRAPH_FILE_VERSION)
+            fail(path + " has version " + std::to_string(head->version) + ", expected " +
+                    std::to_string(CSR_GRAPH_FILE_VERSION));
+
+        uint64_t pos = csr_graph_t::align(sizeof(csr_graph_file_header_t));
+        auto take = [&](uint64_t bytes) {
+            uint64_t ret = pos;
+            pos = csr_graph_t::align(pos + bytes);
+            if (ret + bytes > size)
+                fail(path + " is truncated");
+            return base + ret;
+        };
+        auto offsets = (const uint32_t *)take((uint64_t(head->node_cnt) + 1) * sizeof(uint32_t));
+        auto targets = (const uint32_t *)take(uint64_t(head->edge_cnt) * sizeof(uint32_t));
+        auto weights = (const float *)take(uint64_t(head->edge_cnt) * sizeof(float));
+        auto coords = head->has_coords ?
+                (const csr_coord_t *)take(uint64_t(head->node_cnt) * sizeof(csr_coord_t)) : nullptr;
+        if (offsets[0] != 0 || offsets[head->node_cnt] != head->edge_cnt)
+            fail(path + " has bad offsets");
+        for (uint32_t n = 0; n < head->node_cnt; n++)
+            if (offsets[n] > offsets[n + 1])
+                fail(path + " has bad offsets");
+        for (uint32_t e = 0; e < head->edge_cnt; e++) {
+            if (targets[e] >= head->node_cnt)
+                fail(path + " has an edge to a node that doesn't exist");
+            if (!(weights[e] >= 0))
+                fail(path + " has a negative edge weight");
+        }
+        for (uint32_t n = 0; coords && n < head->node_cnt; n++)
+            if (!std::isfinite(coords[n].x) || !std::isfinite(coords[n].y) ||
+                    !std::isfinite(coords[n].z))
+                fail(path + " has bad coords");
+
+        graph_view = csr_graph_t::view(head->node_cnt, head->edge_cnt, offsets, targets, weights,
+                coords, 0);
+        float scale = graph_view.compute_heuristic_scale();
+        if (head->heuristic_scale >= 0 && head->heuristic_scale < scale)
+            scale = head->heuristic_scale;
+        graph_view.heuristic_scale = scale;
+    }
+
+    ~csr_graph_file_t() {
+        if (base)
+            munmap(base, size);
+    }
+
+    csr_graph_file_t(const csr_graph_file_t&) = delete;
+    csr_graph_file_t& operator = (const csr_graph_file_t&) = delete;
+
+    const csr_graph_t& graph() const { return graph_view; }
+
+private:
+    csr_graph_t graph_view;
+
+    [[noreturn]] void fail(const std::string& msg) {
+        munmap(base, size);
+        base = nullptr;
+        throw std::runtime_error(msg);
+    }
+};
+
+#endif
@@ -0,0 +1,281 @@
+#ifndef DSTAR_LITE_H
+#define DSTAR_LITE_H
+
+#include "path_finding.h"
+
+#include <limits>
+#include <optional>
+
+/* D* Lite (Koenig and Likhachev) over matrix_graph_wraper_t. The search goes from the goal to the
+start and it's state (g, rhs and the open set) is kept between calls, so when some cells change
+only the nodes whose cost to the goal is affected by the change are expanded again, instead of
+running a whole new search. The start can also move along the path, that is handled with the km
+offset of the keys, so the open set doesn't need to be rebuilt.
+
+    dstar_lite_t(graph) - the graph is kept by reference, it's cells are written by update_cells
+    plan(start, goal) - drops the old state and starts planning for a new goal
+    move_start(node) - the unit moved, the next path() starts from node
+    update_cells(updates) - writes the new values in the map (with graph.set_cell(), so the
+            obstacle layer of a terrain_grid_t follows) and repairs the search state
+    path() - the cells from goal to start, in the same format as a_star_path, empty if the goal
+             can't be reached
+    expanded - the number of nodes expanded since plan()
+
+A node whose cost goes up is expanded twice, once to drop it's old cost and once to give it the
+new one, and a change close to the goal reaches most of the nodes between the goal and the start,
+since they all go through it. Such a replan can cost as much as a new search, the cheap ones are the
+changes close to the start (to the unit).
+
+The state is dense, indexed by node_index(), and the open set is a binary heap where old entries
+are not removed, instead they are skipped when they reach the top because the key of their node has
+changed in the meantime. The costs must be symmetric, which is true for both cost models of the
+wrapper. The paths are optimal only if the heuristic of the graph is admissible, as for a_star_path
+that is the case in the uniform cost mode.
+*/
+
+template <typename graph_t>
+struct dstar_lite_t {
+    using node_t = typename graph_t::node_t;
+    using cost_t = typename graph_t::cost_t;
+    using heuristic_t = typename graph_t::heuristic_t;
+
+    static_assert(std::is_floating_point_v<cost_t>, "D* Lite needs an infinite cost");
+    static constexpr cost_t inf = std::numeric_limits<cost_t>::infinity();
+
+    struct cell_update_t {
+        node_t node;
+        double value;
+    };
+
+    struct key_t {
+        cost_t k1;
+        cost_t k2;
+
+        bool operator < (const key_t& oth) const {
+            return k1 < oth.k1 || (k1 == oth.k1 && k2 < oth.k2);
+        }
+        bool operator == (const key_t& oth) const { return k1 == oth.k1 && k2 == oth.k2; }
+    };
+
+    struct open_entry_t {
+        key_t key;
+        uint32_t idx;
+    };
+
+    graph_t &graph;
+    node_t start;
+    node_t goal;
+    node_t last;            /* the start for which km was last updated */
+    cost_t km = 0;
+    uint64_t expanded = 0;
+
+    std::vector<cost_t> g;
+    std::vector<cost_t> rhs;
+    std::vector<key_t> key;             /* the key of the node in the open set */
+    std::vector<uint8_t> in_open;
+    std::vector<open_entry_t> open_set;
+    std::optional<heuristic_t> heuristic;   /* distance to the start */
+    std::vector<uint32_t> walked;           /* walk_generation if the cell is on the path */
+    uint32_t walk_generation = 0;
+
+    dstar_lite_t(graph_t &graph) : graph(graph) {}
+
+    void plan(const node_t& start, const node_t& goal) {
+        this->start = start;
+        this->goal = goal;
+        last = start;
+        km = 0;
+        expanded = 0;
+        heuristic.emplace(graph.get_heuristic(start));
+
+        uint32_t node_cnt = graph.node_count();
+        g.assign(node_cnt, inf);
+        rhs.assign(node_cnt, inf);
+        key.assign(node_cnt, key_t{inf, inf});
+        in_open.assign(node_cnt, 0);
+        open_set.clear();
+
+        uint32_t goal_idx = graph.node_index(goal);
+        rhs[goal_idx] = 0;
+        push(goal_idx);
+    }
+
+    void move_start(const node_t& node) {
+        if (node == start)
+            return;
+        start = node;
+        heuristic.emplace(graph.get_heuristic(start));
+        km += (*heuristic)(last);
+        last = start;
+    }
+
+    /* a cell can change the cost of the edges that go to it, and with 8 neighbors also the ones
+    that pass beside it (the diagonals can't cut corners), so the cell and the nodes it has edges
+    with are updated: the 4 around it, or the whole 3x3 block */
+    void update_cells(const std::vector<cell_update_t>& updates) {
+        for (auto &u : updates)
+            graph.set_cell(u.node.x, u.node.y, u.value);
+        for (auto &u : updates) {
+            update_node(u.node);
+            for (auto [dx, dy] : graph_t::neigh_dirs) {
+                node_t n{u.node.x + dx, u.node.y + dy};
+                if (n.x < 0 || n.y < 0 || n.x >= graph.max_cols || n.y >= graph.max_lines)
+                    continue;
+                update_node(n);
+            }
+        }
+    }
+
+    std::vector<node_t> path() {
+        compute_shortest_path();
+        /* the search stops before expanding the start, so it's cost is in rhs, not in g */
+        if (rhs[graph.node_index(start)] == inf)
+            return {};
+
+        /* every step goes to the neighbor that gives the smallest cost to the goal. With edges of
+        cost 0 many neighbors can give the same cost, the one closest to the goal (smallest g) wins
+        and the cells already walked are skipped, so the walk can't go around in circles. If it
+        gets stuck in a dead end of such a plateau it steps back and tries the next cell */
+        if (++walk_generation == 0) {
+            std::fill(walked.begin(), walked.end(), 0);
+            walk_generation = 1;
+        }
+        walked.resize(graph.node_count(), 0);
+        std::vector<node_t> ret;
+        node_t curr = start;
+        ret.push_back(curr);
+        walked[graph.node_index(curr)] = walk_generation;
+        while (!(curr == goal)) {
+            cost_t best = inf;
+            cost_t best_g = inf;
+            node_t next = curr;
+            graph.for_each_neighbor(curr, [&](const node_t& neigh, cost_t cost) {
+                uint32_t neigh_idx = graph.node_index(neigh);
+                cost_t score = cost + g[neigh_idx];
+                if (walked[neigh_idx] == walk_generation)
+                    return;
+                if (score < best || (score == best && g[neigh_idx] < best_g)) {
+                    best = score;
+                    best_g = g[neigh_idx];
+                    next = neigh;
+                }
+            });
+            if (best == inf) {
+                ret.pop_back();
+                if (!ret.size())
+                    return {};
+                curr = ret.back();
+                continue;
+            }
+            curr = next;
+            ret.push_back(curr);
+            walked[graph.node_index(curr)] = walk_generation;
+        }
+        std::reverse(ret.begin(), ret.end());
+        return ret;
+    }
+
+private:
+    key_t calc_key(uint32_t idx) const {
+        cost_t m = std::min(g[idx], rhs[idx]);
+        return key_t{m + (*heuristic)(graph.index_node(idx)) + km, m};
+    }
+
+    static bool compare_fn(const open_entry_t& a, const open_entry_t& b) {
+        return b.key < a.key;
+    }
+
+    void push(uint32_t idx) {
+        key_t k = calc_key(idx);
+        if (in_open[idx] && key[idx] == k)
+            return;
+        key[idx] = k;
+        in_open[idx] = 1;
+        open_set.push_back({k, idx});
+        std::push_heap(open_set.begin(), open_set.end(), compare_fn);
+    }
+
+    /* drops the entries of the nodes that left the open set or got a new key since */
+    void drop_stale() {
+        while (open_set.size()) {
+            auto &top = open_set.front();
+            if (in_open[top.idx] && key[top.idx] == top.key)
+                return;
+            std::pop_heap(open_set.begin(), open_set.end(), compare_fn);
+            open_set.pop_back();
+        }
+    }
+
+    /* rhs from all the neighbors, then the node goes in or out of the open set */
+    void update_node(const node_t& node) {
+        uint32_t idx = graph.node_index(node);
+        if (!(node == goal)) {
+            cost_t best = inf;
+            if (graph.passable(node.x, node.y)) {
+                graph.for_each_neighbor(node, [&](const node_t& neigh, cost_t cost) {
+                    best = std::min(best, cost + g[graph.node_index(neigh)]);
+                });
+            }
+            rhs[idx] = best;
+        }
+        update_open(idx);
+    }
+
+    void update_open(uint32_t idx) {
+        if (g[idx] != rhs[idx])
+            push(idx);
+        else
+            in_open[idx] = 0;
+    }
+
+    void compute_shortest_path() {
+        uint32_t start_idx = graph.node_index(start);
+        while (true) {
+            drop_stale();
+            if (!open_set.size())
+                break;
+            if (!(open_set.front().key < calc_key(start_idx)) && rhs[start_idx] <= g[start_idx])
+                break;
+
+            key_t old_key = open_set.front().key;
+            uint32_t idx = open_set.front().idx;
+            std::pop_heap(open_set.begin(), open_set.end(), compare_fn);
+            open_set.pop_back();
+            in_open[idx] = 0;
+
+            key_t new_key = calc_key(idx);
+            if (old_key < new_key) {
+                push(idx);
+                continue;
+            }
+            /* the costs are symmetric, so the neighbors of the node are also the nodes that have
+            an edge to it. When it's g goes down they can only get a lower rhs through it, that
+            doesn't need their other neighbors. When it goes up only the ones whose rhs came
+            through it have to look at all their neighbors again */
+            expanded++;
+            node_t node = graph.index_node(idx);
+            if (g[idx] > rhs[idx]) {
+                cost_t g_new = rhs[idx];
+                g[idx] = g_new;
+                graph.for_each_neighbor(node, [&](const node_t& neigh, cost_t cost) {
+                    uint32_t neigh_idx = graph.node_index(neigh);
+                    if (cost + g_new < rhs[neigh_idx] && !(neigh == goal)) {
+                        rhs[neigh_idx] = cost + g_new;
+                        update_open(neigh_idx);
+                    }
+                });
+            }
+            else {
+                cost_t g_old = g[idx];
+                g[idx] = inf;
+                graph.for_each_neighbor(node, [&](const node_t& neigh, cost_t cost) {
+                    if (rhs[graph.node_index(neigh)] == cost + g_old)
+                        update_node(neigh);
+                });
+                update_open(idx);
+            }
+        }
+    }
+};
+
+#endif
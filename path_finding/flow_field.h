@@ -0,0 +1,198 @@
+#ifndef FLOW_FIELD_H
+#define FLOW_FIELD_H
+
+#include "path_finding.h"
+
+#include <limits>
+#include <list>
+#include <memory>
+
+/* Flow fields for the uniform cost mode of matrix_graph_wraper_t: the cost from every cell to one
+goal, and for every cell the direction of the next step towards that goal. When many units go to
+the same place the field is computed once and then each unit only reads the direction of the cell
+it is in, in O(1), instead of running it's own search.
+
+The costs are computed with a sweeping wavefront instead of a Dijkstra: the rows are relaxed from
+the row above (top to bottom), then from the row below (bottom to top), until nothing changes. The
+relaxation from the neighbor row is a branchless loop over contiguous arrays that the compiler
+vectorizes, only the relaxation from the left and right neighbors inside a row is a sequential
+scan. Each row starts from the one swept before it, so the rows of a sweep can't be relaxed in
+parallel. Every pass is a pass of Bellman-Ford, so the result is exact, the number of passes grows with
+the number of turns the paths have to take, not with the size of the map.
+
+    flow_field_t::compute(grid, goal) - fills dist and dir for the given goal, the grid must
+                                        outlive the field unless it's given as a shared_ptr
+    flow_field_t::next(node) - the neighbor to step to, or node itself at the goal or if the goal
+                               can't be reached from it
+    flow_field_cache_t::get(goal) - the field for the goal, computed only if it's not cached
+    flow_field_cache_t::invalidate() - must be called after the terrain changes
+*/
+
+template <typename graph_t>
+struct flow_field_t {
+    using node_t = typename graph_t::node_t;
+
+    static_assert(graph_t::uniform_cost, "flow fields need PATH_FINDING_FLAG_UNIFORM_COST");
+    static constexpr bool diag = graph_t::neigh_cnt == 8;
+    static constexpr float inf = std::numeric_limits<float>::infinity();
+    static constexpr uint8_t no_dir = 0xff;
+
+    const passable_grid_t *grid = nullptr;
+    std::shared_ptr<const passable_grid_t> grid_ref;    /* set if the field keeps it's grid alive */
+    node_t goal;
+    std::vector<float> dist;        /* indexed like the passable grid, walls stay at inf */
+    std::vector<uint8_t> dir;       /* index in graph_t::neigh_dirs or no_dir */
+    uint32_t passes = 0;            /* sweep passes needed by the last compute */
+
+    void compute(const passable_grid_t& grid, const node_t& goal) {
+        this->grid = &grid;
+        this->goal = goal;
+        dist.assign(grid.cells.size(), inf);
+        dir.assign(grid.cells.size(), no_dir);
+        passes = 0;
+        if (!grid.is_free(goal.x, goal.y))
+            return;
+        dist[grid.index(goal.x, goal.y)] = 0;
+
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (int32_t y = 0; y < grid.height; y++)
+                changed |= sweep_row(y, -1);
+            for (int32_t y = grid.height - 1; y >= 0; y--)
+                changed |= sweep_row(y, +1);
+            passes++;
+        }
+        compute_dirs();
+    }
+
+    void compute(std::shared_ptr<const passable_grid_t> grid, const node_t& goal) {
+        compute(*grid, goal);
+        grid_ref = std::move(grid);
+    }
+
+    node_t next(const node_t& node) const {
+        uint8_t d = dir[grid->index(node.x, node.y)];
+        if (d == no_dir)
+            return node;
+        auto [dx, dy] = graph_t::neigh_dirs[d];
+        return node_t{node.x + dx, node.y + dy};
+    }
+
+    float cost(const node_t& node) const { return dist[grid->index(node.x, node.y)]; }
+
+    /* relaxes row y from the row y + dy and then from the left and right neighbors, the loads are
+    done for every cell and the walls only select the step costs, so the first loop has no branches
+    and vectorizes. After the first pass a row that didn't change from the row y + dy is already
+    relaxed from it's own neighbors and the two scans are skipped. */
+    bool sweep_row(int32_t y, int32_t dy) {
+        const float diag_cost = sqrt(2);
+        int32_t w = grid->width;
+        float *row = &dist[grid->index(0, y)];
+        const float *oth = row + dy * grid->stride;
+        const uint8_t *free = &grid->cells[grid->index(0, y)];
+        const uint8_t *oth_free = free + dy * grid->stride;
+
+        int changed = 0;
+        for (int32_t x = 0; x < w; x++) {
+            float best = oth[x] + 1.0f;
+            if constexpr (diag) {
+                float left = oth[x - 1] + ((oth_free[x] & free[x - 1]) ? diag_cost : inf);
+                float right = oth[x + 1] + ((oth_free[x] & free[x + 1]) ? diag_cost : inf);
+                best = std::min(best, std::min(left, right));
+            }
+            float new_dist = std::min(row[x], best) + (free[x] ? 0.0f : inf);
+            changed |= new_dist < row[x];
+            row[x] = new_dist;
+        }
+        if (!changed && passes > 0)
+            return false;
+        for (int32_t x = 0; x < w; x++) {
+            if (free[x] && row[x - 1] + 1.0f < row[x]) {
+                row[x] = row[x - 1] + 1.0f;
+                changed = 1;
+            }
+        }
+        for (int32_t x = w - 1; x >= 0; x--) {
+            if (free[x] && row[x + 1] + 1.0f < row[x]) {
+                row[x] = row[x + 1] + 1.0f;
+                changed = 1;
+            }
+        }
+        return changed;
+    }
+
+    /* the direction of a cell goes to the neighbor with the smallest cost through it */
+    void compute_dirs() {
+        const float diag_cost = sqrt(2);
+        for (int32_t y = 0; y < grid->height; y++) {
+            for (int32_t x = 0; x < grid->width; x++) {
+                uint32_t idx = grid->index(x, y);
+                if (!grid->is_free(idx) || dist[idx] == 0 || dist[idx] == inf)
+                    continue;
+                float best = inf;
+                for (uint8_t d = 0; d < graph_t::neigh_cnt; d++) {
+                    auto [dx, dy] = graph_t::neigh_dirs[d];
+                    uint32_t n = idx + dx + dy * grid->stride;
+                    float step = 1.0f;
+                    if (dx && dy) {
+                        if (!grid->is_free(idx + dx) || !grid->is_free(idx + dy * grid->stride))
+                            continue;
+                        step = diag_cost;
+                    }
+                    if (dist[n] + step < best) {
+                        best = dist[n] + step;
+                        dir[idx] = d;
+                    }
+                }
+            }
+        }
+    }
+};
+
+/* Keeps the fields of the last max_fields goals, the least recently used one is dropped first.
+All the fields share the passable grid, after invalidate() a new grid is built from the graph and
+the fields that are still held outside the cache keep the old one. */
+template <typename graph_t>
+struct flow_field_cache_t {
+    using node_t = typename graph_t::node_t;
+    using field_t = flow_field_t<graph_t>;
+
+    const graph_t &graph;
+    size_t max_fields;
+    std::shared_ptr<const passable_grid_t> grid;     /* null until the next get() */
+    std::list<std::shared_ptr<field_t>> fields;     /* most recently used first */
+
+    flow_field_cache_t(const graph_t &graph, size_t max_fields = 16)
+    : graph(graph), max_fields(max_fields)
+    {}
+
+    /* the returned field stays valid after it is evicted and after invalidate(), it keeps the grid
+    it was computed on (so it describes the terrain as it was then) */
+    std::shared_ptr<field_t> get(const node_t& goal) {
+        if (!grid) {
+            auto new_grid = std::make_shared<passable_grid_t>();
+            new_grid->build(graph);
+            grid = std::move(new_grid);
+        }
+        for (auto it = fields.begin(); it != fields.end(); it++) {
+            if ((*it)->goal == goal) {
+                fields.splice(fields.begin(), fields, it);
+                return fields.front();
+            }
+        }
+        auto field = std::make_shared<field_t>();
+        field->compute(grid, goal);
+        fields.push_front(field);
+        if (fields.size() > max_fields)
+            fields.pop_back();
+        return field;
+    }
+
+    void invalidate() {
+        grid.reset();
+        fields.clear();
+    }
+};
+
+#endif
@@ -0,0 +1,782 @@
+#ifndef GPU_FIELD_H
+#define GPU_FIELD_H
+
+#include "path_finding.h"
+
+#include <vulkan/vulkan.h>
+#include <glslang/Public/ShaderLang.h>
+#include <glslang/SPIRV/GlslangToSpv.h>
+
+#include <chrono>
+#include <stdexcept>
+
+/* Distance fields for many goals at once on the gpu: a compute shader relaxes every cell of every
+field from it's neighbors (a pass of Bellman-Ford, like the sweeps of flow_field.h, but all the
+cells in parallel), over and over until a pass changes nothing. The fields are the layers of one
+r32f storage image, so a single dispatch advances all the goals. The walls are read by the shader
+from the terrain image the viewer already has on the device (the one of load_image, black opaque
+pixels are walls), nothing is uploaded for them. The paths are then walked on the cpu, downhill
+over the field that was read back.
+
+It only needs a vulkan device with a compute queue, a software one is fine: with mesa's lavapipe
+installed it runs on the cpu (VK_ICD_FILENAMES can point the loader to lvp_icd.x86_64.json if there
+is a gpu as well).
+
+    gpu_field_solver_t(diag) - creates it's own instance and device, for the headless test, diag
+            selects the 8 neighbor moves (no cutting of corners, like the graph) instead of 4
+    gpu_field_solver_t(diag, phy_dev, dev, queue_family, queue) - on the device of the viewer, it's
+            only borrowed, the queue must have compute (the graphics queue does)
+    upload_terrain(pixels, w, h) - a terrain image made from rgba pixels, like load_image does, for
+            when there is no viewer, it belongs to the solver
+    solve(terrain, grid, goals) - the fields of the goals over the walls of the terrain image
+            (r8g8b8a8 srgb, in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL), grid is the
+            passable_grid_t of the same map, for the goals. As one vector: the field of goal i is
+            [i * width * height, (i + 1) * width * height), row major, unreachable cells and walls
+            are gpu_field_inf
+    device_name - the name of the physical device that was picked (llvmpipe for lavapipe)
+    iterations, batches - the relaxation passes and the submits of the last solve
+
+    field_path(field, grid, diag, start) - the path from start to the goal of the field, in the
+            format of a_star_path, empty if the goal can't be reached
+
+The number of passes is the length in cells of the longest shortest path (less, in practice, cells
+that are updated early in a pass are read by the later ones), so the gpu pays off with many goals
+on maps that are not mazes. Each submit runs batch_passes passes and only the flag of the last one
+is read, the solve stops after the first pass that doesn't change anything. An image can't have
+more layers than maxImageArrayLayers (2048 on most devices), more goals are solved in groups.
+*/
+
+static constexpr float gpu_field_inf = 3.0e38f;
+
+template <typename node_t>
+std::vector<node_t> field_path(const float *field, const passable_grid_t& grid, bool diag,
+        const node_t& start)
+{
+    const float diag_cost = sqrt(2);
+    auto at = [&](int32_t x, int32_t y) { return field[size_t(y) * grid.width + x]; };
+    if (!grid.is_free(start.x, start.y) || at(start.x, start.y) >= gpu_field_inf)
+        return {};
+
+    /* each step goes to the neighbor with the lowest cost to the goal through it, among the ones
+    closer to the goal, so the walk can't loop, the border of the grid stops it at the edges */
+    std::vector<node_t> ret{start};
+    node_t curr = start;
+    while (at(curr.x, curr.y) > 0) {
+        node_t best = curr;
+        float best_cost = gpu_field_inf;
+        for (int32_t dy = -1; dy <= 1; dy++) {
+            for (int32_t dx = -1; dx <= 1; dx++) {
+                bool is_diag = dx && dy;
+                if ((!dx && !dy) || (is_diag && !diag))
+                    continue;
+                if (!grid.is_free(curr.x + dx, curr.y + dy))
+                    continue;
+                if (is_diag && (!grid.is_free(curr.x + dx, curr.y) ||
+                        !grid.is_free(curr.x, curr.y + dy)))
+                    continue;
+                float neigh = at(curr.x + dx, curr.y + dy);
+                float cost = neigh + (is_diag ? diag_cost : 1.f);
+                if (neigh < at(curr.x, curr.y) && cost < best_cost) {
+                    best_cost = cost;
+                    best = node_t{curr.x + dx, curr.y + dy};
+                }
+            }
+        }
+
+        /* a reachable cell always has a neighbor closer to the goal, unless the field is broken */
+        if (best == curr)
+            return {};
+        curr = best;
+        ret.push_back(curr);
+    }
+    std::reverse(ret.begin(), ret.end());
+    return ret;
+}
+
+struct gpu_field_solver_t {
+    static constexpr uint32_t group_size = 8;
+    static constexpr uint32_t batch_passes = 32;
+
+    bool diag;
+    std::string device_name;
+    uint64_t iterations = 0;
+    uint64_t batches = 0;
+
+    gpu_field_solver_t(bool diag) : diag(diag) {
+        create_device();
+        init();
+    }
+
+    gpu_field_solver_t(bool diag, VkPhysicalDevice phy_dev, VkDevice dev, uint32_t queue_family,
+            VkQueue queue)
+    : diag(diag), owns_dev(false), phys_dev(phy_dev), dev(dev), queue(queue),
+            queue_family(queue_family)
+    {
+        VkPhysicalDeviceProperties props;
+        vkGetPhysicalDeviceProperties(phys_dev, &props);
+        device_name = props.deviceName;
+        init();
+    }
+
+    ~gpu_field_solver_t() {
+        if (!dev)
+            return;
+        vkDeviceWaitIdle(dev);
+        free_buffers();
+        if (terrain_view)
+            vkDestroyImageView(dev, terrain_view, nullptr);
+        if (own_terrain) {
+            vkDestroyImage(dev, own_terrain, nullptr);
+            vkFreeMemory(dev, own_terrain_mem, nullptr);
+        }
+        vkDestroySampler(dev, sampler, nullptr);
+        vkDestroyFence(dev, fence, nullptr);
+        vkDestroyCommandPool(dev, cmd_pool, nullptr);
+        vkDestroyDescriptorPool(dev, desc_pool, nullptr);
+        vkDestroyPipeline(dev, pipeline, nullptr);
+        vkDestroyPipelineLayout(dev, pipeline_layout, nullptr);
+        vkDestroyDescriptorSetLayout(dev, desc_layout, nullptr);
+        vkDestroyShaderModule(dev, shader, nullptr);
+        if (owns_dev) {
+            vkDestroyDevice(dev, nullptr);
+            vkDestroyInstance(instance, nullptr);
+        }
+    }
+
+    gpu_field_solver_t(const gpu_field_solver_t&) = delete;
+    gpu_field_solver_t& operator = (const gpu_field_solver_t&) = delete;
+
+    VkImage upload_terrain(const void *pixels, uint32_t w, uint32_t h) {
+        if (own_terrain) {
+            vkDeviceWaitIdle(dev);
+            if (terrain_img == own_terrain) {
+                vkDestroyImageView(dev, terrain_view, nullptr);
+                terrain_view = VK_NULL_HANDLE;
+                terrain_img = VK_NULL_HANDLE;
+            }
+            vkDestroyImage(dev, own_terrain, nullptr);
+            vkFreeMemory(dev, own_terrain_mem, nullptr);
+        }
+        VkImageCreateInfo img_info = image_info(w, h, 1, VK_FORMAT_R8G8B8A8_SRGB,
+                VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+        check(vkCreateImage(dev, &img_info, nullptr, &own_terrain), "vkCreateImage");
+        VkMemoryRequirements req;
+        vkGetImageMemoryRequirements(dev, own_terrain, &req);
+        own_terrain_mem = alloc_memory(req, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        check(vkBindImageMemory(dev, own_terrain, own_terrain_mem, 0), "vkBindImageMemory");
+
+        buffer_t staging = make_buffer(size_t(w) * h * 4, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+        memcpy(staging.data, pixels, size_t(w) * h * 4);
+        begin_cmds();
+        image_barrier(own_terrain, 1, VK_IMAGE_LAYOUT_UNDEFINED,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+                VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+        VkBufferImageCopy region = image_region(w, h, 1);
+        vkCmdCopyBufferToImage(cmd, staging.buff, own_terrain,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+        image_barrier(own_terrain, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT,
+                VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        submit_cmds();
+        free_buffer(staging);
+        return own_terrain;
+    }
+
+    template <typename node_t>
+    std::vector<float> solve(VkImage terrain, const passable_grid_t& grid,
+            const std::vector<node_t>& goals)
+    {
+        uint32_t w = grid.width, h = grid.height;
+        size_t cell_cnt = size_t(w) * h;
+        iterations = 0;
+        batches = 0;
+        if (goals.empty() || !cell_cnt)
+            return {};
+        bind_terrain(terrain);
+        alloc_buffers(w, h, std::min<size_t>(goals.size(), max_layers));
+
+        std::vector<float> ret(cell_cnt * goals.size());
+        for (size_t first = 0; first < goals.size(); first += alloc_layers) {
+            uint32_t cnt = std::min<size_t>(alloc_layers, goals.size() - first);
+            solve_layers(grid, &goals[first], cnt, ret.data() + first * cell_cnt);
+        }
+        return ret;
+    }
+
+private:
+    struct buffer_t {
+        VkBuffer buff = VK_NULL_HANDLE;
+        VkDeviceMemory mem = VK_NULL_HANDLE;
+        void *data = nullptr;       /* all the buffers are host visible and stay mapped */
+    };
+
+    bool owns_dev = true;
+    uint32_t max_layers = 1;
+    VkInstance instance = VK_NULL_HANDLE;
+    VkPhysicalDevice phys_dev = VK_NULL_HANDLE;
+    VkDevice dev = VK_NULL_HANDLE;
+    VkQueue queue = VK_NULL_HANDLE;
+    uint32_t queue_family = 0;
+
+    VkShaderModule shader = VK_NULL_HANDLE;
+    VkDescriptorSetLayout desc_layout = VK_NULL_HANDLE;
+    VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkDescriptorPool desc_pool = VK_NULL_HANDLE;
+    VkDescriptorSet desc_set = VK_NULL_HANDLE;
+    VkCommandPool cmd_pool = VK_NULL_HANDLE;
+    VkCommandBuffer cmd = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+    VkSampler sampler = VK_NULL_HANDLE;
+
+    /* the view of the terrain of the last solve, the image itself isn't owned unless it was made
+    by upload_terrain() */
+    VkImage terrain_img = VK_NULL_HANDLE;
+    VkImageView terrain_view = VK_NULL_HANDLE;
+    VkImage own_terrain = VK_NULL_HANDLE;
+    VkDeviceMemory own_terrain_mem = VK_NULL_HANDLE;
+
+    /* sized for the last solve, they are only made again if the map or the goal count changes */
+    uint32_t alloc_w = 0, alloc_h = 0, alloc_layers = 0;
+    VkImage image = VK_NULL_HANDLE;
+    VkDeviceMemory image_mem = VK_NULL_HANDLE;
+    VkImageView image_view = VK_NULL_HANDLE;
+    buffer_t flag_buff;
+    buffer_t staging_buff;
+
+    /* cnt goals in the first cnt layers of the image, the fields are copied to out */
+    template <typename node_t>
+    void solve_layers(const passable_grid_t& grid, const node_t *goals, uint32_t cnt, float *out) {
+        uint32_t w = grid.width, h = grid.height;
+        size_t cell_cnt = size_t(w) * h;
+
+        /* the start of the fields: 0 at the goal */
+        float *init = (float *)staging_buff.data;
+        std::fill_n(init, cell_cnt * cnt, gpu_field_inf);
+        for (uint32_t i = 0; i < cnt; i++)
+            if (grid.is_free(goals[i].x, goals[i].y))
+                init[i * cell_cnt + goals[i].y * w + goals[i].x] = 0;
+
+        begin_cmds();
+        image_barrier(image, alloc_layers, VK_IMAGE_LAYOUT_UNDEFINED,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+                VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+        VkBufferImageCopy region = image_region(w, h, cnt);
+        vkCmdCopyBufferToImage(cmd, staging_buff.buff, image,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+        image_barrier(image, alloc_layers, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_TRANSFER_WRITE_BIT,
+                VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        submit_cmds();
+
+        struct { int32_t width, height, diag; } params{int32_t(w), int32_t(h), diag};
+        volatile uint32_t *changed = (uint32_t *)flag_buff.data;
+        do {
+            begin_cmds();
+            vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout, 0, 1,
+                    &desc_set, 0, nullptr);
+            vkCmdPushConstants(cmd, pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                    sizeof(params), &params);
+            for (uint32_t i = 0; i < batch_passes; i++) {
+                /* only the last pass of the batch raises the flag that is read */
+                if (i == batch_passes - 1) {
+                    vkCmdFillBuffer(cmd, flag_buff.buff, 0, VK_WHOLE_SIZE, 0);
+                    memory_barrier(VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+                }
+                vkCmdDispatch(cmd, (w + group_size - 1) / group_size,
+                        (h + group_size - 1) / group_size, cnt);
+                memory_barrier(VK_ACCESS_SHADER_WRITE_BIT,
+                        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+            }
+            memory_barrier(VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT,
+                    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT);
+            submit_cmds();
+            iterations += batch_passes;
+            batches++;
+        } while (*changed);
+
+        begin_cmds();
+        memory_barrier(VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+        vkCmdCopyImageToBuffer(cmd, image, VK_IMAGE_LAYOUT_GENERAL, staging_buff.buff, 1,
+                &region);
+        memory_barrier(VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT);
+        submit_cmds();
+
+        std::copy_n((float *)staging_buff.data, cell_cnt * cnt, out);
+    }
+
+    static void check(VkResult res, const char *what) {
+        if (res != VK_SUCCESS)
+            throw std::runtime_error(std::string(what) + " failed: " + std::to_string(res));
+    }
+
+    void create_device() {
+        VkApplicationInfo app_info{};
+        app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+        app_info.pApplicationName = "gpu_field";
+        app_info.apiVersion = VK_API_VERSION_1_1;
+
+        VkInstanceCreateInfo inst_info{};
+        inst_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+        inst_info.pApplicationInfo = &app_info;
+        check(vkCreateInstance(&inst_info, nullptr, &instance), "vkCreateInstance");
+
+        uint32_t dev_cnt = 0;
+        vkEnumeratePhysicalDevices(instance, &dev_cnt, nullptr);
+        std::vector<VkPhysicalDevice> devs(dev_cnt);
+        vkEnumeratePhysicalDevices(instance, &dev_cnt, devs.data());
+
+        /* the first device with a compute queue, a real gpu before a software one */
+        int best_score = -1;
+        for (auto d : devs) {
+            uint32_t fam_cnt = 0;
+            vkGetPhysicalDeviceQueueFamilyProperties(d, &fam_cnt, nullptr);
+            std::vector<VkQueueFamilyProperties> fams(fam_cnt);
+            vkGetPhysicalDeviceQueueFamilyProperties(d, &fam_cnt, fams.data());
+
+            VkPhysicalDeviceProperties props;
+            vkGetPhysicalDeviceProperties(d, &props);
+            int score = props.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU ? 0 : 1;
+            for (uint32_t i = 0; i < fam_cnt; i++) {
+                if (!(fams[i].queueFlags & VK_QUEUE_COMPUTE_BIT) || score <= best_score)
+                    continue;
+                best_score = score;
+                phys_dev = d;
+                queue_family = i;
+                device_name = props.deviceName;
+            }
+        }
+        if (!phys_dev)
+            throw std::runtime_error("no vulkan device with a compute queue");
+
+        float priority = 1;
+        VkDeviceQueueCreateInfo queue_info{};
+        queue_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queue_info.queueFamilyIndex = queue_family;
+        queue_info.queueCount = 1;
+        queue_info.pQueuePriorities = &priority;
+
+        VkDeviceCreateInfo dev_info{};
+        dev_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        dev_info.queueCreateInfoCount = 1;
+        dev_info.pQueueCreateInfos = &queue_info;
+        check(vkCreateDevice(phys_dev, &dev_info, nullptr, &dev), "vkCreateDevice");
+        vkGetDeviceQueue(dev, queue_family, 0, &queue);
+    }
+
+    void init() {
+        VkPhysicalDeviceProperties props;
+        vkGetPhysicalDeviceProperties(phys_dev, &props);
+        max_layers = props.limits.maxImageArrayLayers;
+
+        VkCommandPoolCreateInfo pool_info{};
+        pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        pool_info.queueFamilyIndex = queue_family;
+        check(vkCreateCommandPool(dev, &pool_info, nullptr, &cmd_pool), "vkCreateCommandPool");
+
+        VkCommandBufferAllocateInfo cmd_info{};
+        cmd_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        cmd_info.commandPool = cmd_pool;
+        cmd_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        cmd_info.commandBufferCount = 1;
+        check(vkAllocateCommandBuffers(dev, &cmd_info, &cmd), "vkAllocateCommandBuffers");
+
+        VkFenceCreateInfo fence_info{};
+        fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        check(vkCreateFence(dev, &fence_info, nullptr, &fence), "vkCreateFence");
+
+        /* only texelFetch() is used on the terrain, the filter doesn't matter */
+        VkSamplerCreateInfo sampl_info{};
+        sampl_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        sampl_info.magFilter = VK_FILTER_NEAREST;
+        sampl_info.minFilter = VK_FILTER_NEAREST;
+        sampl_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        sampl_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        sampl_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        check(vkCreateSampler(dev, &sampl_info, nullptr, &sampler), "vkCreateSampler");
+
+        create_pipeline();
+    }
+
+    /* One invocation per cell and per field. The cells are updated in place, a pass may read
+    values of the same pass, that only makes it converge faster. The walls are the black opaque
+    pixels of the terrain (0xff000000, the test of load_image) and have no distance, a diagonal
+    needs both cells beside it to be free. */
+    static constexpr const char *shader_src = R"___(
+        #version 450
+
+        layout(local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+
+        layout(binding = 0, r32f) uniform coherent image2DArray dist;
+        layout(binding = 1) uniform sampler2D terrain;
+        layout(binding = 2) buffer flag_t { uint changed; };
+
+        layout(push_constant) uniform params_t {
+            int width;
+            int height;
+            int diag;
+        } params;
+
+        bool is_free(ivec2 p) {
+            return p.x >= 0 && p.y >= 0 && p.x < params.width && p.y < params.height &&
+                    texelFetch(terrain, p, 0) != vec4(0, 0, 0, 1);
+        }
+
+        void main() {
+            ivec3 p = ivec3(gl_GlobalInvocationID);
+            if (!is_free(p.xy))
+                return;
+
+            float d = imageLoad(dist, p).r;
+            float best = d;
+            for (int dy = -1; dy <= 1; dy++) {
+                for (int dx = -1; dx <= 1; dx++) {
+                    bool is_diag = dx != 0 && dy != 0;
+                    if ((dx == 0 && dy == 0) || (is_diag && params.diag == 0))
+                        continue;
+                    ivec2 n = p.xy + ivec2(dx, dy);
+                    if (!is_free(n))
+                        continue;
+                    if (is_diag && (!is_free(ivec2(n.x, p.y)) || !is_free(ivec2(p.x, n.y))))
+                        continue;
+                    float step = is_diag ? 1.41421356 : 1.0;
+                    best = min(best, imageLoad(dist, ivec3(n, p.z)).r + step);
+                }
+            }
+            if (best < d) {
+                imageStore(dist, p, vec4(best));
+                changed = 1;
+            }
+        }
+    )___";
+
+    static std::vector<uint32_t> compile_shader(const char *src) {
+        static bool glslang_init = glslang::InitializeProcess();
+        (void)glslang_init;
+
+        /* only the compute limits matter for this shader */
+        TBuiltInResource res{};
+        res.maxComputeWorkGroupCountX = 65535;
+        res.maxComputeWorkGroupCountY = 65535;
+        res.maxComputeWorkGroupCountZ = 65535;
+        res.maxComputeWorkGroupSizeX = 1024;
+        res.maxComputeWorkGroupSizeY = 1024;
+        res.maxComputeWorkGroupSizeZ = 64;
+        res.maxComputeImageUniforms = 8;
+        res.maxCombinedTextureImageUnits = 8;
+        res.maxTextureImageUnits = 8;
+        res.maxCombinedImageUniforms = 8;
+        res.maxCombinedShaderOutputResources = 8;
+        res.limits.nonInductiveForLoops = true;
+        res.limits.whileLoops = true;
+        res.limits.doWhileLoops = true;
+        res.limits.generalUniformIndexing = true;
+        res.limits.generalAttributeMatrixVectorIndexing = true;
+        res.limits.generalVaryingIndexing = true;
+        res.limits.generalSamplerIndexing = true;
+        res.limits.generalVariableIndexing = true;
+        res.limits.generalConstantMatrixVectorIndexing = true;
+
+        glslang::TShader sh(EShLangCompute);
+        sh.setStrings(&src, 1);
+        sh.setEnvInput(glslang::EShSourceGlsl, EShLangCompute, glslang::EShClientVulkan, 100);
+        sh.setEnvClient(glslang::EShClientVulkan, glslang::EShTargetVulkan_1_1);
+        sh.setEnvTarget(glslang::EShTargetSpv, glslang::EShTargetSpv_1_3);
+        auto msgs = EShMessages(EShMsgSpvRules | EShMsgVulkanRules);
+        if (!sh.parse(&res, 450, false, msgs))
+            throw std::runtime_error(std::string("shader: ") + sh.getInfoLog());
+
+        glslang::TProgram program;
+        program.addShader(&sh);
+        if (!program.link(msgs))
+            throw std::runtime_error(std::string("shader link: ") + program.getInfoLog());
+
+        std::vector<uint32_t> spirv;
+        glslang::GlslangToSpv(*program.getIntermediate(EShLangCompute), spirv);
+        return spirv;
+    }
+
+    void create_pipeline() {
+        auto spirv = compile_shader(shader_src);
+        VkShaderModuleCreateInfo sh_info{};
+        sh_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        sh_info.codeSize = spirv.size() * sizeof(spirv[0]);
+        sh_info.pCode = spirv.data();
+        check(vkCreateShaderModule(dev, &sh_info, nullptr, &shader), "vkCreateShaderModule");
+
+        VkDescriptorSetLayoutBinding binds[3]{};
+        VkDescriptorType types[3] = {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER};
+        for (uint32_t i = 0; i < 3; i++) {
+            binds[i].binding = i;
+            binds[i].descriptorType = types[i];
+            binds[i].descriptorCount = 1;
+            binds[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+        VkDescriptorSetLayoutCreateInfo layout_info{};
+        layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layout_info.bindingCount = 3;
+        layout_info.pBindings = binds;
+        check(vkCreateDescriptorSetLayout(dev, &layout_info, nullptr, &desc_layout),
+                "vkCreateDescriptorSetLayout");
+
+        VkPushConstantRange push_range{VK_SHADER_STAGE_COMPUTE_BIT, 0, 3 * sizeof(int32_t)};
+        VkPipelineLayoutCreateInfo pl_layout_info{};
+        pl_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pl_layout_info.setLayoutCount = 1;
+        pl_layout_info.pSetLayouts = &desc_layout;
+        pl_layout_info.pushConstantRangeCount = 1;
+        pl_layout_info.pPushConstantRanges = &push_range;
+        check(vkCreatePipelineLayout(dev, &pl_layout_info, nullptr, &pipeline_layout),
+                "vkCreatePipelineLayout");
+
+        VkComputePipelineCreateInfo pl_info{};
+        pl_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pl_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pl_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pl_info.stage.module = shader;
+        pl_info.stage.pName = "main";
+        pl_info.layout = pipeline_layout;
+        check(vkCreateComputePipelines(dev, VK_NULL_HANDLE, 1, &pl_info, nullptr, &pipeline),
+                "vkCreateComputePipelines");
+
+        VkDescriptorPoolSize pool_sizes[3] = {
+            {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1},
+            {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1},
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1},
+        };
+        VkDescriptorPoolCreateInfo pool_info{};
+        pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        pool_info.maxSets = 1;
+        pool_info.poolSizeCount = 3;
+        pool_info.pPoolSizes = pool_sizes;
+        check(vkCreateDescriptorPool(dev, &pool_info, nullptr, &desc_pool),
+                "vkCreateDescriptorPool");
+
+        VkDescriptorSetAllocateInfo set_info{};
+        set_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        set_info.descriptorPool = desc_pool;
+        set_info.descriptorSetCount = 1;
+        set_info.pSetLayouts = &desc_layout;
+        check(vkAllocateDescriptorSets(dev, &set_info, &desc_set), "vkAllocateDescriptorSets");
+    }
+
+    uint32_t memory_type(uint32_t type_bits, VkMemoryPropertyFlags flags) {
+        VkPhysicalDeviceMemoryProperties props;
+        vkGetPhysicalDeviceMemoryProperties(phys_dev, &props);
+        for (uint32_t i = 0; i < props.memoryTypeCount; i++)
+            if ((type_bits & (1u << i)) && (props.memoryTypes[i].propertyFlags & flags) == flags)
+                return i;
+        throw std::runtime_error("no suitable vulkan memory type");
+    }
+
+    VkDeviceMemory alloc_memory(VkMemoryRequirements req, VkMemoryPropertyFlags flags) {
+        VkMemoryAllocateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        info.allocationSize = req.size;
+        info.memoryTypeIndex = memory_type(req.memoryTypeBits, flags);
+        VkDeviceMemory mem;
+        check(vkAllocateMemory(dev, &info, nullptr, &mem), "vkAllocateMemory");
+        return mem;
+    }
+
+    buffer_t make_buffer(VkDeviceSize size, VkBufferUsageFlags usage) {
+        buffer_t ret;
+        VkBufferCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        info.size = size;
+        info.usage = usage;
+        info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        check(vkCreateBuffer(dev, &info, nullptr, &ret.buff), "vkCreateBuffer");
+
+        VkMemoryRequirements req;
+        vkGetBufferMemoryRequirements(dev, ret.buff, &req);
+        ret.mem = alloc_memory(req, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        check(vkBindBufferMemory(dev, ret.buff, ret.mem, 0), "vkBindBufferMemory");
+        check(vkMapMemory(dev, ret.mem, 0, VK_WHOLE_SIZE, 0, &ret.data), "vkMapMemory");
+        return ret;
+    }
+
+    void free_buffer(buffer_t& b) {
+        if (!b.buff)
+            return;
+        vkDestroyBuffer(dev, b.buff, nullptr);
+        vkFreeMemory(dev, b.mem, nullptr);
+        b = buffer_t{};
+    }
+
+    void free_buffers() {
+        free_buffer(flag_buff);
+        free_buffer(staging_buff);
+        if (image) {
+            vkDestroyImageView(dev, image_view, nullptr);
+            vkDestroyImage(dev, image, nullptr);
+            vkFreeMemory(dev, image_mem, nullptr);
+            image = VK_NULL_HANDLE;
+        }
+    }
+
+    static VkImageCreateInfo image_info(uint32_t w, uint32_t h, uint32_t layers, VkFormat format,
+            VkImageUsageFlags usage)
+    {
+        VkImageCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        info.imageType = VK_IMAGE_TYPE_2D;
+        info.format = format;
+        info.extent = {w, h, 1};
+        info.mipLevels = 1;
+        info.arrayLayers = layers;
+        info.samples = VK_SAMPLE_COUNT_1_BIT;
+        info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        info.usage = usage;
+        info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        return info;
+    }
+
+    void bind_terrain(VkImage terrain) {
+        if (terrain == terrain_img)
+            return;
+        if (terrain_view) {
+            vkDeviceWaitIdle(dev);
+            vkDestroyImageView(dev, terrain_view, nullptr);
+        }
+        terrain_img = terrain;
+
+        VkImageViewCreateInfo view_info{};
+        view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        view_info.image = terrain;
+        view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        view_info.format = VK_FORMAT_R8G8B8A8_SRGB;
+        view_info.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        check(vkCreateImageView(dev, &view_info, nullptr, &terrain_view), "vkCreateImageView");
+
+        VkDescriptorImageInfo terrain_desc{sampler, terrain_view,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        VkWriteDescriptorSet write{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = desc_set;
+        write.dstBinding = 1;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo = &terrain_desc;
+        vkUpdateDescriptorSets(dev, 1, &write, 0, nullptr);
+    }
+
+    void alloc_buffers(uint32_t w, uint32_t h, uint32_t layers) {
+        if (w == alloc_w && h == alloc_h && layers == alloc_layers)
+            return;
+        if (layers > max_layers)
+            throw std::runtime_error("gpu field: " + std::to_string(layers) + " layers, the "
+                    "device allows " + std::to_string(max_layers));
+        vkDeviceWaitIdle(dev);
+        free_buffers();
+        alloc_w = w;
+        alloc_h = h;
+        alloc_layers = layers;
+
+        size_t cell_cnt = size_t(w) * h;
+        flag_buff = make_buffer(sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+        staging_buff = make_buffer(cell_cnt * layers * sizeof(float),
+                VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+        VkImageCreateInfo img_info = image_info(w, h, layers, VK_FORMAT_R32_SFLOAT,
+                VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+        check(vkCreateImage(dev, &img_info, nullptr, &image), "vkCreateImage");
+
+        VkMemoryRequirements req;
+        vkGetImageMemoryRequirements(dev, image, &req);
+        image_mem = alloc_memory(req, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        check(vkBindImageMemory(dev, image, image_mem, 0), "vkBindImageMemory");
+
+        VkImageViewCreateInfo view_info{};
+        view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        view_info.image = image;
+        view_info.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+        view_info.format = VK_FORMAT_R32_SFLOAT;
+        view_info.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, layers};
+        check(vkCreateImageView(dev, &view_info, nullptr, &image_view), "vkCreateImageView");
+
+        VkDescriptorImageInfo img_desc{VK_NULL_HANDLE, image_view, VK_IMAGE_LAYOUT_GENERAL};
+        VkDescriptorBufferInfo flag_desc{flag_buff.buff, 0, VK_WHOLE_SIZE};
+        VkWriteDescriptorSet writes[2]{};
+        for (uint32_t i = 0; i < 2; i++) {
+            writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[i].dstSet = desc_set;
+            writes[i].descriptorCount = 1;
+        }
+        writes[0].dstBinding = 0;
+        writes[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        writes[0].pImageInfo = &img_desc;
+        writes[1].dstBinding = 2;
+        writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[1].pBufferInfo = &flag_desc;
+        vkUpdateDescriptorSets(dev, 2, writes, 0, nullptr);
+    }
+
+    static VkBufferImageCopy image_region(uint32_t w, uint32_t h, uint32_t layers) {
+        VkBufferImageCopy region{};
+        region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, layers};
+        region.imageExtent = {w, h, 1};
+        return region;
+    }
+
+    void begin_cmds() {
+        check(vkResetCommandBuffer(cmd, 0), "vkResetCommandBuffer");
+        VkCommandBufferBeginInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        check(vkBeginCommandBuffer(cmd, &info), "vkBeginCommandBuffer");
+    }
+
+    void submit_cmds() {
+        check(vkEndCommandBuffer(cmd), "vkEndCommandBuffer");
+        VkSubmitInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        info.commandBufferCount = 1;
+        info.pCommandBuffers = &cmd;
+        check(vkQueueSubmit(queue, 1, &info, fence), "vkQueueSubmit");
+        check(vkWaitForFences(dev, 1, &fence, VK_TRUE, UINT64_MAX), "vkWaitForFences");
+        check(vkResetFences(dev, 1, &fence), "vkResetFences");
+    }
+
+    void memory_barrier(VkAccessFlags src, VkAccessFlags dst, VkPipelineStageFlags src_stage,
+            VkPipelineStageFlags dst_stage)
+    {
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = src;
+        barrier.dstAccessMask = dst;
+        vkCmdPipelineBarrier(cmd, src_stage, dst_stage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    void image_barrier(VkImage img, uint32_t layers, VkImageLayout from, VkImageLayout to,
+            VkAccessFlags src, VkAccessFlags dst, VkPipelineStageFlags src_stage,
+            VkPipelineStageFlags dst_stage)
+    {
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = from;
+        barrier.newLayout = to;
+        barrier.srcAccessMask = src;
+        barrier.dstAccessMask = dst;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = img;
+        barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, layers};
+        vkCmdPipelineBarrier(cmd, src_stage, dst_stage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+};
+
+#endif
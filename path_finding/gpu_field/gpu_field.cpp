@@ -0,0 +1,161 @@
+#define LOGGER_VERBOSE_LVL 0
+
+#include "debug.h"
+#include "misc_utils.h"
+#include "path_finding.h"
+#include "flow_field.h"
+#include "map_file.h"
+#include "gpu_field.h"
+#include "bench/scenario.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include <random>
+
+/* Computes the distance fields of many goals with the compute shader of gpu_field.h and checks
+them against the flow fields of the cpu, cell by cell, and the paths walked on them against their
+cost. It's the test of the gpu path, it exits with 1 if anything differs, so it can run on a
+machine without a gpu with mesa's lavapipe:
+    VK_ICD_FILENAMES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json ./gpu_field.out
+    usage: ./gpu_field.out [map.png | map.pfmap | size] [goal_cnt] [diag]
+The map is a random one of the given size (256 by default) if it's not a file. */
+
+using grid_t = terrain_grid_t<uint8_t>;
+
+static double get_time_s() {
+    using namespace std::chrono;
+    return duration_cast<duration<double>>(steady_clock::now().time_since_epoch()).count();
+}
+
+/* the pixels are kept for the terrain image of the gpu, as load_image of the viewer does */
+static grid_t load_png(const std::string& path, std::vector<uint32_t>& pixels) {
+    int w, h, chans;
+    stbi_uc* data = stbi_load(path.c_str(), &w, &h, &chans, STBI_rgb_alpha);
+    if (!data)
+        throw std::runtime_error("failed to load " + path);
+    pixels.assign((uint32_t *)data, (uint32_t *)data + w * h);
+    stbi_image_free(data);
+    grid_t terrain(w, h, 1, TERRAIN_WALL);
+    for (int i = 0; i < h; i++)
+        for (int j = 0; j < w; j++)
+            terrain[i][j] = (pixels[i * w + j] == 0xff000000 ? TERRAIN_WALL : 1);
+    terrain.build_obstacles(TERRAIN_WALL);
+    return terrain;
+}
+
+/* black walls on white, like load_map_file of the viewer */
+static std::vector<uint32_t> terrain_pixels(grid_t& terrain) {
+    std::vector<uint32_t> pixels(size_t(terrain.width) * terrain.height);
+    for (int i = 0; i < terrain.height; i++)
+        for (int j = 0; j < terrain.width; j++)
+            pixels[i * terrain.width + j] = terrain[i][j] >= TERRAIN_WALL ? 0xff000000 : 0xffffffff;
+    return pixels;
+}
+
+template <size_t graph_flags>
+static int run(grid_t& terrain, const std::vector<uint32_t>& pixels, int goal_cnt) {
+    using graph_t = matrix_graph_wraper_t<graph_flags | PATH_FINDING_FLAG_UNIFORM_COST, grid_t>;
+    using node_t = typename graph_t::node_t;
+    constexpr bool diag = graph_t::neigh_cnt == 8;
+    graph_t graph(terrain, terrain.height, terrain.width, TERRAIN_WALL);
+    passable_grid_t grid;
+    grid.build(graph);
+
+    std::mt19937 rng(2468);
+    auto rand_free = [&] {
+        while (true) {
+            node_t n{int32_t(rng() % grid.width), int32_t(rng() % grid.height)};
+            if (grid.is_free(n.x, n.y))
+                return n;
+        }
+    };
+    std::vector<node_t> goals;
+    for (int i = 0; i < goal_cnt; i++)
+        goals.push_back(rand_free());
+
+    double t0 = get_time_s();
+    gpu_field_solver_t solver(diag);
+    VkImage terrain_img = solver.upload_terrain(pixels.data(), grid.width, grid.height);
+    double t1 = get_time_s();
+    auto fields = solver.solve(terrain_img, grid, goals);
+    double t2 = get_time_s();
+
+    /* the same fields on the cpu, and the paths from random starts on both */
+    size_t cell_cnt = size_t(grid.width) * grid.height;
+    uint64_t mismatches = 0, paths = 0, bad_paths = 0;
+    double cpu_s = 0;
+    for (int i = 0; i < goal_cnt; i++) {
+        const float *field = fields.data() + i * cell_cnt;
+        double c0 = get_time_s();
+        flow_field_t<graph_t> flow;
+        flow.compute(grid, goals[i]);
+        cpu_s += get_time_s() - c0;
+
+        for (int32_t y = 0; y < grid.height; y++) {
+            for (int32_t x = 0; x < grid.width; x++) {
+                float cpu = flow.cost(node_t{x, y}), gpu = field[y * grid.width + x];
+                if (cpu == flow.inf ? gpu < gpu_field_inf :
+                        std::abs(cpu - gpu) > 1e-3 * std::max(1.f, cpu))
+                    mismatches++;
+            }
+        }
+
+        for (int j = 0; j < 16; j++) {
+            node_t start = rand_free();
+            auto path = field_path(field, grid, diag, start);
+            if (flow.cost(start) == flow.inf) {
+                bad_paths += !path.empty();
+                continue;
+            }
+            paths++;
+            double len = 0;
+            for (size_t k = 1; k < path.size(); k++) {
+                int32_t dx = std::abs(path[k].x - path[k - 1].x);
+                int32_t dy = std::abs(path[k].y - path[k - 1].y);
+                len += dx && dy ? sqrt(2) : 1;
+            }
+            bad_paths += path.empty() || !(path.front() == goals[i]) ||
+                    !(path.back() == start) || std::abs(len - flow.cost(start)) > 1e-3 * len;
+        }
+    }
+
+    std::string device = solver.device_name;
+    std::replace(device.begin(), device.end(), ' ', '_');
+    printf("bench=gpu_field device=%s width=%d height=%d neigh_cnt=%d goals=%d iterations=%ld "
+            "batches=%ld init_s=%.4f gpu_s=%.4f cpu_s=%.4f mismatches=%ld paths=%ld "
+            "bad_paths=%ld\n", device.c_str(), grid.width, grid.height, graph_t::neigh_cnt,
+            goal_cnt, solver.iterations, solver.batches, t1 - t0, t2 - t1, cpu_s, mismatches,
+            paths, bad_paths);
+    return mismatches || bad_paths;
+}
+
+int main(int argc, char const *argv[])
+{
+    std::string map = argc > 1 ? argv[1] : "256";
+    int goal_cnt = argc > 2 ? atoi(argv[2]) : 16;
+    bool diag = argc > 3 && std::string(argv[3]) == "diag";
+
+    try {
+        std::unique_ptr<map_file_t> map_file;
+        grid_t terrain;
+        std::vector<uint32_t> pixels;
+        if (map.ends_with(".pfmap")) {
+            map_file = std::make_unique<map_file_t>(map);
+            terrain = map_file->terrain();
+        }
+        else if (map.ends_with(".png"))
+            terrain = load_png(map, pixels);
+        else
+            terrain = gen_random_grid(atoi(map.c_str()), 0.2, 42);
+        if (pixels.empty())
+            pixels = terrain_pixels(terrain);
+
+        return diag ? run<PATH_FINDING_FLAG_DIAG_ENABLE>(terrain, pixels, goal_cnt) :
+                run<0>(terrain, pixels, goal_cnt);
+    }
+    catch (std::exception& e) {
+        printf("%s\n", e.what());
+        return 1;
+    }
+}
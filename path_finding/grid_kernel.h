@@ -0,0 +1,264 @@
+#ifndef GRID_KERNEL_H
+#define GRID_KERNEL_H
+
+#include "path_finding.h"
+
+#include <cmath>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+# include <immintrin.h>
+#endif
+
+/* The expansion of a node of the matrix graph in one go: the 3x3 block of cells around the node is
+loaded in one vector (8 lanes, one per neighbor), and the edge costs, the passability of the
+neighbors and their heuristics are computed for all the lanes at once, instead of the up to 8 loads
+and branches of for_each_neighbor and the 8 calls of the heuristic in double.
+
+    kernel_grid_t - the cells of the graph as floats, with a border of walls around them, so the
+            3x3 block of any cell can be loaded without checking the bounds. build(graph) makes
+            the copy, call it again after the map changes.
+    kernel_grid_t::expand(idx, goal_x, goal_y, g, out) - fills out with the mask of the neighbors
+            that can be entered and, for each lane, the score g + cost and the heuristic
+    kernel_graph_t - the kernel grid as a graph, grid_a_star_path calls expand() through it's
+            for_each_scored_neighbor(), the search and it's stats are the ones of grid_a_star_path
+    kernel_a_star_t - a kernel_graph_t with a context and an open set, same paths as the graph
+            it's built from
+
+The lanes are in the order of neigh_dirs of the 8 neighbor graph, the 4 neighbors are the odd lanes,
+in the same order as well. The kernel is picked at compile time: AVX2 if the compiler targets it
+(-mavx2, -march=native), SSE2 on any other x86-64 and plain loops elsewhere, the three give the same
+results. The costs and the heuristics are computed in float, so the graph must use float costs.
+*/
+
+struct kernel_neighbors_t {
+    alignas(32) float score[8];         /* g + the cost of the edge */
+    alignas(32) float h[8];
+    uint32_t mask;                      /* bit i is set if the neighbor of lane i can be entered */
+};
+
+template <size_t graph_flags>
+struct kernel_grid_t {
+    static constexpr bool uniform_cost = graph_flags & PATH_FINDING_FLAG_UNIFORM_COST;
+    static constexpr bool diag = graph_flags & PATH_FINDING_FLAG_DIAG_ENABLE;
+
+    /* lane i moves by {lane_dx[i], lane_dy[i]}, the same order as neigh_dirs */
+    static constexpr float lane_dx[8] = {-1, 0, 1, 1, 1, 0, -1, -1};
+    static constexpr float lane_dy[8] = {-1, -1, -1, 0, 1, 1, 1, 0};
+    static constexpr uint32_t orth_lanes = 0b1010'1010;
+    static constexpr uint32_t diag_lanes = 0b0101'0101;
+
+    int32_t width = 0;
+    int32_t height = 0;
+    int32_t stride = 0;
+    float wall = 0;                 /* a cell can be entered if it's value is below this */
+    std::vector<float> cells;
+    std::array<int32_t, 8> lane_offset;
+
+    /* In the uniform cost mode the border is a wall, otherwise every cell can be entered (like in
+    the graph) and only the border is not, it's infinite and wall is infinite as well. */
+    template <typename graph_t>
+    void build(const graph_t& graph) {
+        static_assert(std::is_same_v<typename graph_t::cost_t, float>, "the kernel works in float");
+        width = graph.max_cols;
+        height = graph.max_lines;
+        stride = width + 2;
+        wall = uniform_cost ? float(graph.wall_value) : INFINITY;
+
+        /* the vector loads read one cell past the right border, the padding at the end covers the
+        last row */
+        float border = uniform_cost ? wall : INFINITY;
+        cells.assign(size_t(stride) * (height + 2) + 4, border);
+        for (int32_t y = 0; y < height; y++)
+            for (int32_t x = 0; x < width; x++)
+                cells[index(x, y)] = float(graph.map_data[y][x]);
+
+        for (int i = 0; i < 8; i++)
+            lane_offset[i] = int32_t(lane_dx[i]) + int32_t(lane_dy[i]) * stride;
+    }
+
+    uint32_t index(int32_t x, int32_t y) const { return (y + 1) * stride + x + 1; }
+    int32_t x_of(uint32_t idx) const { return int32_t(idx % stride) - 1; }
+    int32_t y_of(uint32_t idx) const { return int32_t(idx / stride) - 1; }
+    uint32_t cell_count() const { return cells.size(); }
+    bool is_free(uint32_t idx) const { return cells[idx] < wall; }
+
+    /* A free diagonal also needs both cells beside it to be free, those are the lanes before and
+    after it (the lanes go around the node), so it's two rotations of the mask. */
+    static uint32_t fix_mask(uint32_t free) {
+        if constexpr (!diag)
+            return free & orth_lanes;
+        else if constexpr (uniform_cost) {
+            uint32_t sides = ((free << 1) | (free >> 7)) & ((free >> 1) | (free << 7));
+            return free & (orth_lanes | (sides & diag_lanes)) & 0xff;
+        }
+        else
+            return free;
+    }
+
+    /* the heuristic of the lanes, for a single node */
+    static float heuristic(float dx, float dy) {
+        dx = std::abs(dx);
+        dy = std::abs(dy);
+        if constexpr (diag)
+            return std::max(dx, dy) + octile_b * std::min(dx, dy);
+        else if constexpr (uniform_cost)
+            return dx + dy;
+        else
+            return std::abs(dx - dy);
+    }
+
+    void expand(uint32_t idx, int32_t goal_x, int32_t goal_y, float g,
+            kernel_neighbors_t& out) const
+    {
+        const float *c = cells.data() + idx;
+        float dx0 = float(x_of(idx) - goal_x);
+        float dy0 = float(y_of(idx) - goal_y);
+
+#if defined(__SSE2__)
+        /* lanes 0-2 are the row above, from the left, lane 3 the cell on the right, lanes 4-6 the
+        row below, from the right, lane 7 the cell on the left */
+        __m128 above = _mm_loadu_ps(c - stride - 1);
+        __m128 mid = _mm_loadu_ps(c - 1);
+        __m128 below = _mm_loadu_ps(c + stride - 1);
+        __m128 t_lo = _mm_shuffle_ps(above, mid, _MM_SHUFFLE(2, 2, 2, 2));
+        __m128 lo = _mm_shuffle_ps(above, t_lo, _MM_SHUFFLE(2, 0, 1, 0));
+        __m128 t_hi = _mm_shuffle_ps(below, mid, _MM_SHUFFLE(0, 0, 0, 0));
+        __m128 hi = _mm_shuffle_ps(below, t_hi, _MM_SHUFFLE(2, 0, 1, 2));
+#endif
+
+#if defined(__AVX2__)
+        __m256 v = _mm256_set_m128(hi, lo);
+        __m256 ldx = _mm256_load_ps(lane_dx_vec);
+        __m256 ldy = _mm256_load_ps(lane_dy_vec);
+        __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fff'ffff));
+
+        uint32_t free = _mm256_movemask_ps(_mm256_cmp_ps(v, _mm256_set1_ps(wall), _CMP_LT_OQ));
+        __m256 cost;
+        if constexpr (uniform_cost)
+            cost = _mm256_load_ps(uniform_cost_vec);
+        else
+            cost = _mm256_and_ps(_mm256_sub_ps(v, _mm256_set1_ps(c[0])), abs_mask);
+        _mm256_store_ps(out.score, _mm256_add_ps(_mm256_set1_ps(g), cost));
+
+        __m256 dx = _mm256_and_ps(_mm256_add_ps(_mm256_set1_ps(dx0), ldx), abs_mask);
+        __m256 dy = _mm256_and_ps(_mm256_add_ps(_mm256_set1_ps(dy0), ldy), abs_mask);
+        __m256 h;
+        if constexpr (diag)
+            h = _mm256_add_ps(_mm256_max_ps(dx, dy),
+                    _mm256_mul_ps(_mm256_set1_ps(octile_b), _mm256_min_ps(dx, dy)));
+        else if constexpr (uniform_cost)
+            h = _mm256_add_ps(dx, dy);
+        else
+            h = _mm256_and_ps(_mm256_sub_ps(dx, dy), abs_mask);
+        _mm256_store_ps(out.h, h);
+        out.mask = fix_mask(free);
+
+#elif defined(__SSE2__)
+        __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fff'ffff));
+        __m128 wall4 = _mm_set1_ps(wall);
+        uint32_t free = _mm_movemask_ps(_mm_cmplt_ps(lo, wall4)) |
+                (_mm_movemask_ps(_mm_cmplt_ps(hi, wall4)) << 4);
+        out.mask = fix_mask(free);
+
+        __m128 g4 = _mm_set1_ps(g), c4 = _mm_set1_ps(c[0]);
+        __m128 dx0_4 = _mm_set1_ps(dx0), dy0_4 = _mm_set1_ps(dy0);
+        __m128 b4 = _mm_set1_ps(octile_b);
+        auto half = [&](__m128 v, int first) {
+            __m128 cost = uniform_cost ? _mm_load_ps(uniform_cost_vec + first) :
+                    _mm_and_ps(_mm_sub_ps(v, c4), abs_mask);
+            _mm_store_ps(out.score + first, _mm_add_ps(g4, cost));
+
+            __m128 dx = _mm_and_ps(_mm_add_ps(dx0_4, _mm_load_ps(lane_dx_vec + first)), abs_mask);
+            __m128 dy = _mm_and_ps(_mm_add_ps(dy0_4, _mm_load_ps(lane_dy_vec + first)), abs_mask);
+            __m128 h;
+            if constexpr (diag)
+                h = _mm_add_ps(_mm_max_ps(dx, dy), _mm_mul_ps(b4, _mm_min_ps(dx, dy)));
+            else if constexpr (uniform_cost)
+                h = _mm_add_ps(dx, dy);
+            else
+                h = _mm_and_ps(_mm_sub_ps(dx, dy), abs_mask);
+            _mm_store_ps(out.h + first, h);
+        };
+        half(lo, 0);
+        half(hi, 4);
+
+#else
+        uint32_t free = 0;
+        for (int i = 0; i < 8; i++) {
+            float v = c[lane_offset[i]];
+            free |= uint32_t(v < wall) << i;
+            out.score[i] = g + (uniform_cost ? uniform_cost_vec[i] : std::abs(v - c[0]));
+            out.h[i] = heuristic(dx0 + lane_dx[i], dy0 + lane_dy[i]);
+        }
+        out.mask = fix_mask(free);
+#endif
+    }
+
+private:
+    /* the same constants as the heuristics of matrix_graph_wraper_t, rounded to float */
+    static constexpr float octile_b = float(1.4142135623730951 - 1);
+    static constexpr float diag_cost = float(1.4142135623730951);
+    alignas(32) static constexpr float lane_dx_vec[8] = {-1, 0, 1, 1, 1, 0, -1, -1};
+    alignas(32) static constexpr float lane_dy_vec[8] = {-1, -1, -1, 0, 1, 1, 1, 0};
+    alignas(32) static constexpr float uniform_cost_vec[8] = {
+        diag_cost, 1, diag_cost, 1, diag_cost, 1, diag_cost, 1
+    };
+};
+
+/* The kernel grid as a graph for grid_a_star_path: the indices are the ones of the kernel grid
+(with the border), the nodes are the ones of the graph it's built from, and each expansion is one
+call of expand() through for_each_scored_neighbor(). */
+template <typename graph_t>
+struct kernel_graph_t {
+    using node_t = typename graph_t::node_t;
+    using cost_t = float;
+    using grid_t = kernel_grid_t<(graph_t::neigh_cnt == 8 ? PATH_FINDING_FLAG_DIAG_ENABLE : 0) |
+            (graph_t::uniform_cost ? PATH_FINDING_FLAG_UNIFORM_COST : 0)>;
+
+    static constexpr int neigh_cnt = graph_t::neigh_cnt;
+
+    grid_t grid;
+
+    void build(const graph_t& graph) { grid.build(graph); }
+
+    uint32_t node_count() const { return grid.cell_count(); }
+    uint32_t node_index(const node_t& node) const { return grid.index(node.x, node.y); }
+    node_t index_node(uint32_t idx) const { return node_t{grid.x_of(idx), grid.y_of(idx)}; }
+
+    auto get_heuristic(const node_t& goal) const {
+        return [goal](const node_t& node) {
+            return grid_t::heuristic(float(node.x - goal.x), float(node.y - goal.y));
+        };
+    }
+    using heuristic_t = decltype(std::declval<kernel_graph_t>().get_heuristic(node_t{}));
+
+    template <typename fn_t>
+    void for_each_scored_neighbor(uint32_t idx, float g, const node_t& goal, fn_t&& fn) const {
+        kernel_neighbors_t neigh;
+        grid.expand(idx, goal.x, goal.y, g, neigh);
+        for (uint32_t mask = neigh.mask; mask; mask &= mask - 1) {
+            int lane = __builtin_ctz(mask);
+            fn(idx + grid.lane_offset[lane], neigh.score[lane], neigh.h[lane]);
+        }
+    }
+};
+
+/* grid_a_star_path on a kernel_graph_t, with it's own context and open set */
+template <typename graph_t, typename open_set_t = heap_open_set_t<float>>
+struct kernel_a_star_t {
+    using node_t = typename graph_t::node_t;
+
+    kernel_graph_t<graph_t> graph;
+    grid_search_ctx_t<float> ctx;
+    open_set_t open_set;
+
+    void build(const graph_t& graph) { this->graph.build(graph); }
+
+    std::vector<node_t> path(const node_t& start, const node_t& goal) {
+        using heuristic_t = typename kernel_graph_t<graph_t>::heuristic_t;
+        return grid_a_star_path<heuristic_t, float>(ctx, open_set, graph, start, goal,
+                graph.get_heuristic(goal));
+    }
+};
+
+#endif
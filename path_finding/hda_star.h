@@ -0,0 +1,276 @@
+#ifndef HDA_STAR_H
+#define HDA_STAR_H
+
+#include "path_finding.h"
+#include "mpmc_ring.h"
+
+#include <array>
+#include <atomic>
+#include <optional>
+#include <thread>
+
+/* Hash distributed A* (Kishimoto, Fukunaga and Botea): one query searched by many threads. Every
+node has an owner thread, picked by a hash of the node, and only the owner keeps the score of the
+node and expands it, each thread with it's own open set. A thread that generates a node it doesn't
+own sends it (node, score, parent) to the owner through a lock-free queue. There are no locks, the
+threads only share the queues, the bound and the termination counter.
+
+    hda_star_t(graph, thread_cnt) - thread_cnt - 1 threads are started and wait for queries, the
+            thread that calls path() is the last worker
+    hda_star_t::path(start, goal) - same result as grid_a_star_path (a shortest path, ties may be
+            broken differently), in the format of a_star_path
+    expanded, messages - the nodes expanded by all the threads and the nodes that were sent to
+            another thread, by the last query
+
+The owners are picked by blocks of block_size x block_size cells (like AZHDA*): a search mostly
+generates the neighbors of the nodes it expands, with one owner per cell almost every generated
+node would be a message, with blocks only the ones on the borders of the blocks are.
+
+The first path found is not necessarily the shortest, it's cost becomes the bound, the threads drop
+every node with f >= bound and go on until there is no node left under it. The end is detected with
+one counter: every message in flight and every thread that has nodes to expand holds one unit of
+it, a thread takes it's unit before it gives back the one of the message that woke it, so the
+counter only reaches 0 when there is nothing left to do anywhere.
+
+The heuristic must be consistent (the ones of matrix_graph_wraper_t are), the state of the nodes
+is in one grid_search_ctx_t shared by the threads, each node is only touched by it's owner.
+*/
+
+template <typename graph_t>
+struct hda_star_t {
+    using node_t = typename graph_t::node_t;
+    using cost_t = typename graph_t::cost_t;
+    using heuristic_t = typename graph_t::heuristic_t;
+
+    static constexpr int32_t block_size = 16;
+    static constexpr uint32_t queue_size = 4096;
+    static constexpr uint32_t expand_batch = 64;   /* expansions between two reads of the inbox */
+
+    struct msg_t {
+        uint32_t idx;
+        uint32_t prev;
+        cost_t g;
+    };
+
+    struct alignas(64) worker_t {
+        mpmc_ring_t<msg_t> inbox{queue_size};
+        heap_open_set_t<cost_t> open_set;
+        std::vector<std::vector<msg_t>> outbox;     /* by destination, the sends that didn't fit */
+        bool active = false;                        /* holds a unit of pending */
+        uint64_t expanded = 0;
+        uint64_t messages = 0;
+        std::thread thread;
+    };
+
+    const graph_t &graph;
+    uint64_t expanded = 0;
+    uint64_t messages = 0;
+
+    hda_star_t(const graph_t &graph, uint32_t thread_cnt = 0) : graph(graph) {
+        if (!thread_cnt)
+            thread_cnt = std::max(1u, std::thread::hardware_concurrency());
+        workers.reserve(thread_cnt);
+        for (uint32_t i = 0; i < thread_cnt; i++) {
+            workers.push_back(std::make_unique<worker_t>());
+            workers[i]->outbox.resize(thread_cnt);
+        }
+        for (uint32_t i = 1; i < thread_cnt; i++)
+            workers[i]->thread = std::thread([this, i]{ helper_loop(i); });
+    }
+
+    ~hda_star_t() {
+        stop.store(true);
+        query_seq.fetch_add(1);
+        query_seq.notify_all();
+        for (auto &w : workers)
+            if (w->thread.joinable())
+                w->thread.join();
+    }
+
+    std::vector<node_t> path(const node_t& start, const node_t& goal) {
+        expanded = 0;
+        messages = 0;
+        if (!graph.passable(start.x, start.y) || !graph.passable(goal.x, goal.y))
+            return {};
+
+        ctx.begin(graph.node_count());
+        heuristic.emplace(graph.get_heuristic(goal));
+        goal_idx = graph.node_index(goal);
+        bound.store(std::numeric_limits<cost_t>::max());
+        for (auto &w : workers) {
+            w->open_set.clear();
+            w->active = false;
+            w->expanded = 0;
+            w->messages = 0;
+        }
+
+        /* the start is the first message, it holds the first unit */
+        uint32_t start_idx = graph.node_index(start);
+        pending.store(1);
+        workers[owner(start_idx)]->inbox.push(msg_t{start_idx, ctx.invalid_idx, cost_t{0}});
+
+        done_cnt.store(0);
+        query_seq.fetch_add(1);
+        query_seq.notify_all();
+        run_worker(0);
+        while (done_cnt.load() != workers.size() - 1)
+            std::this_thread::yield();
+
+        for (auto &w : workers) {
+            expanded += w->expanded;
+            messages += w->messages;
+        }
+        if (!ctx.has_score(goal_idx))
+            return {};
+        /* the parents were set by different threads, the walk is bounded in case they loop */
+        std::vector<node_t> ret;
+        for (uint32_t idx = goal_idx; idx != ctx.invalid_idx; idx = ctx.node_prev[idx]) {
+            if (ret.size() == graph.node_count())
+                return {};
+            ret.push_back(graph.index_node(idx));
+        }
+        return ret;
+    }
+
+private:
+    std::vector<std::unique_ptr<worker_t>> workers;
+    grid_search_ctx_t<cost_t> ctx;
+    std::optional<heuristic_t> heuristic;
+    uint32_t goal_idx = 0;
+
+    alignas(64) std::atomic<cost_t> bound;
+    alignas(64) std::atomic<int64_t> pending = 0;
+    alignas(64) std::atomic<uint32_t> query_seq = 0;
+    std::atomic<uint32_t> done_cnt = 0;
+    std::atomic<bool> stop = false;
+
+    uint32_t owner(uint32_t idx) const {
+        node_t n = graph.index_node(idx);
+        uint32_t block = uint32_t(n.y / block_size) * 0x9e37'79b1u ^
+                uint32_t(n.x / block_size) * 0x85eb'ca77u;
+        return ((block ^ (block >> 15)) * 0x2c1b'3c6du >> 8) % workers.size();
+    }
+
+    void helper_loop(uint32_t id) {
+        uint32_t seen = 0;
+        while (true) {
+            query_seq.wait(seen);
+            seen = query_seq.load();
+            if (stop.load())
+                return;
+            run_worker(id);
+            done_cnt.fetch_add(1);
+        }
+    }
+
+    void lower_bound_to(cost_t g) {
+        cost_t curr = bound.load();
+        while (g < curr && !bound.compare_exchange_weak(curr, g)) {}
+    }
+
+    /* the owner takes the node if the score is better than the one it has */
+    void relax(worker_t& w, uint32_t idx, cost_t g, uint32_t prev) {
+        if (ctx.has_score(idx) && !(g < ctx.g_score[idx]))
+            return;
+        cost_t f = g + (*heuristic)(graph.index_node(idx));
+        if (!(f < bound.load(std::memory_order_relaxed)))
+            return;
+        ctx.set_score(idx, g, prev);
+        ctx.closed[idx] = 0;
+        w.open_set.push(idx, f);
+    }
+
+    void send(uint32_t from, uint32_t to, const msg_t& msg) {
+        auto &w = *workers[from];
+        w.messages++;
+        if (w.outbox[to].size() || !workers[to]->inbox.push(msg_t(msg)))
+            w.outbox[to].push_back(msg);
+    }
+
+    void flush_outbox(uint32_t id) {
+        auto &w = *workers[id];
+        for (uint32_t to = 0; to < workers.size(); to++) {
+            auto &out = w.outbox[to];
+            size_t sent = 0;
+            while (sent < out.size() && workers[to]->inbox.push(msg_t(out[sent])))
+                sent++;
+            out.erase(out.begin(), out.begin() + sent);
+        }
+    }
+
+    void expand(uint32_t id, uint32_t curr_idx) {
+        auto &w = *workers[id];
+        cost_t curr_score = ctx.g_score[curr_idx];
+        if (curr_idx == goal_idx) {
+            lower_bound_to(curr_score);
+            return;
+        }
+
+        /* the messages are counted before they can be received */
+        std::array<msg_t, graph_t::neigh_cnt> remote;
+        std::array<uint32_t, graph_t::neigh_cnt> remote_to;
+        uint32_t remote_cnt = 0;
+        graph.for_each_neighbor(graph.index_node(curr_idx),
+                [&](const node_t& neigh, cost_t distance) {
+            uint32_t neigh_idx = graph.node_index(neigh);
+            uint32_t to = owner(neigh_idx);
+            if (to == id)
+                relax(w, neigh_idx, curr_score + distance, curr_idx);
+            else {
+                remote[remote_cnt] = msg_t{neigh_idx, curr_idx, curr_score + distance};
+                remote_to[remote_cnt++] = to;
+            }
+        });
+        if (remote_cnt)
+            pending.fetch_add(remote_cnt);
+        for (uint32_t i = 0; i < remote_cnt; i++)
+            send(id, remote_to[i], remote[i]);
+    }
+
+    void run_worker(uint32_t id) {
+        auto &w = *workers[id];
+        while (true) {
+            uint32_t received = 0;
+            msg_t msg;
+            while (w.inbox.pop(msg)) {
+                relax(w, msg.idx, msg.g, msg.prev);
+                received++;
+            }
+            flush_outbox(id);
+
+            for (uint32_t i = 0; i < expand_batch && !w.open_set.empty(); i++) {
+                uint32_t curr_idx = w.open_set.pop();
+                if (ctx.is_closed(curr_idx))
+                    continue;
+                cost_t f = ctx.g_score[curr_idx] + (*heuristic)(graph.index_node(curr_idx));
+                if (!(f < bound.load(std::memory_order_relaxed))) {
+                    /* the bound only goes down, nothing left in the set can be under it */
+                    w.open_set.clear();
+                    break;
+                }
+                ctx.closed[curr_idx] = ctx.generation;
+                w.expanded++;
+                expand(id, curr_idx);
+            }
+
+            /* the unit of the thread is taken before the ones of the messages are given back */
+            bool has_work = !w.open_set.empty();
+            if (has_work && !w.active) {
+                pending.fetch_add(1);
+                w.active = true;
+            }
+            if (received)
+                pending.fetch_sub(received);
+            if (!has_work && w.active) {
+                pending.fetch_sub(1);
+                w.active = false;
+            }
+            if (pending.load() == 0)
+                return;
+            if (!has_work && !received)
+                std::this_thread::yield();
+        }
+    }
+};
+
+#endif
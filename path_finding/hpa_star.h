@@ -0,0 +1,453 @@
+#ifndef HPA_STAR_H
+#define HPA_STAR_H
+
+#include "path_finding.h"
+
+#include <set>
+#include <unordered_map>
+
+/* Hierarchical path finding (HPA*, Botea, Muller and Schaeffer) over a matrix_graph_wraper_t.
+
+The map is split in square clusters of cluster_size cells. On each border between two clusters
+the runs of cells that can be crossed become entrances: one transition in the middle of the run,
+or one at each end if the run is at least max_entrance_width long. The two cells of a transition
+are the nodes of the abstract graph, joined by an inter edge. Inside a cluster every pair of nodes
+is joined by an intra edge that has the cost of the shortest path between them that stays inside
+the cluster. All of this is computed once by build().
+
+A query links the start and the goal to the nodes of their clusters, searches the abstract graph
+and then refines the abstract path back to cells, one cluster at a time. The paths are close to
+optimal, not optimal.
+
+When cells of the map change, update_cells() rebuilds only the borders that hold those cells and
+the intra edges of the clusters that have changed cells or touch a rebuilt border.
+
+    build() - builds the whole abstraction, call it once before the queries (or load it from a
+              map file, see map_file.h)
+    update_cells(cells) - the given cells were changed in the map, repair the abstraction
+    abstract_path(start, goal) - the abstract nodes from start to goal (start and goal included)
+    refine_segment(a, b) - cells of the path between two consecutive abstract nodes
+    path(start, goal) - the full cell path, goal to start, in the format of a_star_path
+*/
+
+template <typename graph_t>
+struct hpa_graph_t {
+    using node_t = typename graph_t::node_t;
+    using cost_t = typename graph_t::cost_t;
+
+    static constexpr uint32_t invalid_idx = grid_search_ctx_t<cost_t>::invalid_idx;
+    static constexpr int32_t max_entrance_width = 6;
+
+    struct edge_t {
+        uint32_t to;
+        cost_t cost;
+        bool intra;
+    };
+
+    struct abs_node_t {
+        node_t node;
+        uint32_t cluster;
+        uint32_t refs;                  /* the number of transitions that use this node */
+        std::vector<edge_t> edges;
+    };
+
+    struct cluster_t {
+        int32_t x0, y0, x1, y1;         /* the cells [x0, x1) x [y0, y1) */
+        std::vector<uint32_t> nodes;
+    };
+
+    /* the east border of cluster c is borders[c * 2], the south border is borders[c * 2 + 1] */
+    struct border_t {
+        std::vector<std::pair<uint32_t, uint32_t>> transitions;
+    };
+
+    const graph_t &graph;
+    int32_t cluster_size;
+    int32_t clusters_x;
+    int32_t clusters_y;
+
+    std::vector<cluster_t> clusters;
+    std::vector<border_t> borders;
+    std::vector<abs_node_t> nodes;
+    std::vector<uint32_t> free_nodes;
+    std::unordered_map<uint32_t, uint32_t> cell_node;   /* graph.node_index() -> abstract node */
+
+    uint64_t expanded = 0;              /* abstract nodes expanded by the last query */
+
+    hpa_graph_t(const graph_t &graph, int32_t cluster_size = 16)
+    : graph(graph), cluster_size(cluster_size)
+    {
+        clusters_x = (graph.max_cols + cluster_size - 1) / cluster_size;
+        clusters_y = (graph.max_lines + cluster_size - 1) / cluster_size;
+    }
+
+    void build() {
+        init_clusters();
+        for (uint32_t b = 0; b < borders.size(); b++)
+            build_border(b);
+        for (uint32_t c = 0; c < clusters.size(); c++)
+            build_intra(c);
+    }
+
+    /* empty clusters and borders, without any abstract node */
+    void init_clusters() {
+        clusters.clear();
+        borders.assign(clusters_x * clusters_y * 2, {});
+        nodes.clear();
+        free_nodes.clear();
+        cell_node.clear();
+        for (int32_t cy = 0; cy < clusters_y; cy++)
+            for (int32_t cx = 0; cx < clusters_x; cx++)
+                clusters.push_back(cluster_t{
+                    .x0 = cx * cluster_size,
+                    .y0 = cy * cluster_size,
+                    .x1 = std::min((cx + 1) * cluster_size, graph.max_cols),
+                    .y1 = std::min((cy + 1) * cluster_size, graph.max_lines),
+                    .nodes = {},
+                });
+    }
+
+    void update_cells(const std::vector<node_t>& cells) {
+        std::set<uint32_t> dirty_clusters;
+        std::set<uint32_t> dirty_borders;
+        for (auto &cell : cells) {
+            uint32_t c = cluster_of(cell);
+            auto &cl = clusters[c];
+            dirty_clusters.insert(c);
+            if (cell.x == cl.x1 - 1)
+                dirty_borders.insert(c * 2);
+            if (cell.x == cl.x0 && cl.x0 > 0)
+                dirty_borders.insert((c - 1) * 2);
+            if (cell.y == cl.y1 - 1)
+                dirty_borders.insert(c * 2 + 1);
+            if (cell.y == cl.y0 && cl.y0 > 0)
+                dirty_borders.insert((c - clusters_x) * 2 + 1);
+        }
+        for (auto b : dirty_borders)
+            clear_border(b);
+        for (auto b : dirty_borders) {
+            build_border(b);
+            uint32_t c = b / 2;
+            dirty_clusters.insert(c);
+            dirty_clusters.insert(b % 2 == 0 ? c + 1 : c + clusters_x);
+        }
+        for (auto c : dirty_clusters)
+            if (c < clusters.size())
+                build_intra(c);
+    }
+
+    std::vector<node_t> abstract_path(const node_t& start, const node_t& goal) {
+        using open_entry_t = typename grid_search_ctx_t<cost_t>::open_entry_t;
+        auto compare_fn = [](const open_entry_t& a, const open_entry_t& b) {
+            return a.cost > b.cost;
+        };
+
+        expanded = 0;
+        if (!graph.passable(start.x, start.y) || !graph.passable(goal.x, goal.y))
+            return {};
+
+        /* the start and the goal get the two ids after the last abstract node */
+        uint32_t start_id = nodes.size();
+        uint32_t goal_id = nodes.size() + 1;
+        auto node_of = [&](uint32_t id) {
+            return id == start_id ? start : id == goal_id ? goal : nodes[id].node;
+        };
+
+        uint32_t start_cluster = cluster_of(start);
+        uint32_t goal_cluster = cluster_of(goal);
+
+        std::vector<edge_t> start_edges;
+        local_search(start_cluster, start, nullptr);
+        for (auto id : clusters[start_cluster].nodes)
+            if (loc_has_score(nodes[id].node))
+                start_edges.push_back({id, loc_score(nodes[id].node), true});
+
+        /* the map is not directed, the distance from the goal is the distance to the goal */
+        goal_edges.clear();
+        local_search(goal_cluster, goal, nullptr);
+        for (auto id : clusters[goal_cluster].nodes)
+            if (loc_has_score(nodes[id].node))
+                goal_edges.push_back({id, loc_score(nodes[id].node), true});
+        if (start_cluster == goal_cluster && loc_has_score(start))
+            start_edges.push_back({goal_id, loc_score(start), true});
+
+        auto heuristic = graph.get_heuristic(goal);
+        abs_ctx.begin(nodes.size() + 2);
+        auto &open_set = abs_ctx.open_set;
+        abs_ctx.set_score(start_id, cost_t{0}, invalid_idx);
+        open_set.push_back({start_id, heuristic(start)});
+
+        while (open_set.size()) {
+            std::pop_heap(open_set.begin(), open_set.end(), compare_fn);
+            uint32_t curr = open_set.back().idx;
+            open_set.pop_back();
+
+            if (abs_ctx.is_closed(curr))
+                continue;
+            abs_ctx.closed[curr] = abs_ctx.generation;
+            expanded++;
+
+            if (curr == goal_id) {
+                std::vector<node_t> ret;
+                for (uint32_t id = curr; id != invalid_idx; id = abs_ctx.node_prev[id])
+                    ret.push_back(node_of(id));
+                std::reverse(ret.begin(), ret.end());
+                return ret;
+            }
+
+            cost_t curr_score = abs_ctx.g_score[curr];
+            auto relax = [&](uint32_t to, cost_t cost) {
+                cost_t new_score = curr_score + cost;
+                if (!abs_ctx.has_score(to) || new_score < abs_ctx.g_score[to]) {
+                    abs_ctx.set_score(to, new_score, curr);
+                    abs_ctx.closed[to] = 0;
+                    open_set.push_back({to, new_score + heuristic(node_of(to))});
+                    std::push_heap(open_set.begin(), open_set.end(), compare_fn);
+                }
+            };
+
+            if (curr == start_id) {
+                for (auto &e : start_edges)
+                    relax(e.to, e.cost);
+                continue;
+            }
+            for (auto &e : nodes[curr].edges)
+                relax(e.to, e.cost);
+            if (nodes[curr].cluster == goal_cluster)
+                for (auto &e : goal_edges)
+                    if (e.to == curr)
+                        relax(goal_id, e.cost);
+        }
+        return {};
+    }
+
+    /* the cells from b to a, a excluded, so the segments can be chained */
+    std::vector<node_t> refine_segment(const node_t& a, const node_t& b) {
+        uint32_t c = cluster_of(a);
+        if (c != cluster_of(b))
+            return {b};     /* an inter edge, the two cells are neighbors */
+        local_search(c, a, &b);
+        std::vector<node_t> ret;
+        for (uint32_t idx = loc_index(b); idx != invalid_idx && idx != loc_index(a);
+                idx = loc_ctx.node_prev[idx])
+            ret.push_back(loc_node(c, idx));
+        return ret;
+    }
+
+    std::vector<node_t> path(const node_t& start, const node_t& goal) {
+        auto abs_path = abstract_path(start, goal);
+        if (abs_path.empty())
+            return {};
+        std::vector<node_t> ret;
+        for (size_t i = abs_path.size() - 1; i > 0; i--) {
+            auto segment = refine_segment(abs_path[i - 1], abs_path[i]);
+            ret.insert(ret.end(), segment.begin(), segment.end());
+        }
+        ret.push_back(start);
+        return ret;
+    }
+
+    uint32_t cluster_of(const node_t& node) const {
+        return (node.y / cluster_size) * clusters_x + node.x / cluster_size;
+    }
+
+    /* cost of the edge from a to it's neighbor b, as reported by the graph */
+    cost_t edge_cost(const node_t& a, const node_t& b) const {
+        cost_t ret = cost_t{0};
+        graph.for_each_neighbor(a, [&](const node_t& neigh, cost_t cost) {
+            if (neigh == b)
+                ret = cost;
+        });
+        return ret;
+    }
+
+    bool has_edge(const node_t& a, const node_t& b) const {
+        if (!graph.passable(a.x, a.y))
+            return false;
+        bool ret = false;
+        graph.for_each_neighbor(a, [&](const node_t& neigh, cost_t) { ret |= neigh == b; });
+        return ret;
+    }
+
+    uint32_t acquire_node(const node_t& node) {
+        uint32_t cell = graph.node_index(node);
+        if (HAS(cell_node, cell)) {
+            nodes[cell_node[cell]].refs++;
+            return cell_node[cell];
+        }
+        uint32_t id;
+        if (free_nodes.size()) {
+            id = free_nodes.back();
+            free_nodes.pop_back();
+        }
+        else {
+            id = nodes.size();
+            nodes.push_back({});
+        }
+        nodes[id] = abs_node_t{ .node = node, .cluster = cluster_of(node), .refs = 1, .edges = {} };
+        clusters[nodes[id].cluster].nodes.push_back(id);
+        cell_node[cell] = id;
+        return id;
+    }
+
+    void release_node(uint32_t id) {
+        auto &n = nodes[id];
+        if (--n.refs)
+            return;
+        for (auto &e : n.edges)
+            remove_edge(e.to, id);
+        n.edges.clear();
+        auto &cl_nodes = clusters[n.cluster].nodes;
+        cl_nodes.erase(std::find(cl_nodes.begin(), cl_nodes.end(), id));
+        cell_node.erase(graph.node_index(n.node));
+        n.cluster = invalid_idx;
+        free_nodes.push_back(id);
+    }
+
+    void remove_edge(uint32_t from, uint32_t to) {
+        auto &edges = nodes[from].edges;
+        edges.erase(std::remove_if(edges.begin(), edges.end(),
+                [to](const edge_t& e) { return e.to == to; }), edges.end());
+    }
+
+    void clear_border(uint32_t b) {
+        for (auto [a, c] : borders[b].transitions) {
+            remove_edge(a, c);
+            remove_edge(c, a);
+            release_node(a);
+            release_node(c);
+        }
+        borders[b].transitions.clear();
+    }
+
+    void build_border(uint32_t b) {
+        uint32_t c = b / 2;
+        bool east = b % 2 == 0;
+        int32_t cx = c % clusters_x;
+        int32_t cy = c / clusters_x;
+        if ((east && cx + 1 >= clusters_x) || (!east && cy + 1 >= clusters_y))
+            return;
+
+        auto &cl = clusters[c];
+        int32_t len = east ? cl.y1 - cl.y0 : cl.x1 - cl.x0;
+
+        /* the i'th pair of cells that face each other over the border */
+        auto pair_at = [&](int32_t i) {
+            if (east)
+                return std::pair{node_t{cl.x1 - 1, cl.y0 + i}, node_t{cl.x1, cl.y0 + i}};
+            return std::pair{node_t{cl.x0 + i, cl.y1 - 1}, node_t{cl.x0 + i, cl.y1}};
+        };
+        auto is_open = [&](int32_t i) {
+            auto [a, o] = pair_at(i);
+            return has_edge(a, o);
+        };
+        auto add_transition = [&](int32_t i) {
+            auto [a, o] = pair_at(i);
+            uint32_t ida = acquire_node(a);
+            uint32_t ido = acquire_node(o);
+            nodes[ida].edges.push_back({ido, edge_cost(a, o), false});
+            nodes[ido].edges.push_back({ida, edge_cost(o, a), false});
+            borders[b].transitions.push_back({ida, ido});
+        };
+
+        int32_t i = 0;
+        while (i < len) {
+            if (!is_open(i)) {
+                i++;
+                continue;
+            }
+            int32_t run_start = i;
+            while (i < len && is_open(i))
+                i++;
+            int32_t run_len = i - run_start;
+            if (run_len < max_entrance_width)
+                add_transition(run_start + run_len / 2);
+            else {
+                add_transition(run_start);
+                add_transition(i - 1);
+            }
+        }
+    }
+
+    void build_intra(uint32_t c) {
+        auto &cl = clusters[c];
+        for (auto id : cl.nodes) {
+            auto &edges = nodes[id].edges;
+            edges.erase(std::remove_if(edges.begin(), edges.end(),
+                    [](const edge_t& e) { return e.intra; }), edges.end());
+        }
+        for (auto id : cl.nodes) {
+            local_search(c, nodes[id].node, nullptr);
+            for (auto oth : cl.nodes)
+                if (oth != id && loc_has_score(nodes[oth].node))
+                    nodes[id].edges.push_back({oth, loc_score(nodes[oth].node), true});
+        }
+    }
+
+    /* Search limited to the cells of one cluster: Dijkstra from src to all the cells if target is
+    null, A* to target otherwise. The state uses local indexes, (y - y0) * cluster_size + x - x0,
+    and generation stamps, like grid_search_ctx_t. */
+    void local_search(uint32_t c, const node_t& src, const node_t *target) {
+        using open_entry_t = typename grid_search_ctx_t<cost_t>::open_entry_t;
+        auto compare_fn = [](const open_entry_t& a, const open_entry_t& b) {
+            return a.cost > b.cost;
+        };
+
+        loc_cluster = c;
+        loc_ctx.begin(cluster_size * cluster_size);
+        auto &cl = clusters[c];
+        auto &open_set = loc_ctx.open_set;
+        auto heuristic = graph.get_heuristic(target ? *target : src);
+        auto h = [&](const node_t& node) { return target ? heuristic(node) : cost_t{0}; };
+
+        loc_ctx.set_score(loc_index(src), cost_t{0}, invalid_idx);
+        open_set.push_back({loc_index(src), h(src)});
+        while (open_set.size()) {
+            std::pop_heap(open_set.begin(), open_set.end(), compare_fn);
+            uint32_t curr = open_set.back().idx;
+            open_set.pop_back();
+
+            if (loc_ctx.is_closed(curr))
+                continue;
+            loc_ctx.closed[curr] = loc_ctx.generation;
+
+            node_t curr_node = loc_node(c, curr);
+            if (target && curr_node == *target)
+                return;
+
+            cost_t curr_score = loc_ctx.g_score[curr];
+            graph.for_each_neighbor(curr_node, [&](const node_t& neigh, cost_t cost) {
+                if (neigh.x < cl.x0 || neigh.x >= cl.x1 || neigh.y < cl.y0 || neigh.y >= cl.y1)
+                    return;
+                uint32_t neigh_idx = loc_index(neigh);
+                cost_t new_score = curr_score + cost;
+                if (!loc_ctx.has_score(neigh_idx) || new_score < loc_ctx.g_score[neigh_idx]) {
+                    loc_ctx.set_score(neigh_idx, new_score, curr);
+                    loc_ctx.closed[neigh_idx] = 0;
+                    open_set.push_back({neigh_idx, new_score + h(neigh)});
+                    std::push_heap(open_set.begin(), open_set.end(), compare_fn);
+                }
+            });
+        }
+    }
+
+    uint32_t loc_index(const node_t& node) const {
+        auto &cl = clusters[loc_cluster];
+        return (node.y - cl.y0) * cluster_size + node.x - cl.x0;
+    }
+
+    node_t loc_node(uint32_t c, uint32_t idx) const {
+        auto &cl = clusters[c];
+        return node_t{ cl.x0 + int32_t(idx % cluster_size), cl.y0 + int32_t(idx / cluster_size) };
+    }
+
+    bool loc_has_score(const node_t& node) const { return loc_ctx.has_score(loc_index(node)); }
+    cost_t loc_score(const node_t& node) const { return loc_ctx.g_score[loc_index(node)]; }
+
+    grid_search_ctx_t<cost_t> abs_ctx;
+    grid_search_ctx_t<cost_t> loc_ctx;
+    uint32_t loc_cluster = 0;
+    std::vector<edge_t> goal_edges;
+};
+
+#endif
@@ -0,0 +1,294 @@
+#ifndef JUMP_POINT_H
+#define JUMP_POINT_H
+
+#include "path_finding.h"
+
+/* Jump point search (Harabor and Grastien) over a matrix_graph_wraper_t in the uniform cost mode,
+with 4 or 8 neighbors. It returns paths with the same cost as a_star_path on the same graph, but
+it only expands the jump points: the cells where the direction of an optimal path may change.
+
+On top of that, like in JPS+, build() computes once for every cell and for every straight
+direction how far the next jump point is (d > 0), or how many free cells there are until the next
+wall (d <= 0). A straight jump is then a lookup in that table and a diagonal jump, or a vertical
+one when there are only 4 neighbors, costs one lookup per step.
+
+    build(graph) - must be called before the first query and again when the walls change
+    path(start, goal) - the cells from goal to start, in the same format as a_star_path
+    expanded - the number of jump points expanded by the last query
+
+The search itself is the one of grid_a_star_path (grid_a_star_begin() and grid_a_star_step()),
+jps_search_t is the graph it runs on: the nodes are the cells of the passable grid and the
+neighbors of a node, given by for_each_scored_neighbor(), are the jump points found from it. So the
+open set is any of open_set.h (the jumps are longer than an edge, the bucket queue grows it's ring
+for them) and ctx.stats counts the jump points.
+
+The 8 neighbor rules are the ones for the grids where corners can't be cut, the 4 neighbor ones
+make the path go vertically first and then turn only at the forced neighbors.
+*/
+
+template <typename graph_t, typename open_set_t = heap_open_set_t<typename graph_t::cost_t>>
+struct jps_search_t {
+    using node_t = typename graph_t::node_t;
+    using cost_t = typename graph_t::cost_t;
+
+    static_assert(graph_t::uniform_cost, "jump points need PATH_FINDING_FLAG_UNIFORM_COST");
+    static constexpr bool diag = graph_t::neigh_cnt == 8;
+    static constexpr uint32_t invalid_idx = grid_search_ctx_t<cost_t>::invalid_idx;
+
+    enum { DIR_E, DIR_W, DIR_S, DIR_N, DIR_CNT };
+
+    passable_grid_t grid;
+    std::vector<std::array<int32_t, DIR_CNT>> jump_dist;
+    grid_search_ctx_t<cost_t> ctx;
+    open_set_t open_set;
+    uint64_t expanded = 0;
+
+    void build(const graph_t& graph) {
+        grid.build(graph);
+        jump_dist.assign(grid.cells.size(), {0, 0, 0, 0});
+
+        for (int dir = 0; dir < DIR_CNT; dir++) {
+            int32_t step = dir_step(dir);
+
+            /* the distance of a cell is computed from the one of the next cell in the direction,
+            so the cells are visited from the end of the direction to it's begining */
+            auto compute_dist = [&](uint32_t idx) {
+                if (!grid.is_free(idx))
+                    return;
+                uint32_t next = idx + step;
+                int32_t next_dist = jump_dist[next][dir];
+                if (!grid.is_free(next))
+                    jump_dist[idx][dir] = 0;
+                else if (is_forced(next, step))
+                    jump_dist[idx][dir] = 1;
+                else
+                    jump_dist[idx][dir] = next_dist > 0 ? next_dist + 1 : next_dist - 1;
+            };
+            if (step > 0)
+                for (int64_t idx = int64_t(grid.cells.size()) - 1; idx >= 0; idx--)
+                    compute_dist(idx);
+            else
+                for (uint32_t idx = 0; idx < grid.cells.size(); idx++)
+                    compute_dist(idx);
+        }
+    }
+
+    std::vector<node_t> path(const node_t& start, const node_t& goal) {
+        expanded = 0;
+        uint32_t start_idx = grid.index(start.x, start.y);
+        uint32_t goal_idx = grid.index(goal.x, goal.y);
+        if (!grid.is_free(start_idx) || !grid.is_free(goal_idx))
+            return {};
+
+        auto heuristic = [&](const node_t& node) {
+            return distance(grid.index(node.x, node.y), goal_idx);
+        };
+        grid_a_star_begin(ctx, open_set, *this, start, heuristic);
+        uint32_t curr_idx;
+        while (true) {
+            auto step = grid_a_star_step(ctx, open_set, *this, goal, goal_idx, heuristic,
+                    curr_idx);
+            if (step == GRID_A_STAR_EMPTY)
+                return {};
+            if (step == GRID_A_STAR_STALE)
+                continue;
+            expanded++;
+            if (step == GRID_A_STAR_FOUND)
+                return build_path(curr_idx);
+        }
+    }
+
+    /* the graph of grid_a_star_step */
+    uint32_t node_count() const { return grid.cells.size(); }
+    uint32_t node_index(const node_t& node) const { return grid.index(node.x, node.y); }
+    node_t index_node(uint32_t idx) const { return node_t{grid.x_of(idx), grid.y_of(idx)}; }
+
+    template <typename fn_t>
+    void for_each_scored_neighbor(uint32_t idx, cost_t g, const node_t& goal, fn_t&& fn) const {
+        uint32_t goal_idx = node_index(goal);
+        for_each_jump_point(idx, goal_idx, [&](uint32_t jp_idx) {
+            /* the heuristic is consistent here, closed nodes can't get a better score */
+            if (!ctx.is_closed(jp_idx))
+                fn(jp_idx, g + distance(idx, jp_idx), distance(jp_idx, goal_idx));
+        });
+    }
+
+    int32_t dir_step(int dir) const {
+        switch (dir) {
+            case DIR_E: return 1;
+            case DIR_W: return -1;
+            case DIR_S: return grid.stride;
+            default:    return -grid.stride;
+        }
+    }
+
+    /* a cell reached by a straight move of offset step has a forced neighbor if a cell beside it
+    is free while the one beside the previous cell is a wall */
+    bool is_forced(uint32_t idx, int32_t step) const {
+        int32_t side = (step == 1 || step == -1) ? grid.stride : 1;
+        return (grid.is_free(idx + side) && !grid.is_free(idx + side - step)) ||
+               (grid.is_free(idx - side) && !grid.is_free(idx - side - step));
+    }
+
+    /* octile distance with 8 neighbors, manhattan with 4, this is also the cost of the straight or
+    diagonal segment between two jump points */
+    cost_t distance(uint32_t a, uint32_t b) const {
+        int32_t dx = abs(grid.x_of(a) - grid.x_of(b));
+        int32_t dy = abs(grid.y_of(a) - grid.y_of(b));
+        if constexpr (diag)
+            return cost_t(std::max(dx, dy) + (sqrt(2) - 1) * std::min(dx, dy));
+        else
+            return cost_t(dx + dy);
+    }
+
+    uint32_t jump_straight(uint32_t idx, int dir, uint32_t goal_idx) const {
+        int32_t dist = jump_dist[idx][dir];
+        int32_t reach = dist > 0 ? dist : -dist;
+
+        /* the goal stops the jump if it is on the ray, before the wall or the jump point */
+        int32_t x = grid.x_of(idx), y = grid.y_of(idx);
+        int32_t gx = grid.x_of(goal_idx), gy = grid.y_of(goal_idx);
+        int32_t goal_dist = 0;
+        switch (dir) {
+            case DIR_E: goal_dist = gy == y ? gx - x : 0; break;
+            case DIR_W: goal_dist = gy == y ? x - gx : 0; break;
+            case DIR_S: goal_dist = gx == x ? gy - y : 0; break;
+            case DIR_N: goal_dist = gx == x ? y - gy : 0; break;
+        }
+        if (goal_dist > 0 && goal_dist <= reach)
+            return goal_idx;
+        return dist > 0 ? idx + dist * dir_step(dir) : invalid_idx;
+    }
+
+    uint32_t jump_diag(uint32_t idx, int32_t dx, int32_t dy, uint32_t goal_idx) const {
+        int32_t sx = dx;
+        int32_t sy = dy * grid.stride;
+        int hdir = dx > 0 ? DIR_E : DIR_W;
+        int vdir = dy > 0 ? DIR_S : DIR_N;
+        while (true) {
+            if (!grid.is_free(idx + sx) || !grid.is_free(idx + sy) || !grid.is_free(idx + sx + sy))
+                return invalid_idx;
+            idx += sx + sy;
+            if (idx == goal_idx)
+                return idx;
+            if (jump_straight(idx, hdir, goal_idx) != invalid_idx ||
+                    jump_straight(idx, vdir, goal_idx) != invalid_idx)
+                return idx;
+        }
+    }
+
+    /* with 4 neighbors a vertical jump must stop where a horizontal jump would find something */
+    uint32_t jump_vert(uint32_t idx, int32_t dy, uint32_t goal_idx) const {
+        int32_t step = dy * grid.stride;
+        int vdir = dy > 0 ? DIR_S : DIR_N;
+        while (true) {
+            if (!grid.is_free(idx + step))
+                return invalid_idx;
+            bool forced = jump_dist[idx][vdir] == 1;
+            idx += step;
+            if (idx == goal_idx || forced)
+                return idx;
+            if (jump_straight(idx, DIR_E, goal_idx) != invalid_idx ||
+                    jump_straight(idx, DIR_W, goal_idx) != invalid_idx)
+                return idx;
+        }
+    }
+
+    uint32_t jump(uint32_t idx, int32_t dx, int32_t dy, uint32_t goal_idx) const {
+        if (dx && dy)
+            return jump_diag(idx, dx, dy, goal_idx);
+        if constexpr (!diag)
+            if (dy)
+                return jump_vert(idx, dy, goal_idx);
+        if (dx)
+            return jump_straight(idx, dx > 0 ? DIR_E : DIR_W, goal_idx);
+        return jump_straight(idx, dy > 0 ? DIR_S : DIR_N, goal_idx);
+    }
+
+    /* jumps in all the directions that were not pruned, the direction of arrival in the node is
+    taken from it's parent. After a straight move only the natural neighbor is kept, plus the turns
+    to the sides that are forced (see is_forced), a diagonal move keeps it's two straight parts. */
+    template <typename fn_t>
+    void for_each_jump_point(uint32_t idx, uint32_t goal_idx, fn_t&& fn) const {
+        auto try_dir = [&](int32_t dx, int32_t dy) {
+            uint32_t jp_idx = jump(idx, dx, dy, goal_idx);
+            if (jp_idx != invalid_idx)
+                fn(jp_idx);
+        };
+
+        uint32_t prev = ctx.node_prev[idx];
+        if (prev == invalid_idx) {
+            for (auto [dx, dy] : graph_t::neigh_dirs)
+                try_dir(dx, dy);
+            return;
+        }
+        int32_t dx = (grid.x_of(idx) > grid.x_of(prev)) - (grid.x_of(idx) < grid.x_of(prev));
+        int32_t dy = (grid.y_of(idx) > grid.y_of(prev)) - (grid.y_of(idx) < grid.y_of(prev));
+        int32_t step = dx + dy * grid.stride;
+        auto forced = [&](int32_t side) {
+            return grid.is_free(idx + side) && !grid.is_free(idx + side - step);
+        };
+
+        if constexpr (diag) {
+            if (dx && dy) {
+                try_dir(dx, 0);
+                try_dir(0, dy);
+                try_dir(dx, dy);
+            }
+            else if (dx) {
+                try_dir(dx, 0);
+                for (int32_t side : {1, -1}) {
+                    if (forced(side * grid.stride)) {
+                        try_dir(0, side);
+                        try_dir(dx, side);
+                    }
+                }
+            }
+            else {
+                try_dir(0, dy);
+                for (int32_t side : {1, -1}) {
+                    if (forced(side)) {
+                        try_dir(side, 0);
+                        try_dir(side, dy);
+                    }
+                }
+            }
+        }
+        else {
+            /* the vertical jumps stop where a horizontal one finds something, so both horizontal
+            directions stay after a vertical move */
+            if (dx) {
+                try_dir(dx, 0);
+                for (int32_t side : {1, -1})
+                    if (forced(side * grid.stride))
+                        try_dir(0, side);
+            }
+            else {
+                try_dir(0, dy);
+                try_dir(1, 0);
+                try_dir(-1, 0);
+            }
+        }
+    }
+
+    /* the segments between jump points are straight or diagonal, they are filled cell by cell */
+    std::vector<node_t> build_path(uint32_t goal_idx) const {
+        std::vector<node_t> ret;
+        ret.push_back(node_t{grid.x_of(goal_idx), grid.y_of(goal_idx)});
+        for (uint32_t idx = goal_idx; ctx.node_prev[idx] != invalid_idx; idx = ctx.node_prev[idx]) {
+            uint32_t prev = ctx.node_prev[idx];
+            int32_t x = grid.x_of(idx), y = grid.y_of(idx);
+            int32_t px = grid.x_of(prev), py = grid.y_of(prev);
+            int32_t dx = (px > x) - (px < x);
+            int32_t dy = (py > y) - (py < y);
+            while (x != px || y != py) {
+                x += dx;
+                y += dy;
+                ret.push_back(node_t{x, y});
+            }
+        }
+        return ret;
+    }
+};
+
+#endif
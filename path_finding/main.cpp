@@ -5,11 +5,32 @@
 #include "misc_utils.h"
 #include "time_utils.h"
 #include "path_finding.h"
+#include "jump_point.h"
+#include "hpa_star.h"
+#include "flow_field.h"
+#include "components.h"
+#include "any_angle.h"
+#include "unit_sim.h"
+#include "gpu_field.h"
+#include "sliced_search.h"
+#include "path_service.h"
+#include "terrain_grid.h"
+#include "map_file.h"
+#include "upload_ring.h"
+#include "frame_ring.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
-#define MAX_UNIT_CNT 256
+/* the size of the instance buffer of the units, 16 bytes each */
+#define MAX_UNIT_CNT 65536
+
+/* the frames in flight, see frame_ring.h */
+#define FRAME_CNT 2
+
+/* the budget of the sliced searches in each frame */
+#define SLICED_FRAME_EXPANSIONS 2000
+#define SLICED_FRAME_US         1000
 
 struct part_t {
     glm::vec2 pos;
@@ -20,8 +41,28 @@ struct part_t {
 struct imag_params_t {
     float width;
     float heigth;
+    float show_heat;
+};
+
+/* one per unit in the storage buffer read by the unit vertex shader, it has the std430 layout of
+unit_t in the shader */
+struct unit_instance_t {
+    glm::vec2 pos;          /* in cells */
+    float angle;
+    uint32_t color;         /* 0xaabbggrr */
 };
 
+/* like vku_ubo_t::get_desc_set(), but for a storage buffer */
+static VkDescriptorSetLayoutBinding get_ssbo_desc_set(uint32_t binding, VkShaderStageFlags stage) {
+    VkDescriptorSetLayoutBinding ret{};
+    ret.binding = binding;
+    ret.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    ret.descriptorCount = 1;
+    ret.stageFlags = stage;
+    ret.pImmutableSamplers = nullptr;
+    return ret;
+}
+
 static auto create_vbuff(auto dev, auto cp, const std::vector<vku_vertex3d_t>& vertices) {
     size_t verts_sz = vertices.size() * sizeof(vertices[0]);
     auto staging_vbuff = new vku_buffer_t(
@@ -73,7 +114,6 @@ static auto create_ibuff(auto dev, auto cp, const std::vector<uint16_t>& indices
 static auto load_image(vku_cmdpool_t *cp, std::string path) {
     int w, h, chans;
     stbi_uc* pixels = stbi_load(path.c_str(), &w, &h, &chans, STBI_rgb_alpha);
-    std::vector<std::vector<double>> map_terrain;
 
     /* TODO: some more logs around here */
     vk_device_size_t imag_sz = w*h*4;
@@ -84,17 +124,57 @@ static auto load_image(vku_cmdpool_t *cp, std::string path) {
     auto img = new vku_image_t(cp->dev, w, h, VK_FORMAT_R8G8B8A8_SRGB);
     img->set_data(cp, pixels, imag_sz);
 
+    /* one byte per cell, the walls are TERRAIN_WALL and so is the border */
+    terrain_grid_t<uint8_t> map_terrain(w, h, 1, TERRAIN_WALL);
     uint32_t *pixels_data = (uint32_t *)pixels;
     for (int i = 0; i < h; i++) {
-        map_terrain.push_back(std::vector<double>(w));
-        std::string map_line = "";
         for (int j = 0; j < w; j++) {
-            map_terrain[i][j] = (pixels_data[i * w + j] == 0xff000000 ? 100000 : 1);
+            map_terrain[i][j] = (pixels_data[i * w + j] == 0xff000000 ? TERRAIN_WALL : 1);
         }
     }
+    map_terrain.build_obstacles(TERRAIN_WALL);
     stbi_image_free(pixels);
 
-    return std::pair{img, map_terrain};
+    return std::pair{img, std::move(map_terrain)};
+}
+
+/* The cells are used in place from the mapping, so map_file must outlive the returned grid. There
+is no png to decode, the texture is made from the cells: black walls on white. */
+static auto load_map_file(vku_cmdpool_t *cp, std::string path,
+        std::unique_ptr<map_file_t>& map_file)
+{
+    map_file = std::make_unique<map_file_t>(path);
+    auto map_terrain = map_file->terrain();
+    int w = map_terrain.width;
+    int h = map_terrain.height;
+
+    std::vector<uint32_t> pixels(w * h);
+    for (int i = 0; i < h; i++)
+        for (int j = 0; j < w; j++)
+            pixels[i * w + j] = map_terrain[i][j] >= TERRAIN_WALL ? 0xff000000 : 0xffffffff;
+
+    auto img = new vku_image_t(cp->dev, w, h, VK_FORMAT_R8G8B8A8_SRGB);
+    img->set_data(cp, pixels.data(), pixels.size() * sizeof(pixels[0]));
+
+    return std::pair{img, std::move(map_terrain)};
+}
+
+/* The expansions of each cell as a texture for the heat map over the terrain, on a log scale from
+blue (few) to red (the most), the cells that were never expanded are transparent. The counts are
+only there if the viewer is built with make STATS=1, otherwise the texture stays empty. */
+static void upload_heat(vku_cmdpool_t *cp, vku_image_t *img, const std::vector<uint32_t>& heat) {
+    uint32_t max_cnt = heat.size() ? *std::max_element(heat.begin(), heat.end()) : 0;
+    std::vector<uint32_t> pixels(img->width * img->height, 0);
+    for (size_t i = 0; i < heat.size() && i < pixels.size(); i++) {
+        if (!heat[i])
+            continue;
+        float t = max_cnt > 1 ? log1p(heat[i]) / log1p(max_cnt) : 1;
+        uint32_t r = 255 * t;
+        uint32_t g = 255 * (1 - std::abs(2 * t - 1));
+        uint32_t b = 255 * (1 - t);
+        pixels[i] = r | (g << 8) | (b << 16) | (0xa0u << 24);
+    }
+    img->set_data(cp, pixels.data(), pixels.size() * sizeof(pixels[0]));
 }
 
 int main(int argc, char const *argv[])
@@ -161,8 +241,11 @@ int main(int argc, char const *argv[])
         layout(binding = 2) uniform imag_params_t {
             float width;
             float heigth;
+            float show_heat;
         } imag_ubo;
 
+        layout(binding = 3) uniform sampler2D heat_sampler;
+
         void main() {
             vec2 tex_coord = vec2(in_tex_coord.x * imag_ubo.width, in_tex_coord.y * imag_ubo.heigth);
             float tx = tex_coord.x - uint(tex_coord.x);
@@ -170,8 +253,56 @@ int main(int argc, char const *argv[])
             float range = 0.1;
             if (tx < range || tx > 1 - range || ty < range || ty > 1 - range)
                 out_color = vec4(0, 0, 0, 1.0);
-            else
+            else {
                 out_color = texture(tex_sampler, in_tex_coord);
+                vec4 heat = texture(heat_sampler, in_tex_coord);
+                out_color = mix(out_color, vec4(heat.rgb, 1.0), heat.a * imag_ubo.show_heat);
+            }
+        }
+    )___");
+
+    /* the unit mesh is drawn once per instance, it's rotated and moved to the unit here, the
+    instances are in a storage buffer, indexed by gl_InstanceIndex */
+    auto unit_vert = vku_spirv_compile(inst, VKU_SPIRV_VERTEX, R"___(
+        #version 450
+
+        layout(location = 0) in vec3 in_pos;    // those are referenced by
+        layout(location = 1) in vec3 in_normal; // vku_vertex3d_t::get_input_desc()
+        layout(location = 2) in vec3 in_color;
+        layout(location = 3) in vec2 in_tex;
+
+        layout(location = 0) out vec3 out_color;
+        layout(location = 1) out vec2 out_tex_coord;
+
+        struct unit_t {
+            vec2 pos;
+            float angle;
+            uint color;
+        };
+
+        layout(std430, binding = 0) readonly buffer units_t {
+            unit_t units[];
+        } units_ssbo;
+
+        layout(binding = 2) uniform imag_params_t {
+            float width;
+            float heigth;
+            float show_heat;
+        } imag_ubo;
+
+        void main() {
+            unit_t unit = units_ssbo.units[gl_InstanceIndex];
+            float angle = unit.angle - 3.141592653589 / 2.0;
+            float c = cos(angle);
+            float s = sin(angle);
+            vec2 rot = vec2(in_pos.x * c - in_pos.y * s, in_pos.x * s + in_pos.y * c);
+
+            /* half a cell wide, centered on the cell, in [-1, 1] */
+            vec2 size = vec2(imag_ubo.width, imag_ubo.heigth);
+            vec2 pos = (rot / 2.0 + unit.pos + 0.5) * 2.0 / size - 1.0;
+            gl_Position = vec4(pos, in_pos.z, 1.0);
+            out_color = unpackUnorm4x8(unit.color).rgb;
+            out_tex_coord = in_tex;
         }
     )___");
 
@@ -192,10 +323,18 @@ int main(int argc, char const *argv[])
     auto dev =      new vku_device_t(surf);
     auto cp =       new vku_cmdpool_t(dev);
 
-    auto [img, map_terrain] = load_image(cp, "map.png");
+    /* the map is the second argument, a png or a .pfmap made by map_conv */
+    std::string map_path = argc > 2 ? argv[2] : "map.png";
+    std::unique_ptr<map_file_t> map_file;
+    auto [img, map_terrain] = map_path.ends_with(".pfmap") ?
+            load_map_file(cp, map_path, map_file) : load_image(cp, map_path);
     auto view = new vku_img_view_t(img, VK_IMAGE_ASPECT_COLOR_BIT);
     auto sampl = new vku_img_sampl_t(dev, VK_FILTER_NEAREST);
 
+    /* the heat map of the expansions, shown over the terrain, H toggles it */
+    auto heat_img = new vku_image_t(dev, img->width, img->height, VK_FORMAT_R8G8B8A8_UNORM);
+    auto heat_view = new vku_img_view_t(heat_img, VK_IMAGE_ASPECT_COLOR_BIT);
+
     auto imag_params_buff = new vku_buffer_t(
         dev,
         sizeof(imag_params),
@@ -207,6 +346,7 @@ int main(int argc, char const *argv[])
 
     imag_params.width = img->width;
     imag_params.heigth = img->height;
+    imag_params.show_heat = 1;
     memcpy(imag_params_pbuff, &imag_params, sizeof(imag_params));
 
     std::vector<vku_vertex3d_t> unit_mesh = {
@@ -233,63 +373,144 @@ int main(int argc, char const *argv[])
         {{ 1./2., 2.   , 0.0 }, {0, 0, 0}, {1.0f, 0.0f, 0.0f}, {1.0f, 0.0f}},
     };
 
-    std::vector<vku_vertex3d_t> units_vertices;
+    /* the units of the frame, the mesh above is drawn once for each */
+    std::vector<unit_instance_t> units;
     const float pi = 3.141592653589;
+    const uint32_t unit_color = 0xff0000ff;
 
     int map_width = imag_params.width;
     int map_heigth = imag_params.heigth;
 
-    auto unit_transform = [&](auto &umesh, glm::vec2 pos, float angle) {
-        float scale_x = 2.0 / map_width;
-        float scale_y = 2.0 / map_heigth;
-
-        std::vector<vku_vertex3d_t> ret;
-        angle -= pi / 2.;
-        for (auto &u : unit_mesh) {
-            float rx = u.pos.x * cos(angle) - u.pos.y * sin(angle);
-            float ry = u.pos.x * sin(angle) + u.pos.y * cos(angle);
-
-            float x = (rx / 2.0 + pos.x * 1 + 0.5 - 1.0 / scale_x) * scale_x;
-            float y = (ry / 2.0 + pos.y * 1 + 0.5 - 1.0 / scale_y) * scale_y;
-            ret.push_back({{ x, y, u.pos.z }, u.normal, u.color, u.tex});
-        }
-        return ret;
-    };
-
-    auto add_mesh = [&](const auto &mesh) {
-        units_vertices.insert(units_vertices.end(), mesh.begin(), mesh.end());
-    };
-
-    add_mesh(unit_transform(unit_mesh, {2, 3}, pi / 4.));
-
     DBG("map_heigth: %d, map_width: %d", map_heigth, map_width);
-    using graph_t = matrix_graph_wraper_t<0, decltype(map_terrain)>;
+    using graph_t = matrix_graph_wraper_t<PATH_FINDING_FLAG_UNIFORM_COST, decltype(map_terrain)>;
 
-    graph_t graph(map_terrain, map_heigth, map_width);
+    graph_t graph(map_terrain, map_heigth, map_width, TERRAIN_WALL);
     graph_t::node_t origin = {0, 0};
     graph_t::node_t goal = {map_heigth - 1, map_width - 1};
 
-    auto path = a_star_path<graph_t::heuristic_t, graph_t::cost_t>(
-            graph, origin, goal, graph.get_heuristic(goal));
+    /* the search mode is selected by the first argument: a_star (default), jps, hpa, flow, theta
+    (any-angle waypoints), smooth (a_star with the needless waypoints removed), sliced (a_star
+    spread over the frames of the main loop), async (a_star on a worker thread, polled by the main
+    loop) or gpu (the field of the goal made by a compute shader over the terrain image) */
+    std::string search_mode = argc > 1 ? argv[1] : "a_star";
+    DBG("search mode: %s", search_mode.c_str());
+
+    /* an unreachable goal is known from the labels, without any search */
+    grid_components_t<graph_t> components(graph);
+    if (!map_file || !map_file_load_components(*map_file, components))
+        components.build();
+    DBG("components: %d", components.comp_cnt);
+
+    /* the expansions of all the searches of the viewer, by cell, for the heat map */
+    std::vector<uint32_t> heat(map_heigth * map_width, 0);
+    auto add_stats = [&](const search_stats_t& stats) {
+        if (!search_stats_t::enabled)
+            return;
+        DBG("expanded: %ld pushes: %ld repushes: %ld stale pops: %ld peak open: %ld "
+                "neighbors: %fs queue: %fs", stats.expanded, stats.pushes, stats.repushes,
+                stats.stale_pops, stats.peak_open, stats.neigh_s, stats.queue_s);
+#ifdef PATH_FINDING_STATS
+        for (size_t i = 0; i < heat.size() && i < stats.heat.size(); i++)
+            heat[i] += stats.heat[i];
+#endif
+    };
 
+    std::vector<graph_t::node_t> path;
+    search_scheduler_t<graph_t> scheduler(graph);
+    path_service_t<graph_t> service(graph, 1, 1, 16, &components);
+    if (!components.connected(origin, goal)) {
+        DBG("the goal can't be reached from the origin");
+    }
+    else if (search_mode == "jps") {
+        jps_search_t<graph_t> jps;
+        jps.build(graph);
+        path = jps.path(origin, goal);
+        DBG("jump points expanded: %ld", jps.expanded);
+    }
+    else if (search_mode == "hpa") {
+        hpa_graph_t<graph_t> hpa(graph);
+        if (!map_file || !map_file_load_hpa(*map_file, hpa))
+            hpa.build();
+        path = hpa.path(origin, goal);
+        DBG("abstract nodes: %ld expanded: %ld", hpa.nodes.size(), hpa.expanded);
+    }
+    else if (search_mode == "flow") {
+        /* the path is only a walk over the field, the same field would serve any other unit */
+        flow_field_cache_t<graph_t> flow_cache(graph);
+        auto field = flow_cache.get(goal);
+        DBG("flow field passes: %d", field->passes);
+        if (field->cost(origin) != field->inf) {
+            for (auto node = origin; !(node == goal); node = field->next(node))
+                path.push_back(node);
+            path.push_back(goal);
+            std::reverse(path.begin(), path.end());
+        }
+    }
+    else if (search_mode == "sliced") {
+        /* nothing is searched here, the unit waits at the origin until the search ends */
+        scheduler.submit(origin, goal);
+    }
+    else if (search_mode == "async") {
+        /* the same, but the search runs on the thread of the service, the loop only polls */
+        service.request(0, origin, goal);
+    }
+    else if (search_mode == "gpu") {
+        /* on the device of the viewer, the walls are read from the terrain image already there */
+        passable_grid_t grid;
+        grid.build(graph);
+        gpu_field_solver_t solver(false, dev->vk_phy_dev, dev->vk_dev, dev->que_fams.graphics_id,
+                dev->vk_graphics_que);
+        auto field = solver.solve(img->vk_img, grid, std::vector{goal});
+        DBG("gpu field device: %s passes: %ld", solver.device_name.c_str(), solver.iterations);
+        path = field_path(field.data(), grid, false, origin);
+    }
+    else if (search_mode == "theta") {
+        theta_star_t<graph_t> theta;
+        theta.build(graph);
+        path = theta.path(origin, goal);
+        DBG("theta* expanded: %ld line of sight checks: %ld", theta.expanded, theta.los_checks);
+    }
+    else {
+        grid_search_ctx_t<graph_t::cost_t> search_ctx;
+        path = grid_a_star_path<graph_t::heuristic_t, graph_t::cost_t>(
+                search_ctx, graph, origin, goal, graph.get_heuristic(goal));
+        add_stats(search_ctx.stats);
+        if (search_mode == "smooth") {
+            passable_grid_t grid;
+            grid.build(graph);
+            DBG("cells: %ld", path.size());
+            path = smooth_path(grid, path);
+        }
+    }
+
+    /* the cells are bytes now, so the path is marked on the side, not in the terrain */
+    std::vector<uint8_t> on_path(map_heigth * map_width, 0);
     for (auto &n : path) {
         DBG("path node: [%d, %d]", n.y, n.x);
-        map_terrain[n.y][n.x] = -11;
+        on_path[n.y * map_width + n.x] = 1;
     }
     for (int i = 0; i < map_heigth; i++) {
         std::string map_line;
         for (int j = 0; j < map_width; j++) {
-            map_line += map_terrain[i][j] >  10 ? "#" :
-                        map_terrain[i][j] < -10 ? "X" :
-                                                  " ";
+            map_line += map_terrain.is_obstacle(j, i) ? "#" :
+                        on_path[i * map_width + j]    ? "X" :
+                                                        " ";
         }
         DBG("map_line: %s", map_line.c_str());
     }
 
-    DBG("path size: %ld", path.size());
+    DBG("path size: %ld length: %f", path.size(), path_length(path));
+    upload_heat(cp, heat_img, heat);
+
+    /* the unit moves at one cell per second along the path, straight from waypoint to waypoint, in
+    steps of a 60th of a second, it's drawn between the last two steps */
+    unit_sim_t sim(1 / 60.f);
+    uint32_t unit_id = sim.add_unit(origin.x, origin.y);
+    sim.set_path(unit_id, path, 1.f, true);
 
     auto sh_vert =  new vku_shader_t(dev, vert);
     auto sh_frag =  new vku_shader_t(dev, frag);
+    auto sh_uvert = new vku_shader_t(dev, unit_vert);
     auto sh_ufrag = new vku_shader_t(dev, unit_frag);
     auto swc =      new vku_swapchain_t(dev);
     auto rp =       new vku_renderpass_t(swc);
@@ -305,6 +526,11 @@ int main(int argc, char const *argv[])
                 view,
                 sampl
             ),
+            vku_binding_desc_t::sampl_binding_t::make_bind(
+                vku_img_sampl_t::get_desc_set(3, VK_SHADER_STAGE_FRAGMENT_BIT),
+                heat_view,
+                sampl
+            ),
         },
     };
 
@@ -317,61 +543,60 @@ int main(int argc, char const *argv[])
         bindings
     );
 
-    vku_binding_desc_t units_bindings = {
-        .binds = {
-        },
-    };
+    /* the instances are written in the region of the frame in the upload ring, one descriptor
+    set per region, the draw finds it's instances with firstInstance */
+    upload_ring_t units_ring(dev, sizeof(unit_instance_t) * MAX_UNIT_CNT, FRAME_CNT,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+    std::vector<vku_binding_desc_t> units_bindings;
+    for (uint32_t i = 0; i < FRAME_CNT; i++) {
+        units_bindings.push_back({
+            .binds = {
+                vku_binding_desc_t::buff_binding_t::make_bind(
+                    get_ssbo_desc_set(0, VK_SHADER_STAGE_VERTEX_BIT),
+                    units_ring.buffer(i)
+                ),
+                vku_binding_desc_t::buff_binding_t::make_bind(
+                    vku_ubo_t::get_desc_set(2, VK_SHADER_STAGE_VERTEX_BIT),
+                    imag_params_buff
+                ),
+            },
+        });
+    }
 
     auto units_pl = new vku_pipeline_t(
         opts,
         rp,
-        {sh_vert, sh_ufrag},
+        {sh_uvert, sh_ufrag},
         VK_PRIMITIVE_TOPOLOGY_LINE_LIST,
         vku_vertex3d_t::get_input_desc(),
-        units_bindings
+        units_bindings[0]
     );
 
     auto fbs =      new vku_framebuffs_t(rp);
 
-    auto img_sem =  new vku_sem_t(dev);
-    auto draw_sem = new vku_sem_t(dev);
-    auto fence =    new vku_fence_t(dev);
-
-    auto cbuff =    new vku_cmdbuff_t(cp);
+    frame_ring_t frames(cp, FRAME_CNT);
 
     auto vbuff = create_vbuff(dev, cp, vertices);
     auto ibuff = create_ibuff(dev, cp, indices);
 
-    size_t verts_sz = unit_mesh.size() * sizeof(unit_mesh[0]) * MAX_UNIT_CNT;
-    auto staging_vbuff = new vku_buffer_t(
-        dev,
-        verts_sz,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_SHARING_MODE_EXCLUSIVE,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-    );
-    auto staging_pvbuff = staging_vbuff->map_data(0, verts_sz);
-
-    auto units_vbuff = new vku_buffer_t(
-        dev,
-        verts_sz,
-        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-        VK_SHARING_MODE_EXCLUSIVE,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-    );
-    vku_copy_buff(cp, units_vbuff, staging_vbuff, verts_sz);
+    /* the mesh of the units is uploaded once */
+    auto unit_vbuff = create_vbuff(dev, cp, unit_mesh);
 
     auto desc_pool = new vku_desc_pool_t(dev, bindings, 1);
     auto desc_set = new vku_desc_set_t(desc_pool, pl->vk_desc_set_layout, bindings);
+    std::vector<vku_desc_set_t *> units_desc_sets;
+    for (auto &b : units_bindings) {
+        auto units_desc_pool = new vku_desc_pool_t(dev, b, 1);
+        units_desc_sets.push_back(new vku_desc_set_t(units_desc_pool, units_pl->vk_desc_set_layout,
+                b));
+    }
 
     /* TODO: print a lot more info on vulkan, available extensions, size of memory, etc. */
 
-    /* TODO: the program ever only draws on one image and waits on the fence, we need to use
-    at least two images to speed up the draw process */
-    // std::map<uint32_t, vku_sem_t *> img_sems;
-    // std::map<uint32_t, vku_sem_t *> draw_sems;
-    // std::map<uint32_t, vku_fence_t *> fences;
     double start_time = get_time_ms();
+    float prev_time = 0;
+    bool prev_heat_key = false;
 
     DBG("Starting main loop"); 
     while (!glfwWindowShouldClose(inst->window)) {
@@ -379,21 +604,60 @@ int main(int argc, char const *argv[])
             break;
         glfwPollEvents();
 
+        bool heat_key = glfwGetKey(inst->window, GLFW_KEY_H) == GLFW_PRESS;
+        if (heat_key && !prev_heat_key) {
+            /* the params are read by the frames in flight */
+            frames.wait_idle();
+            imag_params.show_heat = !imag_params.show_heat;
+            memcpy(imag_params_pbuff, &imag_params, sizeof(imag_params));
+        }
+        prev_heat_key = heat_key;
+
         try {
+            auto &frame = frames.begin();
+            auto cbuff = frame.cbuff;
             uint32_t img_idx;
-            vku_aquire_next_img(swc, img_sem, &img_idx);
+            vku_aquire_next_img(swc, frame.img_sem, &img_idx);
 
             float curr_time = double(get_time_ms()) - start_time;
 
-            units_vertices.clear();
-            int pos = curr_time / 1000.;
-            auto node = path[path.size() - 1 - (pos % path.size())];
-            // DBG("pos: %ld path node: [%d, %d]", pos % path.size(), node.y, node.x);
-            add_mesh(unit_transform(unit_mesh, {node.x, node.y}, pi / 4.));
+            for (auto id : scheduler.run(SLICED_FRAME_EXPANSIONS, SLICED_FRAME_US)) {
+                if (scheduler.status(id) == SLICED_SEARCH_FOUND)
+                    path = scheduler.path(id);
+                DBG("sliced search ended, expanded: %ld path size: %ld",
+                        scheduler.searches[id]->expanded, path.size());
+                add_stats(scheduler.searches[id]->ctx.stats);
+                scheduler.searches[id]->ctx.stats.clear();
+                if (search_stats_t::enabled) {
+                    /* the frames in flight sample the heat texture */
+                    frames.wait_idle();
+                    upload_heat(cp, heat_img, heat);
+                }
+                scheduler.release(id);
+                sim.set_path(unit_id, path, 1.f, true);
+            }
+            service.poll([&](uint32_t, std::vector<graph_t::node_t>&& new_path) {
+                path = std::move(new_path);
+                DBG("async search ended, path size: %ld", path.size());
+                sim.set_path(unit_id, path, 1.f, true);
+            });
+
+            units.clear();
+            float alpha = sim.advance((curr_time - prev_time) / 1000.);
+            /* walls can't be crossed, so the goal may be unreachable and the path empty */
+            if (path.size()) {
+                units.push_back({glm::vec2(sim.render_x(unit_id, alpha),
+                        sim.render_y(unit_id, alpha)), sim.angle(unit_id), unit_color});
+            }
+            else
+                units.push_back({glm::vec2(origin.x, origin.y), pi / 4.f, unit_color});
+            prev_time = curr_time;
 
-            verts_sz = units_vertices.size() * sizeof(units_vertices[0]);
-            memcpy(staging_pvbuff, units_vertices.data(), verts_sz);
-            vku_copy_buff(cp, units_vbuff, staging_vbuff, verts_sz);
+            /* frames.begin() waited for the fence of the last use of the region */
+            units_ring.begin_frame(frame.idx);
+            uint32_t unit_cnt = std::min<size_t>(units.size(), MAX_UNIT_CNT);
+            auto units_alloc = units_ring.push(units.data(), unit_cnt * sizeof(units[0]),
+                    sizeof(units[0]));
 
             cbuff->begin(0);
             cbuff->begin_rpass(fbs, img_idx);
@@ -405,23 +669,25 @@ int main(int argc, char const *argv[])
             
             vk_cmd_set_line_width(cbuff->vk_buff, 3);
 
-            cbuff->bind_vert_buffs(0, {{units_vbuff, 0}});
-            cbuff->draw(units_pl, units_vertices.size());
+            /* all the units in one draw */
+            cbuff->bind_vert_buffs(0, {{unit_vbuff, 0}});
+            cbuff->bind_desc_set(VK_PIPELINE_BIND_POINT_GRAPHICS, units_pl->vk_layout,
+                    units_desc_sets[frame.idx]);
+            vk_cmd_bind_pipeline(cbuff->vk_buff, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    units_pl->vk_pipeline);
+            vk_cmd_draw(cbuff->vk_buff, unit_mesh.size(), unit_cnt, 0,
+                    units_alloc.offset / sizeof(units[0]));
 
             cbuff->end_rpass();
             cbuff->end();
 
-            vku_submit_cmdbuff({{img_sem, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT}},
-                    cbuff, fence, {draw_sem});
-            vku_present(swc, {draw_sem}, img_idx);
-
-            vku_wait_fences({fence});
-            vku_reset_fences({fence});
+            vku_present(swc, {frames.submit(img_idx)}, img_idx);
         }
         catch (vku_err_t &e) {
             /* TODO: fix this (next time write what's wrong with it) */
             if (e.vk_err == VK_SUBOPTIMAL_KHR) {
                 vk_device_wait_idle(dev->vk_dev);
+                frames.reset();
 
                 delete swc;
                 swc = new vku_swapchain_t(dev);
@@ -437,10 +703,10 @@ int main(int argc, char const *argv[])
                 units_pl = new vku_pipeline_t(
                     opts,
                     rp,
-                    {sh_vert, sh_ufrag},
+                    {sh_uvert, sh_ufrag},
                     VK_PRIMITIVE_TOPOLOGY_LINE_LIST,
                     vku_vertex3d_t::get_input_desc(),
-                    units_bindings
+                    units_bindings[0]
                 );
                 fbs = new vku_framebuffs_t(rp);
             }
@@ -449,6 +715,7 @@ int main(int argc, char const *argv[])
         }
     }
 
+    frames.wait_idle();
     delete inst;
     return 0;
 }
@@ -0,0 +1,81 @@
+#define LOGGER_VERBOSE_LVL 0
+
+#include "debug.h"
+#include "misc_utils.h"
+#include "path_finding.h"
+#include "hpa_star.h"
+#include "components.h"
+#include "map_file.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+/* Converts a png map to the binary map format of map_file.h. The black pixels (0xff000000) are
+walls, like in the viewer, everything else costs 1. The connected components are always saved, the
+HPA graph is saved too if a cluster size is given, for the 4 neighbor graph of the viewer, or for 8
+neighbors with diag.
+    usage: ./map_conv.out <in.png> <out.pfmap> [cluster_size] [diag] */
+
+template <size_t graph_flags>
+static void add_hpa(map_file_writer_t& writer, terrain_grid_t<uint8_t>& terrain, int cluster_size) {
+    using graph_t = matrix_graph_wraper_t<graph_flags | PATH_FINDING_FLAG_UNIFORM_COST,
+            terrain_grid_t<uint8_t>>;
+    graph_t graph(terrain, terrain.height, terrain.width, TERRAIN_WALL);
+    hpa_graph_t<graph_t> hpa(graph, cluster_size);
+    hpa.build();
+    writer.add_hpa(hpa);
+    printf("hpa: cluster_size=%d neigh_cnt=%d nodes=%ld\n", cluster_size, graph_t::neigh_cnt,
+            hpa.nodes.size());
+}
+
+int main(int argc, char const *argv[])
+{
+    if (argc < 3) {
+        printf("usage: %s <in.png> <out.pfmap> [cluster_size] [diag]\n", argv[0]);
+        return 1;
+    }
+    int cluster_size = argc > 3 ? atoi(argv[3]) : 0;
+    bool diag = argc > 4 && std::string(argv[4]) == "diag";
+
+    int w, h, chans;
+    stbi_uc* pixels = stbi_load(argv[1], &w, &h, &chans, STBI_rgb_alpha);
+    if (!pixels) {
+        printf("failed to load %s\n", argv[1]);
+        return 1;
+    }
+
+    terrain_grid_t<uint8_t> terrain(w, h, 1, TERRAIN_WALL);
+    uint32_t *pixels_data = (uint32_t *)pixels;
+    for (int i = 0; i < h; i++)
+        for (int j = 0; j < w; j++)
+            terrain[i][j] = (pixels_data[i * w + j] == 0xff000000 ? TERRAIN_WALL : 1);
+    stbi_image_free(pixels);
+    terrain.build_obstacles(TERRAIN_WALL);
+
+    try {
+        map_file_writer_t writer(terrain, TERRAIN_WALL);
+
+        /* the same labels serve the 4 and the 8 neighbor graphs */
+        using graph_t = matrix_graph_wraper_t<PATH_FINDING_FLAG_UNIFORM_COST,
+                terrain_grid_t<uint8_t>>;
+        graph_t graph(terrain, terrain.height, terrain.width, TERRAIN_WALL);
+        grid_components_t<graph_t> components(graph);
+        components.build();
+        writer.add_components(components);
+        printf("components: %d\n", components.comp_cnt);
+
+        if (cluster_size > 0) {
+            if (diag)
+                add_hpa<PATH_FINDING_FLAG_DIAG_ENABLE>(writer, terrain, cluster_size);
+            else
+                add_hpa<0>(writer, terrain, cluster_size);
+        }
+        writer.write(argv[2]);
+    }
+    catch (std::exception& e) {
+        printf("%s\n", e.what());
+        return 1;
+    }
+    printf("%s: %dx%d -> %s\n", argv[1], w, h, argv[2]);
+    return 0;
+}
@@ -0,0 +1,406 @@
+#ifndef MAP_FILE_H
+#define MAP_FILE_H
+
+#include "terrain_grid.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Binary map files (.pfmap), made to be mapped in memory and used as they are, without decoding.
+
+The file starts with a header and a table of sections, each section is aligned to 64 bytes:
+
+    MAP_SECTION_CELLS - the cells of a terrain_grid_t<uint8_t>, border and row padding included,
+            the param of the section is the stride
+    MAP_SECTION_OBSTACLES - the bit packed obstacle layer of the grid, param is it's stride
+    MAP_SECTION_COMPONENTS - the labels of a grid_components_t, one uint32_t per cell, followed by
+            the sizes of the components, param is the number of labels (no_label included)
+    MAP_SECTION_HPA - the abstract graph of a hpa_graph_t, param is the cluster size in the low 16
+            bits and the number of neighbors of the graph it was built for in the high ones
+
+The cells and the obstacles are used in place: map_file_t::terrain() returns a terrain_grid_t view
+over the mapping. The mapping is private, so the cells can be written (by D* Lite for example)
+without changing the file. The HPA graph and the components are made of vectors, so they are copied
+out of the file by map_file_load_hpa() and map_file_load_components(), which is still much faster
+than building them.
+
+The files are written by map_file_writer_t, the map_conv tool converts png maps with it. A file of
+another version is refused, there is no conversion between versions. Nothing read from a file is
+trusted: the sizes of the sections are checked against the dimensions of the header when the file
+is opened, the ids of the HPA graph and the labels of the components when they are loaded, a bad
+file throws instead of being read out of bounds.
+*/
+
+#define MAP_FILE_VERSION 1
+
+enum : uint32_t {
+    MAP_SECTION_CELLS = 1,
+    MAP_SECTION_OBSTACLES = 2,
+    MAP_SECTION_COMPONENTS = 3,
+    MAP_SECTION_HPA = 4,
+};
+
+inline constexpr char map_file_magic[8] = {'P', 'F', 'M', 'A', 'P', 0, 0, 0};
+
+struct map_file_header_t {
+    char magic[8];
+    uint32_t version;
+    uint32_t section_cnt;
+    int32_t width;
+    int32_t height;
+    uint32_t wall_value;
+    uint32_t reserved;
+};
+
+struct map_file_section_t {
+    uint32_t type;
+    uint32_t param;
+    uint64_t offset;
+    uint64_t size;
+};
+
+/* the layout of MAP_SECTION_HPA: this header, the nodes, the edges, border_cnt + 1 offsets in the
+transitions and then the transitions, as pairs of node ids */
+struct map_file_hpa_t {
+    uint32_t node_cnt;
+    uint32_t edge_cnt;
+    uint32_t border_cnt;
+    uint32_t transition_cnt;
+
+    struct node_t {
+        int32_t x;
+        int32_t y;
+        uint32_t cluster;       /* invalid_idx for the free nodes */
+        uint32_t refs;
+        uint32_t edge_begin;
+        uint32_t edge_cnt;
+    };
+
+    struct edge_t {
+        uint32_t to;
+        uint32_t intra;
+        double cost;
+    };
+};
+
+/* the param of the MAP_SECTION_HPA section for this graph */
+template <typename hpa_t>
+uint32_t hpa_param(const hpa_t& hpa) {
+    return uint32_t(hpa.cluster_size) | (std::decay_t<decltype(hpa.graph)>::neigh_cnt << 16);
+}
+
+struct map_file_writer_t {
+    struct section_t {
+        uint32_t type;
+        uint32_t param;
+        std::vector<uint8_t> data;
+    };
+
+    int32_t width;
+    int32_t height;
+    uint32_t wall_value;
+    std::vector<section_t> sections;
+
+    template <typename cell_t>
+    map_file_writer_t(const terrain_grid_t<cell_t>& grid, uint32_t wall_value)
+    : width(grid.width), height(grid.height), wall_value(wall_value)
+    {
+        static_assert(sizeof(cell_t) == 1, "the map files hold one byte cells");
+        add_section(MAP_SECTION_CELLS, grid.stride, grid.data,
+                size_t(grid.stride) * (grid.height + 2));
+        if (grid.has_obstacles())
+            add_section(MAP_SECTION_OBSTACLES, grid.obstacle_stride, grid.obstacles,
+                    grid.obstacle_words() * sizeof(uint64_t));
+    }
+
+    void add_section(uint32_t type, uint32_t param, const void *data, size_t size) {
+        sections.push_back({type, param, std::vector<uint8_t>((uint8_t *)data,
+                (uint8_t *)data + size)});
+    }
+
+    template <typename hpa_t>
+    void add_hpa(const hpa_t& hpa) {
+        map_file_hpa_t head{};
+        std::vector<map_file_hpa_t::node_t> nodes;
+        std::vector<map_file_hpa_t::edge_t> edges;
+        std::vector<uint32_t> border_offsets;
+        std::vector<uint32_t> transitions;
+        for (auto &n : hpa.nodes) {
+            nodes.push_back({n.node.x, n.node.y, n.cluster, n.refs, uint32_t(edges.size()),
+                    uint32_t(n.edges.size())});
+            for (auto &e : n.edges)
+                edges.push_back({e.to, e.intra, double(e.cost)});
+        }
+        for (auto &b : hpa.borders) {
+            border_offsets.push_back(transitions.size() / 2);
+            for (auto [a, c] : b.transitions) {
+                transitions.push_back(a);
+                transitions.push_back(c);
+            }
+        }
+        border_offsets.push_back(transitions.size() / 2);
+        head.node_cnt = nodes.size();
+        head.edge_cnt = edges.size();
+        head.border_cnt = hpa.borders.size();
+        head.transition_cnt = transitions.size() / 2;
+
+        std::vector<uint8_t> data;
+        auto append = [&](const void *src, size_t size) {
+            data.insert(data.end(), (uint8_t *)src, (uint8_t *)src + size);
+        };
+        append(&head, sizeof(head));
+        append(nodes.data(), nodes.size() * sizeof(nodes[0]));
+        append(edges.data(), edges.size() * sizeof(edges[0]));
+        append(border_offsets.data(), border_offsets.size() * sizeof(uint32_t));
+        append(transitions.data(), transitions.size() * sizeof(uint32_t));
+        sections.push_back({MAP_SECTION_HPA, hpa_param(hpa), std::move(data)});
+    }
+
+    template <typename components_t>
+    void add_components(const components_t& comp) {
+        std::vector<uint8_t> data(comp.labels.size() * sizeof(uint32_t) +
+                comp.sizes.size() * sizeof(uint32_t));
+        memcpy(data.data(), comp.labels.data(), comp.labels.size() * sizeof(uint32_t));
+        memcpy(data.data() + comp.labels.size() * sizeof(uint32_t), comp.sizes.data(),
+                comp.sizes.size() * sizeof(uint32_t));
+        sections.push_back({MAP_SECTION_COMPONENTS, uint32_t(comp.sizes.size()), std::move(data)});
+    }
+
+    void write(const std::string& path) const {
+        map_file_header_t head{};
+        memcpy(head.magic, map_file_magic, sizeof(head.magic));
+        head.version = MAP_FILE_VERSION;
+        head.section_cnt = sections.size();
+        head.width = width;
+        head.height = height;
+        head.wall_value = wall_value;
+
+        std::vector<map_file_section_t> table;
+        uint64_t offset = align(sizeof(head) + sections.size() * sizeof(map_file_section_t));
+        for (auto &s : sections) {
+            table.push_back({s.type, s.param, offset, s.data.size()});
+            offset = align(offset + s.data.size());
+        }
+
+        FILE *f = fopen(path.c_str(), "wb");
+        if (!f)
+            throw std::runtime_error("can't open " + path + " for writing");
+        std::vector<uint8_t> zeros(64, 0);
+        bool ok = fwrite(&head, sizeof(head), 1, f) == 1;
+        ok &= fwrite(table.data(), sizeof(table[0]), table.size(), f) == table.size();
+        uint64_t pos = sizeof(head) + table.size() * sizeof(table[0]);
+        for (size_t i = 0; i < sections.size(); i++) {
+            ok &= fwrite(zeros.data(), 1, table[i].offset - pos, f) == table[i].offset - pos;
+            ok &= fwrite(sections[i].data.data(), 1, table[i].size, f) == table[i].size;
+            pos = table[i].offset + table[i].size;
+        }
+        ok &= fclose(f) == 0;
+        if (!ok)
+            throw std::runtime_error("failed to write " + path);
+    }
+
+    static uint64_t align(uint64_t offset) { return (offset + 63) / 64 * 64; }
+};
+
+struct map_file_t {
+    uint8_t *base = nullptr;
+    size_t size = 0;
+    const map_file_header_t *head = nullptr;
+    const map_file_section_t *sections = nullptr;
+
+    map_file_t(const std::string& path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("can't open " + path);
+        struct stat st;
+        if (fstat(fd, &st) < 0) {
+            close(fd);
+            throw std::runtime_error("can't stat " + path);
+        }
+        size = st.st_size;
+        void *addr = size >= sizeof(map_file_header_t) ?
+                mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        close(fd);
+        if (addr == MAP_FAILED)
+            throw std::runtime_error("can't map " + path);
+        base = (uint8_t *)addr;
+
+        head = (const map_file_header_t *)base;
+        sections = (const map_file_section_t *)(base + sizeof(map_file_header_t));
+        if (memcmp(head->magic, map_file_magic, sizeof(head->magic)) != 0)
+            fail(path + " is not a map file");
+        if (head->version != MAP_FILE_VERSION)
+            fail(path + " has version " + std::to_string(head->version) + ", expected " +
+                    std::to_string(MAP_FILE_VERSION));
+        if (sizeof(map_file_header_t) + uint64_t(head->section_cnt) * sizeof(map_file_section_t) >
+                size)
+            fail(path + " has a truncated section table");
+        for (uint32_t i = 0; i < head->section_cnt; i++)
+            if (sections[i].offset % 64 || sections[i].offset > size ||
+                    sections[i].size > size - sections[i].offset)
+                fail(path + " has a bad section");
+        if (head->width <= 0 || head->height <= 0)
+            fail(path + " has a bad size");
+
+        /* the rows of the sections must hold the width and the border, and all be there */
+        uint64_t rows = uint64_t(head->height) + 2;
+        auto cells = find(MAP_SECTION_CELLS);
+        if (!cells)
+            fail(path + " has no cells");
+        if (cells->param < uint64_t(head->width) + 2 || cells->param > INT32_MAX ||
+                cells->size < cells->param * rows)
+            fail(path + " has a bad cells section");
+        auto obst = find(MAP_SECTION_OBSTACLES);
+        if (obst && (obst->param < (uint64_t(head->width) + 2 + 63) / 64 ||
+                obst->param > INT32_MAX || obst->size / sizeof(uint64_t) < obst->param * rows))
+            fail(path + " has a bad obstacles section");
+    }
+
+    ~map_file_t() {
+        if (base)
+            munmap(base, size);
+    }
+
+    map_file_t(const map_file_t&) = delete;
+    map_file_t& operator = (const map_file_t&) = delete;
+
+    const map_file_section_t *find(uint32_t type) const {
+        for (uint32_t i = 0; i < head->section_cnt; i++)
+            if (sections[i].type == type)
+                return &sections[i];
+        return nullptr;
+    }
+
+    template <typename T>
+    T *data(const map_file_section_t *s) const { return (T *)(base + s->offset); }
+
+    /* the returned grid points in the mapping, it must not outlive this object */
+    terrain_grid_t<uint8_t> terrain() const {
+        auto cells = find(MAP_SECTION_CELLS);
+        auto ret = terrain_grid_t<uint8_t>::view(data<uint8_t>(cells), head->width, head->height,
+                cells->param);
+        if (auto obst = find(MAP_SECTION_OBSTACLES))
+            ret.view_obstacles(data<uint64_t>(obst), obst->param, head->wall_value);
+        return ret;
+    }
+
+private:
+    [[noreturn]] void fail(const std::string& msg) {
+        munmap(base, size);
+        base = nullptr;
+        throw std::runtime_error(msg);
+    }
+};
+
+/* Fills hpa with the graph saved in the file, returns false if there is none or if it was built
+with another cluster size or for another number of neighbors */
+template <typename hpa_t>
+bool map_file_load_hpa(const map_file_t& file, hpa_t& hpa) {
+    auto s = file.find(MAP_SECTION_HPA);
+    if (!s || s->param != hpa_param(hpa))
+        return false;
+
+    /* the counts come from the file, the bounds are computed before any pointer is made */
+    if (s->size < sizeof(map_file_hpa_t))
+        throw std::runtime_error("truncated hpa section");
+    auto head = file.data<map_file_hpa_t>(s);
+    uint64_t need = sizeof(map_file_hpa_t) +
+            uint64_t(head->node_cnt) * sizeof(map_file_hpa_t::node_t) +
+            uint64_t(head->edge_cnt) * sizeof(map_file_hpa_t::edge_t) +
+            (uint64_t(head->border_cnt) + 1) * sizeof(uint32_t) +
+            uint64_t(head->transition_cnt) * 2 * sizeof(uint32_t);
+    if (need > s->size)
+        throw std::runtime_error("truncated hpa section");
+    auto nodes = (const map_file_hpa_t::node_t *)(head + 1);
+    auto edges = (const map_file_hpa_t::edge_t *)(nodes + head->node_cnt);
+    auto border_offsets = (const uint32_t *)(edges + head->edge_cnt);
+    auto transitions = border_offsets + head->border_cnt + 1;
+
+    hpa.init_clusters();
+    if (head->border_cnt != hpa.borders.size())
+        return false;
+
+    /* every id is checked before hpa is touched, a bad one would index past the vectors */
+    auto &graph = hpa.graph;
+    for (uint32_t id = 0; id < head->node_cnt; id++) {
+        auto &n = nodes[id];
+        bool bad = uint64_t(n.edge_begin) + n.edge_cnt > head->edge_cnt;
+        if (n.cluster != hpa.invalid_idx)
+            bad |= n.cluster >= hpa.clusters.size() || n.x < 0 || n.y < 0 ||
+                    n.x >= graph.max_cols || n.y >= graph.max_lines;
+        if (bad)
+            throw std::runtime_error("bad node in the hpa section");
+    }
+    for (uint32_t e = 0; e < head->edge_cnt; e++)
+        if (edges[e].to >= head->node_cnt)
+            throw std::runtime_error("bad edge in the hpa section");
+    for (uint32_t b = 0; b < head->border_cnt; b++)
+        if (border_offsets[b] > border_offsets[b + 1])
+            throw std::runtime_error("bad border in the hpa section");
+    if (head->border_cnt && (border_offsets[0] != 0 ||
+            border_offsets[head->border_cnt] > head->transition_cnt))
+        throw std::runtime_error("bad border in the hpa section");
+    for (uint64_t t = 0; t < 2 * uint64_t(head->transition_cnt); t++)
+        if (transitions[t] >= head->node_cnt)
+            throw std::runtime_error("bad transition in the hpa section");
+
+    hpa.nodes.resize(head->node_cnt);
+    for (uint32_t id = 0; id < head->node_cnt; id++) {
+        auto &src = nodes[id];
+        auto &dst = hpa.nodes[id];
+        dst.node = {src.x, src.y};
+        dst.cluster = src.cluster;
+        dst.refs = src.refs;
+        dst.edges.clear();
+        for (uint32_t e = src.edge_begin; e < src.edge_begin + src.edge_cnt; e++)
+            dst.edges.push_back({edges[e].to, typename hpa_t::cost_t(edges[e].cost),
+                    bool(edges[e].intra)});
+        if (src.cluster == hpa.invalid_idx) {
+            hpa.free_nodes.push_back(id);
+            continue;
+        }
+        hpa.clusters[src.cluster].nodes.push_back(id);
+        hpa.cell_node[hpa.graph.node_index(dst.node)] = id;
+    }
+    for (uint32_t b = 0; b < head->border_cnt; b++)
+        for (uint32_t t = border_offsets[b]; t < border_offsets[b + 1]; t++)
+            hpa.borders[b].transitions.push_back({transitions[2 * t], transitions[2 * t + 1]});
+    return true;
+}
+
+/* Fills comp with the labels saved in the file, returns false if there are none or if they are not
+for a graph of this size */
+template <typename components_t>
+bool map_file_load_components(const map_file_t& file, components_t& comp) {
+    auto s = file.find(MAP_SECTION_COMPONENTS);
+    size_t cell_cnt = comp.graph.node_count();
+    if (!s || !s->param || s->size != (cell_cnt + s->param) * sizeof(uint32_t))
+        return false;
+    auto labels = file.data<uint32_t>(s);
+    auto sizes = labels + cell_cnt;
+
+    /* the updates index sizes with the labels, each label must be one of sizes and the sizes must
+    be the counts of the labels, or a later update would write out of bounds */
+    std::vector<uint32_t> counts(s->param, 0);
+    for (size_t i = 0; i < cell_cnt; i++) {
+        if (labels[i] >= s->param)
+            throw std::runtime_error("bad label in the components section");
+        counts[labels[i]]++;
+    }
+    if (sizes[comp.no_label] != 0)
+        throw std::runtime_error("bad sizes in the components section");
+    for (uint32_t l = 0; l < s->param; l++)
+        if (l != comp.no_label && counts[l] != sizes[l])
+            throw std::runtime_error("bad sizes in the components section");
+
+    comp.labels.assign(labels, labels + cell_cnt);
+    comp.sizes.assign(sizes, sizes + s->param);
+    comp.recount();
+    return true;
+}
+
+#endif
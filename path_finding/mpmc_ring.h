@@ -0,0 +1,84 @@
+#ifndef MPMC_RING_H
+#define MPMC_RING_H
+
+#include "misc_utils.h"
+
+#include <atomic>
+#include <memory>
+
+/* Bounded multi-producer multi-consumer queue (Vyukov): each slot has a sequence number that tells
+if it can be written (seq == pos) or read (seq == pos + 1) by the thread that claimed position pos,
+the positions are claimed with a CAS, so no thread ever waits for another one. */
+template <typename T>
+struct mpmc_ring_t {
+    struct alignas(64) slot_t {
+        std::atomic<size_t> seq;
+        T value;
+    };
+
+    std::unique_ptr<slot_t[]> slots;
+    size_t mask;
+    alignas(64) std::atomic<size_t> head = 0;   /* next position to write */
+    alignas(64) std::atomic<size_t> tail = 0;   /* next position to read */
+
+    mpmc_ring_t(size_t capacity) {
+        size_t cap = 2;
+        while (cap < capacity)
+            cap *= 2;
+        mask = cap - 1;
+        slots = std::make_unique<slot_t[]>(cap);
+        for (size_t i = 0; i < cap; i++)
+            slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    bool push(T&& value) {
+        return emplace([&]() -> T&& { return std::move(value); });
+    }
+
+    /* like push(), but the value is made by make() only once a slot was claimed, so make() knows
+    the push succeeds, and no consumer can read the slot before make() returned */
+    template <typename fn_t>
+    bool emplace(fn_t&& make) {
+        size_t pos = head.load(std::memory_order_relaxed);
+        slot_t *slot;
+        while (true) {
+            slot = &slots[pos & mask];
+            size_t seq = slot->seq.load(std::memory_order_acquire);
+            intptr_t diff = intptr_t(seq) - intptr_t(pos);
+            if (diff == 0) {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+                return false;       /* full */
+            else
+                pos = head.load(std::memory_order_relaxed);
+        }
+        slot->value = make();
+        slot->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& value) {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        slot_t *slot;
+        while (true) {
+            slot = &slots[pos & mask];
+            size_t seq = slot->seq.load(std::memory_order_acquire);
+            intptr_t diff = intptr_t(seq) - intptr_t(pos + 1);
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+                return false;       /* empty */
+            else
+                pos = tail.load(std::memory_order_relaxed);
+        }
+        value = std::move(slot->value);
+        slot->seq.store(pos + mask + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+#endif
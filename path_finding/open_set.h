@@ -0,0 +1,301 @@
+#ifndef OPEN_SET_H
+#define OPEN_SET_H
+
+#include "misc_utils.h"
+
+#include <bit>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+/* The open sets that a_star_path and grid_a_star_path can use. They all hold dense node ids
+(uint32_t) with a cost and have the same interface:
+
+    clear() - empties the set, the memory is kept for the next search
+    empty() - true if there is nothing left to pop
+    push(idx, cost) - adds the node, or lowers it's cost if the set can do that
+    pop() - removes and returns a node with the smallest cost
+
+The sets that can't lower the cost of a node that is already inside (heap_open_set_t, radix and
+bucket) just add it again, so pop() may return a node that was already expanded. The search must
+skip those, it does that with it's closed flag.
+
+    heap_open_set_t - binary heap, duplicates are pushed (the old std::priority_queue behaviour)
+    indexed_heap_open_set_t - binary heap with decrease-key, each node is inside at most once
+    radix_heap_open_set_t - radix heap over the bits of the cost, O(1) amortized
+    bucket_open_set_t - one bucket per 1/scale of cost in a ring, O(1) push and pop
+
+The radix heap and the bucket queue need the popped costs to never decrease, which holds for A*
+with a consistent heuristic. A cost lower than the last popped one is raised to it, so with an
+inconsistent heuristic they still work, but the order of the nodes is not exact anymore. The radix
+heap is exact otherwise. The bucket queue quantizes the costs, but it keeps them and pops the nodes
+of the current bucket by their exact cost, so the quantization doesn't change the paths.
+*/
+
+template <typename cost_t>
+struct open_entry_t {
+    uint32_t idx;
+    cost_t cost;
+};
+
+/* works on it's own vector or on one provided by the caller (the one of a grid_search_ctx_t) */
+template <typename cost_t>
+struct heap_open_set_t {
+    using entry_t = open_entry_t<cost_t>;
+
+    std::vector<entry_t> own_heap;
+    std::vector<entry_t> &heap;
+
+    heap_open_set_t() : heap(own_heap) {}
+    heap_open_set_t(std::vector<entry_t>& storage) : heap(storage) {}
+    heap_open_set_t(heap_open_set_t&& oth)
+    : own_heap(std::move(oth.own_heap)), heap(&oth.heap == &oth.own_heap ? own_heap : oth.heap)
+    {}
+
+    static bool compare_fn(const entry_t& a, const entry_t& b) { return a.cost > b.cost; }
+
+    void clear() { heap.clear(); }
+    bool empty() const { return heap.empty(); }
+
+    void push(uint32_t idx, cost_t cost) {
+        heap.push_back({idx, cost});
+        std::push_heap(heap.begin(), heap.end(), compare_fn);
+    }
+
+    uint32_t pop() {
+        std::pop_heap(heap.begin(), heap.end(), compare_fn);
+        uint32_t idx = heap.back().idx;
+        heap.pop_back();
+        return idx;
+    }
+};
+
+template <typename cost_t>
+struct indexed_heap_open_set_t {
+    static constexpr uint32_t invalid_pos = 0xffff'ffff;
+
+    std::vector<open_entry_t<cost_t>> heap;
+    std::vector<uint32_t> pos;          /* the position of the node in the heap, by node id */
+
+    void clear() {
+        for (auto &e : heap)
+            pos[e.idx] = invalid_pos;
+        heap.clear();
+    }
+    bool empty() const { return heap.empty(); }
+
+    void push(uint32_t idx, cost_t cost) {
+        if (idx >= pos.size())
+            pos.resize(std::max<size_t>(idx + 1, pos.size() * 2), invalid_pos);
+        if (pos[idx] == invalid_pos) {
+            heap.push_back({idx, cost});
+            pos[idx] = heap.size() - 1;
+            sift_up(heap.size() - 1);
+        }
+        else if (cost < heap[pos[idx]].cost) {
+            heap[pos[idx]].cost = cost;
+            sift_up(pos[idx]);
+        }
+    }
+
+    uint32_t pop() {
+        uint32_t idx = heap[0].idx;
+        pos[idx] = invalid_pos;
+        heap[0] = heap.back();
+        heap.pop_back();
+        if (heap.size()) {
+            pos[heap[0].idx] = 0;
+            sift_down(0);
+        }
+        return idx;
+    }
+
+private:
+    void place(uint32_t at, const open_entry_t<cost_t>& e) {
+        heap[at] = e;
+        pos[e.idx] = at;
+    }
+
+    void sift_up(uint32_t at) {
+        auto e = heap[at];
+        while (at > 0) {
+            uint32_t parent = (at - 1) / 2;
+            if (!(e.cost < heap[parent].cost))
+                break;
+            place(at, heap[parent]);
+            at = parent;
+        }
+        place(at, e);
+    }
+
+    void sift_down(uint32_t at) {
+        auto e = heap[at];
+        uint32_t cnt = heap.size();
+        while (true) {
+            uint32_t child = 2 * at + 1;
+            if (child >= cnt)
+                break;
+            if (child + 1 < cnt && heap[child + 1].cost < heap[child].cost)
+                child++;
+            if (!(heap[child].cost < e.cost))
+                break;
+            place(at, heap[child]);
+            at = child;
+        }
+        place(at, e);
+    }
+};
+
+/* Bucket b > 0 holds the keys that differ from the last popped key first at bit b - 1, bucket 0
+holds the keys equal to it. A pop from an empty bucket 0 redistributes the first non empty bucket,
+every key moves to a lower bucket each time, so it is moved at most once per bit of the key. The key
+is the cost itself: the bits of a float that is >= 0 are in the same order as it's value, so a
+float or a double cost is used as an unsigned integer of the same size, nothing is rounded. */
+template <typename cost_t>
+struct radix_heap_open_set_t {
+    using key_t = std::conditional_t<sizeof(cost_t) <= 4, uint32_t, uint64_t>;
+    static constexpr uint32_t key_bits = sizeof(key_t) * 8;
+
+    struct entry_t {
+        uint32_t idx;
+        key_t key;
+    };
+
+    key_t last = 0;
+    size_t cnt = 0;
+    std::array<std::vector<entry_t>, key_bits + 1> buckets;
+
+    void clear() {
+        for (auto &b : buckets)
+            b.clear();
+        last = 0;
+        cnt = 0;
+    }
+    bool empty() const { return cnt == 0; }
+
+    void push(uint32_t idx, cost_t cost) {
+        key_t key = std::max(last, key_of(cost));
+        buckets[bucket_of(key)].push_back({idx, key});
+        cnt++;
+    }
+
+    uint32_t pop() {
+        if (buckets[0].empty()) {
+            uint32_t b = 1;
+            while (buckets[b].empty())
+                b++;
+            last = std::numeric_limits<key_t>::max();
+            for (auto &e : buckets[b])
+                last = std::min(last, e.key);
+            for (auto &e : buckets[b])
+                buckets[bucket_of(e.key)].push_back(e);
+            buckets[b].clear();
+        }
+        uint32_t idx = buckets[0].back().idx;
+        buckets[0].pop_back();
+        cnt--;
+        return idx;
+    }
+
+private:
+    static key_t key_of(cost_t cost) {
+        if constexpr (std::is_floating_point_v<cost_t>) {
+            /* + 0 turns -0 into 0, the negative costs are not supported */
+            if constexpr (sizeof(cost_t) == sizeof(key_t))
+                return std::bit_cast<key_t>(cost_t(cost + 0));
+            else
+                return std::bit_cast<uint64_t>(double(cost + 0));
+        }
+        else
+            return key_t(cost);
+    }
+
+    uint32_t bucket_of(key_t key) const {
+        return key == last ? 0 : key_bits - std::countl_zero(key_t(key ^ last));
+    }
+};
+
+/* Dial's buckets: the key is the index of the bucket, the pop cursor only moves forward. The
+buckets are a ring indexed by key & mask, it only has to be as long as the spread of the keys in
+the set: for A* with a consistent heuristic that is 2 * max_edge_cost * scale (f grows by at most
+twice the edge cost from a node to it's neighbor). A wider key grows the ring, so max_edge_cost
+only sizes the first allocation. The bucket being popped is sorted by the exact costs (the lowest
+at the back), so the nodes come out in order. It's usually sorted already (the costs in it are
+equal) and the nodes pushed in it while it's popped are usually not lower than the back. */
+template <typename cost_t>
+struct bucket_open_set_t {
+    using entry_t = open_entry_t<cost_t>;
+
+    double scale;
+    uint32_t curr = 0;                  /* no key lower than this is left */
+    uint32_t max_key = 0;
+    size_t cnt = 0;
+    bool curr_sorted = false;           /* the bucket of curr is sorted, the lowest at the back */
+    std::vector<std::vector<entry_t>> buckets;
+
+    bucket_open_set_t(double scale = 8, double max_edge_cost = 2) : scale(scale) {
+        size_t size = 1;
+        while (size < 2 * max_edge_cost * scale + 2)
+            size *= 2;
+        buckets.resize(size);
+    }
+
+    static bool compare_fn(const entry_t& a, const entry_t& b) { return a.cost > b.cost; }
+
+    void clear() {
+        if (cnt)
+            for (uint32_t k = curr; k <= max_key; k++)
+                bucket(k).clear();
+        curr = 0;
+        max_key = 0;
+        cnt = 0;
+        curr_sorted = false;
+    }
+    bool empty() const { return cnt == 0; }
+
+    void push(uint32_t idx, cost_t cost) {
+        uint32_t key = std::max(curr, uint32_t(double(cost) * scale));
+        if (key - curr >= buckets.size())
+            grow(key - curr + 1);
+        auto &b = bucket(key);
+        if (key == curr && curr_sorted && b.size() && cost > b.back().cost)
+            b.insert(std::upper_bound(b.begin(), b.end(), entry_t{idx, cost}, compare_fn),
+                    entry_t{idx, cost});
+        else
+            b.push_back({idx, cost});
+        max_key = std::max(max_key, key);
+        cnt++;
+    }
+
+    uint32_t pop() {
+        while (bucket(curr).empty()) {
+            curr++;
+            curr_sorted = false;
+        }
+        auto &b = bucket(curr);
+        if (!curr_sorted) {
+            if (!std::is_sorted(b.begin(), b.end(), compare_fn))
+                std::stable_sort(b.begin(), b.end(), compare_fn);
+            curr_sorted = true;
+        }
+        uint32_t idx = b.back().idx;
+        b.pop_back();
+        cnt--;
+        return idx;
+    }
+
+private:
+    std::vector<entry_t>& bucket(uint32_t key) { return buckets[key & (buckets.size() - 1)]; }
+
+    /* the keys in the set are curr..max_key, each of them has it's own slot in both rings */
+    void grow(size_t spread) {
+        size_t size = buckets.size();
+        while (size < spread)
+            size *= 2;
+        auto old = std::exchange(buckets, std::vector<std::vector<entry_t>>(size));
+        for (uint32_t k = curr; cnt && k <= max_key; k++)
+            bucket(k) = std::move(old[k & (old.size() - 1)]);
+    }
+};
+
+#endif
@@ -0,0 +1,179 @@
+#ifndef PATH_BATCH_H
+#define PATH_BATCH_H
+
+#include "path_finding.h"
+#include "components.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+
+/* Solves batches of (start, goal) queries against one graph, on a pool of threads that is kept
+alive between batches. The graph is only read, so it is shared by all the workers, while each
+worker owns a solver with it's own search context, that is reused from query to query. The
+workers take the queries one by one from a shared counter, so long and short queries balance
+out, and they write the paths in their own buffers. At the end of the batch the paths are packed
+back to back in a single array, in the order of the queries.
+
+    path_batch_t(graph, thread_cnt, components) - thread_cnt = 0 means one worker per core, the
+            components are optional
+    solve(queries) - blocks until all the queries of the batch are solved
+
+The solver_t must be constructible from the graph and provide path(start, goal). The paths are in
+the format of a_star_path (goal to start), an empty path means the goal can't be reached. If the
+components of the graph are given (they must be kept up to date by the caller) the queries with the
+start and the goal in different components get an empty path without calling the solver.
+*/
+
+template <typename graph_t>
+struct a_star_solver_t {
+    using node_t = typename graph_t::node_t;
+    using cost_t = typename graph_t::cost_t;
+
+    const graph_t &graph;
+    grid_search_ctx_t<cost_t> ctx;
+
+    a_star_solver_t(const graph_t &graph) : graph(graph) {}
+
+    std::vector<node_t> path(const node_t& start, const node_t& goal) {
+        return grid_a_star_path<typename graph_t::heuristic_t, cost_t>(
+                ctx, graph, start, goal, graph.get_heuristic(goal));
+    }
+};
+
+template <typename graph_t, typename solver_t = a_star_solver_t<graph_t>>
+struct path_batch_t {
+    using node_t = typename graph_t::node_t;
+
+    struct query_t {
+        node_t start;
+        node_t goal;
+    };
+
+    /* the path of query i is nodes[offsets[i], offsets[i + 1]) */
+    struct result_t {
+        std::vector<node_t> nodes;
+        std::vector<uint32_t> offsets;
+
+        size_t size() const { return offsets.size() ? offsets.size() - 1 : 0; }
+        std::span<const node_t> path(size_t i) const {
+            return std::span<const node_t>(nodes.data() + offsets[i], offsets[i + 1] - offsets[i]);
+        }
+    };
+
+    struct alignas(64) worker_t {
+        solver_t solver;
+        std::vector<node_t> nodes;
+        std::vector<std::array<uint32_t, 3>> spans;     /* query index, begin, length */
+        std::thread thread;
+
+        worker_t(const graph_t &graph) : solver(graph) {}
+    };
+
+    const graph_t &graph;
+    const grid_components_t<graph_t> *components;
+    std::vector<std::unique_ptr<worker_t>> workers;
+
+    path_batch_t(const graph_t &graph, uint32_t thread_cnt = 0,
+            const grid_components_t<graph_t> *components = nullptr)
+    : graph(graph), components(components)
+    {
+        if (!thread_cnt)
+            thread_cnt = std::max(1u, std::thread::hardware_concurrency());
+        for (uint32_t i = 0; i < thread_cnt; i++)
+            workers.push_back(std::make_unique<worker_t>(graph));
+        for (auto &w : workers)
+            w->thread = std::thread([this, w = w.get()]{ worker_loop(w); });
+    }
+
+    ~path_batch_t() {
+        {
+            std::lock_guard guard(mu);
+            stop = true;
+        }
+        start_cv.notify_all();
+        for (auto &w : workers)
+            w->thread.join();
+    }
+
+    result_t solve(const std::vector<query_t>& queries) {
+        {
+            std::lock_guard guard(mu);
+            curr_queries = &queries;
+            next_query = 0;
+            done_cnt = 0;
+            batch_id++;
+        }
+        start_cv.notify_all();
+        {
+            std::unique_lock lock(mu);
+            done_cv.wait(lock, [&]{ return done_cnt == workers.size(); });
+            curr_queries = nullptr;
+        }
+
+        result_t ret;
+        ret.offsets.assign(queries.size() + 1, 0);
+        for (auto &w : workers)
+            for (auto [idx, begin, len] : w->spans)
+                ret.offsets[idx + 1] = len;
+        for (size_t i = 0; i < queries.size(); i++)
+            ret.offsets[i + 1] += ret.offsets[i];
+        ret.nodes.resize(ret.offsets.back());
+        for (auto &w : workers)
+            for (auto [idx, begin, len] : w->spans)
+                std::copy_n(w->nodes.begin() + begin, len, ret.nodes.begin() + ret.offsets[idx]);
+        return ret;
+    }
+
+private:
+    void worker_loop(worker_t *w) {
+        uint64_t seen_batch = 0;
+        while (true) {
+            const std::vector<query_t> *queries;
+            {
+                std::unique_lock lock(mu);
+                start_cv.wait(lock, [&]{ return stop || batch_id != seen_batch; });
+                if (stop)
+                    return;
+                seen_batch = batch_id;
+                queries = curr_queries;
+            }
+
+            w->nodes.clear();
+            w->spans.clear();
+            while (true) {
+                uint32_t idx = next_query.fetch_add(1, std::memory_order_relaxed);
+                if (idx >= queries->size())
+                    break;
+                auto &q = (*queries)[idx];
+                if (components && !components->connected(q.start, q.goal)) {
+                    w->spans.push_back({idx, uint32_t(w->nodes.size()), 0});
+                    continue;
+                }
+                auto path = w->solver.path(q.start, q.goal);
+                w->spans.push_back({idx, uint32_t(w->nodes.size()), uint32_t(path.size())});
+                w->nodes.insert(w->nodes.end(), path.begin(), path.end());
+            }
+
+            {
+                std::lock_guard guard(mu);
+                done_cnt++;
+            }
+            done_cv.notify_one();
+        }
+    }
+
+    std::mutex mu;
+    std::condition_variable start_cv;
+    std::condition_variable done_cv;
+    const std::vector<query_t> *curr_queries = nullptr;
+    uint64_t batch_id = 0;
+    uint32_t done_cnt = 0;
+    bool stop = false;
+    alignas(64) std::atomic<uint32_t> next_query = 0;
+};
+
+#endif
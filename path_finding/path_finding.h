@@ -2,6 +2,8 @@
 #define PATH_FINDING_H
 
 #include "misc_utils.h"
+#include "open_set.h"
+#include "search_stats.h"
 
 #include <array>
 
@@ -16,13 +18,22 @@ destination - origin.
     
     cost_t - the deduced cost for final path
     node_t - the deduced node
+
+With PATH_FINDING_FLAG_UNIFORM_COST the cells are either walls (value >= wall_value) or free and
+moving between two free cells costs 1, or sqrt(2) on a diagonal. Walls can't be entered and a
+diagonal move needs both cells beside it to be free (no cutting of corners). This is the mode
+required by the jump point search in jump_point.h.
 */
 
-#define PATH_FINDING_FLAG_DIAG_ENABLE 1
+#define PATH_FINDING_FLAG_DIAG_ENABLE   1
+#define PATH_FINDING_FLAG_UNIFORM_COST  2
+
+#define PATH_FINDING_WALL_VALUE         100000
 
 template <size_t graph_flags, typename matrix_type_t, typename _cost_t = float>
 struct matrix_graph_wraper_t {
     const static constexpr uint32_t neigh_cnt = graph_flags & PATH_FINDING_FLAG_DIAG_ENABLE ? 8 : 4;
+    const static constexpr bool uniform_cost = graph_flags & PATH_FINDING_FLAG_UNIFORM_COST;
 
     struct node_t {
         int32_t x;
@@ -42,49 +53,157 @@ struct matrix_graph_wraper_t {
     matrix_type_t &map_data;
     int32_t max_lines;
     int32_t max_cols;
+    double wall_value;
 
     using cost_t = _cost_t;
 
-    matrix_graph_wraper_t(matrix_type_t &map_data, uint32_t max_lines, uint32_t max_cols)
-    : map_data(map_data), max_lines(max_lines), max_cols(max_cols)
+    matrix_graph_wraper_t(matrix_type_t &map_data, uint32_t max_lines, uint32_t max_cols,
+            double wall_value = PATH_FINDING_WALL_VALUE)
+    : map_data(map_data), max_lines(max_lines), max_cols(max_cols), wall_value(wall_value)
     {}
 
-    std::vector<std::pair<node_t, cost_t>> neighbors(const node_t& node) const {
-        std::vector<std::pair<node_t, cost_t>> ret;
+    /* in the uniform cost mode walls can't be crossed, otherwise every cell can be entered, a
+    terrain_grid_t with an obstacle layer built for the same wall value answers from it's bits */
+    bool passable(int32_t x, int32_t y) const {
+        if constexpr (uniform_cost) {
+            if constexpr (requires { map_data.is_obstacle(x, y); })
+                if (map_data.has_obstacles() && map_data.obstacle_wall == wall_value)
+                    return !map_data.is_obstacle(x, y);
+            return map_data[y][x] < wall_value;
+        }
+        else
+            return true;
+    }
+
+    /* writes a cell, through terrain_grid_t::set() when the matrix has it, so that the obstacle
+    layer that passable() reads doesn't go stale */
+    void set_cell(int32_t x, int32_t y, double value) {
+        if constexpr (requires { map_data.set(x, y, value); })
+            map_data.set(x, y, value);
+        else
+            map_data[y][x] = value;
+    }
+
+    /* dense indexing of the nodes, used by grid_a_star_path */
+    uint32_t node_count() const { return uint32_t(max_lines) * uint32_t(max_cols); }
+    uint32_t node_index(const node_t& node) const { return node.y * max_cols + node.x; }
+    node_t index_node(uint32_t idx) const {
+        return node_t{ int32_t(idx % max_cols), int32_t(idx / max_cols) };
+    }
+
+    /* neighbor offsets as {dx, dy}, in the order in which they are visited */
+    static constexpr auto neigh_dirs = []() {
+        if constexpr (neigh_cnt == 4)
+            return std::array<std::array<int32_t, 2>, 4>{{ {0, -1}, {1, 0}, {0, 1}, {-1, 0} }};
+        else
+            return std::array<std::array<int32_t, 2>, 8>{{
+                {-1, -1}, {0, -1}, {1, -1}, {1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}
+            }};
+    }();
+
+    /* The directions of neigh_dirs that can be taken from a cell, by the walls of the 3x3 block
+    around it: the wall at {dx, dy} is bit (dy + 1) * 3 + dx + 1. Used with the obstacle layer of a
+    terrain_grid_t, the corners are checked once here instead of for every move. */
+    static constexpr auto free_dirs_table = []() {
+        std::array<uint8_t, 512> ret{};
+        auto wall = [](uint32_t walls, int32_t dx, int32_t dy) {
+            return (walls >> ((dy + 1) * 3 + dx + 1)) & 1;
+        };
+        for (uint32_t walls = 0; walls < 512; walls++) {
+            for (uint32_t k = 0; k < neigh_cnt; k++) {
+                auto [dx, dy] = neigh_dirs[k];
+                if (!wall(walls, dx, dy) && !(dx && dy && (wall(walls, dx, 0) ||
+                        wall(walls, 0, dy))))
+                    ret[walls] |= 1 << k;
+            }
+        }
+        return ret;
+    }();
+
+    /* Calls fn(node_t neigh, cost_t cost) for each neighbor of node. Nothing is allocated and fn
+    is inlined in the caller, prefer this over neighbors(). The bounds are checked once per node,
+    only the nodes on the border of the matrix pay for the per neighbor checks. In the uniform cost
+    mode with 8 neighbors, on a terrain_grid_t with an obstacle layer for the same wall value, the
+    walls around an interior node are read from the bits, 3 words instead of up to 12 cells. With 4
+    neighbors the 4 cells are read, that is as fast as the bits. */
+    template <typename fn_t>
+    void for_each_neighbor(const node_t& node, fn_t&& fn) const {
         static_assert(neigh_cnt == 4 || neigh_cnt == 8);
 
         int32_t i = node.y;
         int32_t j = node.x;
-        int32_t ml = max_lines;
-        int32_t mc = max_cols;
         auto &m = map_data;
-        if constexpr (neigh_cnt == 4) {
-            if (i-1 >= 0 ) ret.push_back({ node_t{j  , i-1}, abs(m[i-1][j  ] - m[i][j]) });
-            if (j+1 <  mc) ret.push_back({ node_t{j+1, i  }, abs(m[i  ][j+1] - m[i][j]) });
-            if (i+1 <  ml) ret.push_back({ node_t{j  , i+1}, abs(m[i+1][j  ] - m[i][j]) });
-            if (j-1 >= 0 ) ret.push_back({ node_t{j-1, i  }, abs(m[i  ][j-1] - m[i][j]) });
-            return ret;
+        auto curr = m[i][j];
+
+        if constexpr (uniform_cost) {
+            const cost_t diag_cost = cost_t(sqrt(2));
+            bool interior = i > 0 && j > 0 && i+1 < max_lines && j+1 < max_cols;
+            if constexpr (neigh_cnt == 8 && requires { m.obstacle_bits3(j, i); }) {
+                if (interior && m.has_obstacles() && m.obstacle_wall == wall_value) {
+                    uint32_t walls = m.obstacle_bits3(j, i-1) | m.obstacle_bits3(j, i) << 3 |
+                            m.obstacle_bits3(j, i+1) << 6;
+                    uint32_t free_dirs = free_dirs_table[walls];
+                    for (uint32_t k = 0; k < neigh_cnt; k++) {
+                        auto [dx, dy] = neigh_dirs[k];
+                        if ((free_dirs >> k) & 1)
+                            fn(node_t{j+dx, i+dy}, dx && dy ? diag_cost : cost_t(1));
+                    }
+                    return;
+                }
+            }
+            for (auto [dx, dy] : neigh_dirs) {
+                if (!interior && (i+dy < 0 || i+dy >= max_lines || j+dx < 0 || j+dx >= max_cols))
+                    continue;
+                if (!(m[i+dy][j+dx] < wall_value))
+                    continue;
+                if (dx && dy) {
+                    /* both cells beside a diagonal move are inside the map if the target is */
+                    if (!(m[i][j+dx] < wall_value) || !(m[i+dy][j] < wall_value))
+                        continue;
+                    fn(node_t{j+dx, i+dy}, diag_cost);
+                }
+                else
+                    fn(node_t{j+dx, i+dy}, cost_t(1));
+            }
+            return;
         }
-        else if constexpr (neigh_cnt == 8) {
-            if (i-1 >= 0  && j-1 >= 0 ) ret.push_back({ node_t{j-1, i-1}, abs(m[i-1][j-1] - m[i][j]) });
-            if (i-1 >= 0              ) ret.push_back({ node_t{j  , i-1}, abs(m[i-1][j  ] - m[i][j]) });
-            if (i-1 >= 0  && j+1 <  mc) ret.push_back({ node_t{j+1, i-1}, abs(m[i-1][j+1] - m[i][j]) });
-            if (j+1 <  mc             ) ret.push_back({ node_t{j+1, i  }, abs(m[i  ][j+1] - m[i][j]) });
-            if (i+1 <  ml && j+1 <  mc) ret.push_back({ node_t{j+1, i+1}, abs(m[i+1][j+1] - m[i][j]) });
-            if (i+1 <  ml             ) ret.push_back({ node_t{j  , i+1}, abs(m[i+1][j  ] - m[i][j]) });
-            if (i+1 <  ml && j-1 >  0 ) ret.push_back({ node_t{j-1, i+1}, abs(m[i+1][j-1] - m[i][j]) });
-            if (j-1 >= 0              ) ret.push_back({ node_t{j-1, i  }, abs(m[i  ][j-1] - m[i][j]) });
-            return ret;
+
+        if (i > 0 && j > 0 && i+1 < max_lines && j+1 < max_cols) {
+            for (auto [dx, dy] : neigh_dirs)
+                fn(node_t{j+dx, i+dy}, cost_t(abs(m[i+dy][j+dx] - curr)));
+            return;
+        }
+        for (auto [dx, dy] : neigh_dirs) {
+            if (i+dy < 0 || i+dy >= max_lines || j+dx < 0 || j+dx >= max_cols)
+                continue;
+            fn(node_t{j+dx, i+dy}, cost_t(abs(m[i+dy][j+dx] - curr)));
         }
     }
 
+    std::vector<std::pair<node_t, cost_t>> neighbors(const node_t& node) const {
+        std::vector<std::pair<node_t, cost_t>> ret;
+        ret.reserve(neigh_cnt);
+        for_each_neighbor(node, [&ret](const node_t& neigh, cost_t cost) {
+            ret.push_back({neigh, cost});
+        });
+        return ret;
+    }
+
     static auto get_heuristic(const node_t &goal) {
         // heuristics from here: https://github.com/riscy/a_star_on_grids
         static_assert(neigh_cnt == 4 || neigh_cnt == 8);
 
         const double C = 1.0;
         const double B = sqrt(2) - 1;
-        if constexpr (neigh_cnt == 4) {
+        if constexpr (neigh_cnt == 4 && uniform_cost) {
+            return [goal, C](const node_t& node) -> cost_t {
+                int32_t dx = abs(node.x - goal.x);
+                int32_t dy = abs(node.y - goal.y);
+
+                return cost_t(C * (dx + dy));
+            };
+        }
+        else if constexpr (neigh_cnt == 4) {
             return [goal, C](const node_t& node) -> cost_t {
                 int32_t dx = abs(node.x - goal.x);
                 int32_t dy = abs(node.y - goal.y);
@@ -110,67 +229,330 @@ struct matrix_graph_wraper_t {
     using heuristic_t = decltype(get_heuristic(*(node_t *)NULL));
 };
 
+/* Calls fn(neigh, cost) for each neighbor of node, through graph.for_each_neighbor() if the graph
+has it and else over the vector of graph.neighbors(), so a_star_path still works with the graphs
+that only have the older interface. */
+template <typename graph_t, typename node_t, typename fn_t>
+void visit_neighbors(const graph_t& graph, const node_t& node, fn_t&& fn) {
+    if constexpr (requires { graph.for_each_neighbor(node, fn); })
+        graph.for_each_neighbor(node, fn);
+    else
+        for (auto &[neigh, cost] : graph.neighbors(node))
+            fn(neigh, cost);
+}
+
 // used this https://www.redblobgames.com/pathfinding/a-star/implementation.html
 // and wikipedia https://en.wikipedia.org/wiki/A*_search_algorithm
-template <typename heuristic_t, typename cost_t, typename graph_t, typename node_t>
+/* The nodes get dense ids in the order in which they are discovered, so the open set (see
+open_set.h) and the per node state work on ids, only the node to id lookup is a map. */
+template <typename heuristic_t, typename cost_t, typename open_set_t = heap_open_set_t<cost_t>,
+        typename graph_t, typename node_t>
 std::vector<node_t> a_star_path(const graph_t& graph, const node_t& start, const node_t& goal,
-        const heuristic_t& heuristic)
+        const heuristic_t& heuristic, open_set_t open_set = open_set_t{},
+        search_stats_t *stats = nullptr)
 {
-    struct node_cost_t {
-        node_t node;
-        cost_t cost;
-    };
+    /* the heat of the stats is by node_index(), it's only kept for the graphs that have one, the
+    ids of this function are not dense indices */
+    constexpr bool has_index = requires { graph.node_index(start); };
+    search_stats_t no_stats;
+    search_stats_t &st = stats ? *stats : no_stats;
+    if constexpr (has_index)
+        st.begin(graph.node_count());
+    else
+        st.begin(0);
 
-    auto compare_fn = [](const node_cost_t& a, const node_cost_t& b) {
-        return a.cost < b.cost;
-    };
+    const uint32_t invalid_id = 0xffff'ffff;
+
+    /* the nodes seen until now and their ids */
+    std::map<node_t, uint32_t> node_id;
+    std::vector<node_t> id_node;
 
-    /* the set of nodes that need to be analyzed */
-    std::priority_queue<node_cost_t, std::vector<node_cost_t>, decltype(compare_fn)>
-            open_set(compare_fn);
+    /* the previous node regarding the path cost, the cost of the path to the given node and if
+    the node was expanded */
+    std::vector<uint32_t> node_prev;
+    std::vector<cost_t> g_score;
+    std::vector<uint8_t> closed;
 
-    /* the previous node regarding the path cost */
-    std::map<node_t, node_t> node_prev;
+    auto get_id = [&](const node_t& node) {
+        auto [it, inserted] = node_id.try_emplace(node, id_node.size());
+        if (inserted) {
+            id_node.push_back(node);
+            node_prev.push_back(invalid_id);
+            g_score.push_back(cost_t{0});
+            closed.push_back(0);
+        }
+        return std::pair{it->second, inserted};
+    };
 
-    /* the cost of the path to the given node */
-    std::map<node_t, cost_t> g_score;
+    open_set.clear();
+    uint32_t start_id = get_id(start).first;
+    open_set.push(start_id, heuristic(start));
+    st.on_push(false);
 
-    open_set.push({start, heuristic(start)});
-    g_score[start] = cost_t{0};
+    while (!open_set.empty()) {
+        auto queue_time = st.now();
+        uint32_t curr_id = open_set.pop();
+        st.add_queue_time(queue_time);
 
-    while (open_set.size()) {
-        auto [curr_node, cost] = open_set.top();
-        open_set.pop();
+        /* the same node may be pushed multiple times (UTCS Technical Report TR-07-54), the entries
+        that come after the first one are stale */
+        st.on_pop(closed[curr_id]);
+        if (closed[curr_id])
+            continue;
+        closed[curr_id] = 1;
 
+        node_t curr_node = id_node[curr_id];
+        if constexpr (has_index)
+            st.on_expand(graph.node_index(curr_node));
+        else
+            st.on_expand(invalid_id);
         if (curr_node == goal) {
             std::vector<node_t> ret;
-            ret.push_back(curr_node);
-            while (HAS(node_prev, curr_node)) {
-                curr_node = node_prev[curr_node];
-                ret.push_back(curr_node);
-            }
+            for (uint32_t id = curr_id; id != invalid_id; id = node_prev[id])
+                ret.push_back(id_node[id]);
             return ret;
         }
 
-        /* TODO: Test adding a map for nodes to disccard them when seeing them in the queue with
-        larger distance than on previous tries, that is to minimize the cost of analyzing the node
-        again. */
-
-        auto neighbors_dist = graph.neighbors(curr_node);
-        for (auto &[neigh, distance] : neighbors_dist) {
-            cost_t new_score = g_score[curr_node] + distance;
-            if (!HAS(g_score, neigh) || new_score < g_score[neigh]) {
-                node_prev[neigh] = curr_node;
-                g_score[neigh] = new_score;
-                DBG("new score for [%d %d] is: %f", neigh.x, neigh.y, new_score);
-
-                // we may push the same node multiple times, but we do that anyway, see:
-                // UTCS Technical Report TR-07-54
-                open_set.push({neigh, new_score + heuristic(neigh)});
+        cost_t curr_score = g_score[curr_id];
+        auto neigh_time = st.begin_neigh();
+        visit_neighbors(graph, curr_node, [&](const node_t& neigh, cost_t distance) {
+            cost_t new_score = curr_score + distance;
+            auto [neigh_id, is_new] = get_id(neigh);
+            if (is_new || new_score < g_score[neigh_id]) {
+                node_prev[neigh_id] = curr_id;
+                g_score[neigh_id] = new_score;
+
+                /* the heuristic may be inconsistent, so a closed node can be reopened */
+                closed[neigh_id] = 0;
+                auto queue_time = st.now();
+                open_set.push(neigh_id, new_score + heuristic(neigh));
+                st.add_queue_time(queue_time);
+                st.on_push(!is_new);
             }
-        }
+        });
+        st.add_neigh_time(neigh_time);
     }
     return {};
 }
 
+/* The passable cells of a grid graph, one byte per cell, surrounded by a border of walls, so the
+neighbors of any cell can be read without checking the bounds. Cell (x, y) is found at index
+(y + 1) * stride + x + 1. Used by the searches that only care about walls, like the jump point
+search and theta*. It's built from graph.passable(), so from the obstacle bits of a terrain_grid_t
+when the grid has them. */
+struct passable_grid_t {
+    int32_t width = 0;
+    int32_t height = 0;
+    int32_t stride = 0;
+    std::vector<uint8_t> cells;
+
+    template <typename graph_t>
+    void build(const graph_t& graph) {
+        width = graph.max_cols;
+        height = graph.max_lines;
+        stride = width + 2;
+        cells.assign(size_t(stride) * (height + 2), 0);
+        for (int32_t y = 0; y < height; y++)
+            for (int32_t x = 0; x < width; x++)
+                cells[index(x, y)] = graph.passable(x, y);
+    }
+
+    uint32_t index(int32_t x, int32_t y) const { return (y + 1) * stride + x + 1; }
+    int32_t x_of(uint32_t idx) const { return int32_t(idx % stride) - 1; }
+    int32_t y_of(uint32_t idx) const { return int32_t(idx / stride) - 1; }
+
+    bool is_free(uint32_t idx) const { return cells[idx]; }
+    bool is_free(int32_t x, int32_t y) const { return cells[index(x, y)]; }
+    void set_free(int32_t x, int32_t y, bool free) { cells[index(x, y)] = free; }
+};
+
+/* Search state for graphs that can map their nodes to a dense index (the matrix graph above does
+that with y*max_cols+x). The g score, the parent and the closed flag of a node live in flat arrays
+at that index. The arrays are not cleared between queries, instead each query starts a new
+generation and a slot counts only if it's stamp equals the current generation, so reusing the same
+context for many queries costs nothing after the first one.
+
+    grid_search_ctx_t is not thread safe, use one per thread.
+*/
+template <typename cost_t>
+struct grid_search_ctx_t {
+    static constexpr uint32_t invalid_idx = 0xffff'ffff;
+
+    using open_entry_t = ::open_entry_t<cost_t>;
+
+    std::vector<cost_t>         g_score;
+    std::vector<uint32_t>       node_prev;
+    std::vector<uint32_t>       stamp;      /* generation in which g_score/node_prev were set */
+    std::vector<uint32_t>       closed;     /* generation in which the node was expanded */
+    std::vector<open_entry_t>   open_set;   /* kept here only to reuse the allocation */
+    uint32_t generation = 0;
+    search_stats_t stats;                   /* of the last search, see search_stats.h */
+
+    void begin(uint32_t node_cnt) {
+        stats.begin(node_cnt);
+        if (stamp.size() < node_cnt) {
+            g_score.resize(node_cnt);
+            node_prev.resize(node_cnt);
+            stamp.resize(node_cnt, 0);
+            closed.resize(node_cnt, 0);
+        }
+        open_set.clear();
+        generation++;
+        if (generation == 0) {
+            /* wrapped around, old stamps could be mistaken for new ones */
+            std::fill(stamp.begin(), stamp.end(), 0);
+            std::fill(closed.begin(), closed.end(), 0);
+            generation = 1;
+        }
+    }
+
+    bool has_score(uint32_t idx) const { return stamp[idx] == generation; }
+    bool is_closed(uint32_t idx) const { return closed[idx] == generation; }
+
+    void set_score(uint32_t idx, cost_t score, uint32_t prev) {
+        g_score[idx] = score;
+        node_prev[idx] = prev;
+        stamp[idx] = generation;
+    }
+};
+
+/* Same algorithm as a_star_path, but the state is kept in a grid_search_ctx_t, so no allocations
+are made once the context has grown to the size of the graph. The graph must provide node_count(),
+node_index() and index_node(). The open set is one of open_set.h, it should also be reused between
+queries.
+
+A graph can also generate the neighbors of a node already scored, with
+for_each_scored_neighbor(idx, g, goal, fn) that calls fn(neigh_idx, g + cost, heuristic of neigh),
+the kernel of grid_kernel.h does that for all the neighbors at once. It's used instead of
+for_each_neighbor() and the heuristic when the graph has it.
+
+The search is also available in pieces, for the searches that run it a few steps at a time
+(sliced_search.h):
+
+    grid_a_star_begin(ctx, open_set, graph, start, heuristic) - starts a search from start
+    grid_a_star_step(ctx, open_set, graph, goal, goal_idx, heuristic, curr_idx) - pops one node
+            into curr_idx and expands it, returns what happened
+    grid_a_star_trace<node_t>(ctx, graph, idx) - the path from the start to idx, in the format
+            of a_star_path
+*/
+enum grid_a_star_step_e {
+    GRID_A_STAR_STALE,          /* the popped entry was of a node already expanded */
+    GRID_A_STAR_EXPANDED,
+    GRID_A_STAR_FOUND,          /* the goal was popped, it's not expanded */
+    GRID_A_STAR_EMPTY,          /* there was nothing to pop, there is no path */
+};
+
+template <typename heuristic_t, typename cost_t, typename open_set_t, typename graph_t,
+        typename node_t>
+void grid_a_star_begin(grid_search_ctx_t<cost_t>& ctx, open_set_t& open_set, const graph_t& graph,
+        const node_t& start, const heuristic_t& heuristic)
+{
+    ctx.begin(graph.node_count());
+    open_set.clear();
+
+    uint32_t start_idx = graph.node_index(start);
+    ctx.set_score(start_idx, cost_t{0}, ctx.invalid_idx);
+    open_set.push(start_idx, heuristic(start));
+    ctx.stats.on_push(false);
+}
+
+template <typename heuristic_t, typename cost_t, typename open_set_t, typename graph_t,
+        typename node_t>
+grid_a_star_step_e grid_a_star_step(grid_search_ctx_t<cost_t>& ctx, open_set_t& open_set,
+        const graph_t& graph, const node_t& goal, uint32_t goal_idx,
+        const heuristic_t& heuristic, uint32_t& curr_idx)
+{
+    if (open_set.empty())
+        return GRID_A_STAR_EMPTY;
+
+    auto &st = ctx.stats;
+    auto queue_time = st.now();
+    curr_idx = open_set.pop();
+    st.add_queue_time(queue_time);
+
+    /* the node was already expanded with a better score, this entry is stale */
+    st.on_pop(ctx.is_closed(curr_idx));
+    if (ctx.is_closed(curr_idx))
+        return GRID_A_STAR_STALE;
+    ctx.closed[curr_idx] = ctx.generation;
+    st.on_expand(curr_idx);
+
+    if (curr_idx == goal_idx)
+        return GRID_A_STAR_FOUND;
+
+    uint32_t parent_idx = curr_idx;
+    cost_t curr_score = ctx.g_score[curr_idx];
+    auto neigh_time = st.begin_neigh();
+
+    /* get_h is only called if the node is pushed */
+    auto relax = [&](uint32_t neigh_idx, cost_t new_score, auto&& get_h) {
+        bool had_score = ctx.has_score(neigh_idx);
+        if (!had_score || new_score < ctx.g_score[neigh_idx]) {
+            ctx.set_score(neigh_idx, new_score, parent_idx);
+
+            /* the heuristic may be inconsistent, so a closed node can be reopened */
+            ctx.closed[neigh_idx] = 0;
+            auto queue_time = st.now();
+            open_set.push(neigh_idx, new_score + get_h());
+            st.add_queue_time(queue_time);
+            st.on_push(had_score);
+        }
+    };
+    auto relax_scored = [&](uint32_t neigh_idx, cost_t new_score, cost_t h) {
+        relax(neigh_idx, new_score, [h] { return h; });
+    };
+    if constexpr (requires { graph.for_each_scored_neighbor(parent_idx, curr_score, goal,
+            relax_scored); })
+    {
+        graph.for_each_scored_neighbor(parent_idx, curr_score, goal, relax_scored);
+    }
+    else {
+        graph.for_each_neighbor(graph.index_node(parent_idx),
+                [&](const node_t& neigh, cost_t distance) {
+            relax(graph.node_index(neigh), curr_score + distance, [&] {
+                return heuristic(neigh);
+            });
+        });
+    }
+    st.add_neigh_time(neigh_time);
+    return GRID_A_STAR_EXPANDED;
+}
+
+template <typename node_t, typename cost_t, typename graph_t>
+std::vector<node_t> grid_a_star_trace(const grid_search_ctx_t<cost_t>& ctx, const graph_t& graph,
+        uint32_t idx)
+{
+    std::vector<node_t> ret;
+    for (; idx != ctx.invalid_idx; idx = ctx.node_prev[idx])
+        ret.push_back(graph.index_node(idx));
+    return ret;
+}
+
+template <typename heuristic_t, typename cost_t, typename open_set_t, typename graph_t,
+        typename node_t>
+std::vector<node_t> grid_a_star_path(grid_search_ctx_t<cost_t>& ctx, open_set_t& open_set,
+        const graph_t& graph, const node_t& start, const node_t& goal,
+        const heuristic_t& heuristic)
+{
+    grid_a_star_begin(ctx, open_set, graph, start, heuristic);
+    uint32_t goal_idx = graph.node_index(goal);
+    uint32_t curr_idx;
+    while (true) {
+        auto step = grid_a_star_step(ctx, open_set, graph, goal, goal_idx, heuristic, curr_idx);
+        if (step == GRID_A_STAR_FOUND)
+            return grid_a_star_trace<node_t>(ctx, graph, curr_idx);
+        if (step == GRID_A_STAR_EMPTY)
+            return {};
+    }
+}
+
+/* the binary heap of the context is used as the open set */
+template <typename heuristic_t, typename cost_t, typename graph_t, typename node_t>
+std::vector<node_t> grid_a_star_path(grid_search_ctx_t<cost_t>& ctx, const graph_t& graph,
+        const node_t& start, const node_t& goal, const heuristic_t& heuristic)
+{
+    heap_open_set_t<cost_t> open_set(ctx.open_set);
+    return grid_a_star_path<heuristic_t, cost_t>(ctx, open_set, graph, start, goal, heuristic);
+}
+
 #endif
@@ -0,0 +1,172 @@
+#ifndef PATH_SERVICE_H
+#define PATH_SERVICE_H
+
+#include "path_batch.h"
+#include "mpmc_ring.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+/* Path finding on background threads, for the loops that can't wait for a search: the requests go
+in lock-free queues, the workers solve them and put the paths in another lock-free queue that the
+loop drains with poll(), which never blocks. Nothing in request() or poll() takes a lock, so a burst
+of orders only costs the loop the time to copy them in the queue.
+
+    path_service_t(graph, owner_cnt, thread_cnt, queue_size, components)
+    request(owner, start, goal, priority) - asks for a path for the owner (a unit, usually), a new
+            request of the same owner supersedes the old one, false if the queue is full, the
+            old request of the owner then stays current
+    cancel(owner) - drops the request of the owner, if it was not solved yet, and it's result
+    poll(fn) - calls fn(owner, path) for each path that was solved since the last poll, in the
+            format of a_star_path, on the thread that calls poll
+    in_flight() - the requests that were made but were not polled yet (superseded ones included)
+
+Each owner has a generation that is incremented by request() and cancel(). A request carries the
+generation it was made with, the workers skip the requests that are not current anymore before
+solving them, and poll() drops the paths that became stale while they were solved.
+
+The requests of priority PATH_PRIORITY_HIGH are taken before the NORMAL ones, and those before the
+LOW ones, there is one queue for each. The graph is read by the workers while they solve, so the map
+must not change while there are requests in flight (or the components, if they are given).
+*/
+
+enum path_priority_e {
+    PATH_PRIORITY_HIGH,
+    PATH_PRIORITY_NORMAL,
+    PATH_PRIORITY_LOW,
+    PATH_PRIORITY_CNT,
+};
+
+template <typename graph_t, typename solver_t = a_star_solver_t<graph_t>>
+struct path_service_t {
+    using node_t = typename graph_t::node_t;
+
+    struct request_t {
+        uint32_t owner;
+        uint32_t generation;
+        node_t start;
+        node_t goal;
+    };
+
+    struct result_t {
+        uint32_t owner;
+        uint32_t generation;
+        std::vector<node_t> path;
+    };
+
+    const graph_t &graph;
+    const grid_components_t<graph_t> *components;
+    uint32_t owner_cnt;
+
+    path_service_t(const graph_t &graph, uint32_t owner_cnt, uint32_t thread_cnt = 1,
+            size_t queue_size = 1024, const grid_components_t<graph_t> *components = nullptr)
+    : graph(graph), components(components), owner_cnt(owner_cnt),
+      generations(std::make_unique<std::atomic<uint32_t>[]>(owner_cnt)),
+      requests{queue_size, queue_size, queue_size}, results(queue_size)
+    {
+        for (uint32_t i = 0; i < std::max(1u, thread_cnt); i++)
+            workers.emplace_back([this]{ worker_loop(); });
+    }
+
+    ~path_service_t() {
+        stop.store(true);
+        work_seq.fetch_add(1);
+        work_seq.notify_all();
+        for (auto &w : workers)
+            w.join();
+    }
+
+    bool request(uint32_t owner, const node_t& start, const node_t& goal,
+            path_priority_e priority = PATH_PRIORITY_NORMAL)
+    {
+        /* the generation is only raised once the request has it's slot, a full queue leaves the
+        old request current, and a worker can't pop the new one before the generation moved */
+        bool pushed = requests[priority].emplace([&]{
+            uint32_t generation = generations[owner].fetch_add(1, std::memory_order_relaxed) + 1;
+            return request_t{owner, generation, start, goal};
+        });
+        if (!pushed)
+            return false;
+        in_flight_cnt.fetch_add(1, std::memory_order_relaxed);
+
+        /* the system call of the notify is only made if a worker sleeps, a burst of requests
+        doesn't pay it for each of them */
+        work_seq.fetch_add(1);
+        if (sleeping.load())
+            work_seq.notify_one();
+        return true;
+    }
+
+    void cancel(uint32_t owner) {
+        generations[owner].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    template <typename fn_t>
+    size_t poll(fn_t&& fn) {
+        size_t cnt = 0;
+        result_t result;
+        while (results.pop(result)) {
+            in_flight_cnt.fetch_sub(1, std::memory_order_relaxed);
+            if (!is_current(result.owner, result.generation))
+                continue;
+            fn(result.owner, std::move(result.path));
+            cnt++;
+        }
+        return cnt;
+    }
+
+    uint32_t in_flight() const { return in_flight_cnt.load(std::memory_order_relaxed); }
+
+private:
+    bool is_current(uint32_t owner, uint32_t generation) const {
+        return generations[owner].load(std::memory_order_relaxed) == generation;
+    }
+
+    bool pop_request(request_t& req) {
+        for (auto &queue : requests)
+            if (queue.pop(req))
+                return true;
+        return false;
+    }
+
+    void worker_loop() {
+        solver_t solver(graph);
+        request_t req;
+        while (true) {
+            uint32_t seq = work_seq.load();
+            if (stop.load())
+                return;
+            if (!pop_request(req)) {
+                /* request() increments work_seq before it reads sleeping and this is the other
+                way around, so either the wait sees the new work_seq or request() notifies */
+                sleeping.fetch_add(1);
+                work_seq.wait(seq);
+                sleeping.fetch_sub(1);
+                continue;
+            }
+
+            /* superseded or cancelled requests are not solved, but still answered, so that
+            in_flight() goes back to 0 */
+            result_t result{req.owner, req.generation, {}};
+            if (is_current(req.owner, req.generation) &&
+                    (!components || components->connected(req.start, req.goal)))
+                result.path = solver.path(req.start, req.goal);
+
+            /* the loop didn't poll for a while, the paths wait until there is room for them */
+            while (!results.push(std::move(result)) && !stop.load())
+                std::this_thread::yield();
+        }
+    }
+
+    std::unique_ptr<std::atomic<uint32_t>[]> generations;
+    std::array<mpmc_ring_t<request_t>, PATH_PRIORITY_CNT> requests;
+    mpmc_ring_t<result_t> results;
+    std::vector<std::thread> workers;
+    alignas(64) std::atomic<uint32_t> work_seq = 0;
+    std::atomic<uint32_t> sleeping = 0;
+    std::atomic<uint32_t> in_flight_cnt = 0;
+    std::atomic<bool> stop = false;
+};
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef SEARCH_STATS_H
+#define SEARCH_STATS_H
+
+#include "misc_utils.h"
+
+#include <chrono>
+
+/* Counters of what a search did, to see why a query is slow. They are only kept if
+PATH_FINDING_STATS is defined (make STATS=1), otherwise search_stats_t is empty, all it's methods
+do nothing and the searches compile to the same code as without it.
+
+    expanded - the nodes that were expanded
+    pushes - the entries pushed in the open set
+    repushes - the pushes of nodes that already had a score (their cost was lowered)
+    stale_pops - the popped entries of nodes that were already expanded
+    peak_open - the most entries that were in the open set at once (pushes - pops, so with the
+            indexed heap, that lowers costs in place, it's an upper bound)
+    neigh_s - the time spent generating the neighbors and relaxing them, pushes excluded
+    queue_s - the time spent in push() and pop()
+    heat - the expansions of each node, by node_index, summed over all the searches since clear(),
+            for the heat map of the viewer
+
+The counters are reset by begin(), heat is not. The timers read the clock a few times per
+expansion, so with the stats on the searches are slower, compare the times with each other, not
+with a build without them.
+*/
+
+#ifdef PATH_FINDING_STATS
+
+struct search_stats_t {
+    static constexpr bool enabled = true;
+    using clock_t = std::chrono::steady_clock;
+    using time_t = clock_t::time_point;
+
+    uint64_t expanded = 0;
+    uint64_t pushes = 0;
+    uint64_t repushes = 0;
+    uint64_t stale_pops = 0;
+    uint64_t peak_open = 0;
+    double neigh_s = 0;
+    double queue_s = 0;
+    std::vector<uint32_t> heat;
+
+    void begin(uint32_t node_cnt) {
+        expanded = pushes = repushes = stale_pops = peak_open = 0;
+        neigh_s = queue_s = 0;
+        open_cnt = 0;
+        if (heat.size() < node_cnt)
+            heat.resize(node_cnt, 0);
+    }
+
+    void clear() { std::fill(heat.begin(), heat.end(), 0); }
+
+    void on_push(bool repush) {
+        pushes++;
+        repushes += repush;
+        open_cnt++;
+        peak_open = std::max(peak_open, open_cnt);
+    }
+
+    void on_pop(bool stale) {
+        open_cnt--;
+        stale_pops += stale;
+    }
+
+    void on_expand(uint32_t idx) {
+        expanded++;
+        if (idx < heat.size())
+            heat[idx]++;
+    }
+
+    time_t now() const { return clock_t::now(); }
+    void add_queue_time(time_t since) { queue_s += seconds(since); }
+
+    /* the pushes made while the neighbors are generated are taken out of neigh_s */
+    time_t begin_neigh() {
+        queue_mark = queue_s;
+        return clock_t::now();
+    }
+    void add_neigh_time(time_t since) { neigh_s += seconds(since) - (queue_s - queue_mark); }
+
+private:
+    uint64_t open_cnt = 0;
+    double queue_mark = 0;
+
+    double seconds(time_t since) const {
+        return std::chrono::duration<double>(clock_t::now() - since).count();
+    }
+};
+
+#else
+
+struct search_stats_t {
+    static constexpr bool enabled = false;
+    using time_t = int;
+
+    static constexpr uint64_t expanded = 0;
+    static constexpr uint64_t pushes = 0;
+    static constexpr uint64_t repushes = 0;
+    static constexpr uint64_t stale_pops = 0;
+    static constexpr uint64_t peak_open = 0;
+    static constexpr double neigh_s = 0;
+    static constexpr double queue_s = 0;
+
+    void begin(uint32_t) {}
+    void clear() {}
+    void on_push(bool) {}
+    void on_pop(bool) {}
+    void on_expand(uint32_t) {}
+    time_t now() const { return 0; }
+    void add_queue_time(time_t) {}
+    time_t begin_neigh() { return 0; }
+    void add_neigh_time(time_t) {}
+};
+
+#endif
+
+#endif
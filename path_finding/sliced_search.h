@@ -0,0 +1,200 @@
+#ifndef SLICED_SEARCH_H
+#define SLICED_SEARCH_H
+
+#include "path_finding.h"
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <optional>
+
+/* A* that can be stopped and resumed, so a search can be spread over many frames instead of
+stalling the one that asked for it. The steps are the ones of grid_a_star_path
+(grid_a_star_begin() and grid_a_star_step()), the state that lives on the stack there (the context,
+the open set and the heuristic) is kept in the object instead.
+
+    sliced_search_t::begin(start, goal) - starts a new search, the memory of the last one is reused
+    sliced_search_t::step(max_expansions, max_us) - expands nodes until the search ends or until
+            one of the budgets runs out (0 means no limit on that one), returns the status
+    sliced_search_t::path() - the path once the status is SLICED_SEARCH_FOUND, in the format of
+            a_star_path, until then the path to the node closest to the goal (by the heuristic)
+            expanded so far, so a unit can already start moving in the right direction
+
+    search_scheduler_t - runs many searches round-robin under one budget per frame:
+            submit(start, goal) returns an id, run(max_expansions, max_us) is called once per
+            frame and returns the ids that ended in it, status(id)/path(id) read the result and
+            release(id) gives the search back to the pool
+
+The clock is only read every time_check_period expansions, a budget in microseconds can be passed
+by that much. Each search has it's own context, so it holds about 16 bytes per node of the graph,
+the pool keeps the released searches to reuse that memory. ctx.stats is kept as in
+grid_a_star_path (see search_stats.h), over all the steps since begin().
+*/
+
+enum sliced_search_status_e {
+    SLICED_SEARCH_IDLE,
+    SLICED_SEARCH_RUNNING,
+    SLICED_SEARCH_FOUND,
+    SLICED_SEARCH_NO_PATH,
+};
+
+template <typename graph_t, typename open_set_t = heap_open_set_t<typename graph_t::cost_t>>
+struct sliced_search_t {
+    using node_t = typename graph_t::node_t;
+    using cost_t = typename graph_t::cost_t;
+    using heuristic_t = typename graph_t::heuristic_t;
+
+    static constexpr uint32_t time_check_period = 64;
+
+    const graph_t &graph;
+    grid_search_ctx_t<cost_t> ctx;
+    open_set_t open_set;
+    std::optional<heuristic_t> heuristic;
+
+    node_t start;
+    node_t goal;
+    uint32_t goal_idx = 0;
+    uint32_t best_idx = 0;              /* the expanded node with the lowest heuristic */
+    cost_t best_h = 0;
+    sliced_search_status_e status = SLICED_SEARCH_IDLE;
+    uint64_t expanded = 0;              /* since begin() */
+
+    sliced_search_t(const graph_t &graph) : graph(graph) {}
+
+    void begin(const node_t& start, const node_t& goal) {
+        this->start = start;
+        this->goal = goal;
+        heuristic.emplace(graph.get_heuristic(goal));
+        grid_a_star_begin(ctx, open_set, graph, start, *heuristic);
+        expanded = 0;
+
+        goal_idx = graph.node_index(goal);
+        best_idx = graph.node_index(start);
+        best_h = (*heuristic)(start);
+        status = SLICED_SEARCH_RUNNING;
+    }
+
+    sliced_search_status_e step(uint64_t max_expansions, uint64_t max_us = 0) {
+        using clock_t = std::chrono::steady_clock;
+        auto deadline = clock_t::now() + std::chrono::microseconds(max_us);
+
+        /* the budget counts expansions, the stale entries popped on the way are not */
+        uint64_t expanded_before = expanded;
+        for (uint64_t i = 0; status == SLICED_SEARCH_RUNNING; i++) {
+            if (max_expansions && expanded - expanded_before >= max_expansions)
+                break;
+            if (max_us && i % time_check_period == time_check_period - 1 &&
+                    clock_t::now() >= deadline)
+                break;
+
+            uint32_t curr_idx;
+            auto res = grid_a_star_step(ctx, open_set, graph, goal, goal_idx, *heuristic,
+                    curr_idx);
+            if (res == GRID_A_STAR_EMPTY) {
+                status = SLICED_SEARCH_NO_PATH;
+                break;
+            }
+            if (res == GRID_A_STAR_STALE)
+                continue;
+            expanded++;
+            if (res == GRID_A_STAR_FOUND) {
+                status = SLICED_SEARCH_FOUND;
+                break;
+            }
+
+            cost_t h = (*heuristic)(graph.index_node(curr_idx));
+            if (h < best_h) {
+                best_h = h;
+                best_idx = curr_idx;
+            }
+        }
+        return status;
+    }
+
+    std::vector<node_t> path() const {
+        if (status == SLICED_SEARCH_IDLE)
+            return {};
+        uint32_t last = status == SLICED_SEARCH_FOUND ? goal_idx : best_idx;
+        return grid_a_star_trace<node_t>(ctx, graph, last);
+    }
+};
+
+template <typename graph_t, typename search_t = sliced_search_t<graph_t>>
+struct search_scheduler_t {
+    using node_t = typename graph_t::node_t;
+
+    const graph_t &graph;
+    std::vector<std::unique_ptr<search_t>> searches;    /* by id */
+    std::vector<uint32_t> free_ids;
+    std::deque<uint32_t> running;       /* the front one runs first in the next frame */
+    uint64_t expanded = 0;              /* by the last run() */
+
+    search_scheduler_t(const graph_t &graph) : graph(graph) {}
+
+    uint32_t submit(const node_t& start, const node_t& goal) {
+        uint32_t id;
+        if (free_ids.size()) {
+            id = free_ids.back();
+            free_ids.pop_back();
+        }
+        else {
+            id = searches.size();
+            searches.push_back(std::make_unique<search_t>(graph));
+        }
+        searches[id]->begin(start, goal);
+        running.push_back(id);
+        return id;
+    }
+
+    /* The budget is shared by the running searches, each gets a slice of it in turn. A search that
+    doesn't end in it's slice goes to the back of the queue, so the next frame starts with the
+    ones that didn't run in this one. */
+    std::vector<uint32_t> run(uint64_t max_expansions, uint64_t max_us = 0,
+            uint64_t min_slice = 256)
+    {
+        using clock_t = std::chrono::steady_clock;
+        auto begin = clock_t::now();
+        std::vector<uint32_t> ended;
+        expanded = 0;
+
+        size_t cnt = running.size();
+        for (size_t i = 0; i < cnt && running.size(); i++) {
+            uint64_t used_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                    clock_t::now() - begin).count();
+            if ((max_expansions && expanded >= max_expansions) || (max_us && used_us >= max_us))
+                break;
+
+            /* what is left is split between the searches that didn't run yet */
+            uint64_t left = cnt - i;
+            uint64_t slice_exp = max_expansions ?
+                    std::max(min_slice, (max_expansions - expanded) / left) : 0;
+            uint64_t slice_us = max_us ? std::max<uint64_t>(1, (max_us - used_us) / left) : 0;
+
+            uint32_t id = running.front();
+            running.pop_front();
+            auto &s = *searches[id];
+            uint64_t before = s.expanded;
+            auto st = s.step(slice_exp, slice_us);
+            expanded += s.expanded - before;
+            if (st == SLICED_SEARCH_RUNNING)
+                running.push_back(id);
+            else
+                ended.push_back(id);
+        }
+        return ended;
+    }
+
+    sliced_search_status_e status(uint32_t id) const { return searches[id]->status; }
+    std::vector<node_t> path(uint32_t id) const { return searches[id]->path(); }
+
+    /* the search stops if it was still running */
+    void release(uint32_t id) {
+        auto it = std::find(running.begin(), running.end(), id);
+        if (it != running.end())
+            running.erase(it);
+        searches[id]->status = SLICED_SEARCH_IDLE;
+        free_ids.push_back(id);
+    }
+};
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef TERRAIN_GRID_H
+#define TERRAIN_GRID_H
+
+#include "misc_utils.h"
+
+#include <limits>
+#include <memory>
+#include <vector>
+
+/* A compact replacement for the vector<vector<double>> terrain: all the cells are in one block, the
+rows are padded to a multiple of 64 bytes, so every row starts on it's own cache line, and the
+grid is surrounded by a border of one cell that holds border_value (a wall, usually). grid[y]
+returns a pointer to the first cell of the row, so grid[y][x] works like with the nested vectors
+and matrix_graph_wraper_t takes the grid as it is. The border means grid[y][-1] and grid[-1][x]
+are valid reads.
+
+    terrain_grid_t(width, height, fill, border_value) - allocates and owns the cells
+    terrain_grid_t::view(data, width, height, stride) - uses cells that live somewhere else (a
+            mapped file), data points to the first cell of the border row, the memory is not freed
+    build_obstacles(wall_value) - fills the bit packed obstacle layer: one bit per cell, set if
+            the cell is >= wall_value, it has the same border as the cells
+    view_obstacles(bits, stride, wall_value) - uses an obstacle layer that lives somewhere else
+    obstacle_bits3(x, y) - the obstacles of the 3 cells around x in row y, one read for most x
+    set(x, y, value) - writes a cell and keeps the obstacle layer, if there is one, in sync
+
+matrix_graph_wraper_t::passable() reads the obstacle layer when it was built for the wall value of
+the graph, so passable_grid_t::build(), and with it the jump point search and theta*, use the bits
+instead of the cells.
+
+With uint8_t cells a map takes 8 times less memory than with doubles and the obstacle layer alone,
+for the code that only cares about walls, takes 64 times less.
+*/
+
+/* the wall value of the uint8_t grids of the viewer and of the map files */
+#define TERRAIN_WALL 255
+
+template <typename _cell_t>
+struct terrain_grid_t {
+    using cell_t = _cell_t;
+
+    static constexpr int32_t line_cells = 64 / sizeof(cell_t) ? 64 / sizeof(cell_t) : 1;
+
+    int32_t width = 0;
+    int32_t height = 0;
+    int32_t stride = 0;             /* cells from one row to the next, border included */
+    cell_t *data = nullptr;         /* the first cell of the border row, above row 0 */
+
+    double obstacle_wall = 0;
+    int32_t obstacle_stride = 0;    /* 64 bit words per row of the obstacle layer */
+    uint64_t *obstacles = nullptr;  /* the words of the border row first, like data */
+
+    terrain_grid_t() {}
+
+    terrain_grid_t(int32_t width, int32_t height, cell_t fill = cell_t{0},
+            cell_t border_value = std::numeric_limits<cell_t>::max())
+    : width(width), height(height)
+    {
+        stride = (width + 2 + line_cells - 1) / line_cells * line_cells;
+        size_t bytes = size_t(stride) * (height + 2) * sizeof(cell_t);
+        owned.reset((cell_t *)std::aligned_alloc(64, bytes));
+        if (!owned)
+            throw std::bad_alloc();
+        data = owned.get();
+
+        std::fill_n(data, size_t(stride) * (height + 2), border_value);
+        for (int32_t y = 0; y < height; y++)
+            std::fill_n((*this)[y], width, fill);
+    }
+
+    static terrain_grid_t view(cell_t *data, int32_t width, int32_t height, int32_t stride) {
+        terrain_grid_t ret;
+        ret.width = width;
+        ret.height = height;
+        ret.stride = stride;
+        ret.data = data;
+        return ret;
+    }
+
+    cell_t *operator [] (int32_t y) { return data + size_t(y + 1) * stride + 1; }
+    const cell_t *operator [] (int32_t y) const { return data + size_t(y + 1) * stride + 1; }
+
+    void build_obstacles(double wall_value) {
+        obstacle_wall = wall_value;
+        obstacle_stride = (width + 2 + 63) / 64;
+        owned_obstacles.assign(size_t(obstacle_stride) * (height + 2), 0);
+        obstacles = owned_obstacles.data();
+        for (int32_t y = -1; y <= height; y++)
+            for (int32_t x = -1; x <= width; x++)
+                if (!((*this)[y][x] < wall_value))
+                    set_obstacle(x, y, true);
+    }
+
+    void view_obstacles(uint64_t *bits, int32_t stride, double wall_value) {
+        owned_obstacles.clear();
+        obstacles = bits;
+        obstacle_stride = stride;
+        obstacle_wall = wall_value;
+    }
+
+    bool has_obstacles() const { return obstacles; }
+    size_t obstacle_words() const { return obstacles ? size_t(obstacle_stride) * (height + 2) : 0; }
+
+    bool is_obstacle(int32_t x, int32_t y) const {
+        size_t bit = x + 1;
+        return (obstacles[size_t(y + 1) * obstacle_stride + bit / 64] >> (bit % 64)) & 1;
+    }
+
+    /* the obstacle bits of the cells x - 1, x and x + 1 of row y, in the bits 0, 1 and 2, the
+    border makes x - 1 = -1 and x + 1 = width valid */
+    uint32_t obstacle_bits3(int32_t x, int32_t y) const {
+        size_t bit = x;
+        const uint64_t *row = obstacles + size_t(y + 1) * obstacle_stride;
+        uint64_t bits = row[bit / 64] >> (bit % 64);
+        if (bit % 64 > 61)
+            bits |= row[bit / 64 + 1] << (64 - bit % 64);
+        return bits & 7;
+    }
+
+    void set(int32_t x, int32_t y, cell_t value) {
+        (*this)[y][x] = value;
+        if (has_obstacles())
+            set_obstacle(x, y, !(value < obstacle_wall));
+    }
+
+    size_t memory_bytes() const {
+        return (owned ? size_t(stride) * (height + 2) * sizeof(cell_t) : 0) +
+                owned_obstacles.size() * sizeof(uint64_t);
+    }
+
+private:
+    void set_obstacle(int32_t x, int32_t y, bool wall) {
+        size_t bit = x + 1;
+        uint64_t &word = obstacles[size_t(y + 1) * obstacle_stride + bit / 64];
+        word = wall ? word | (1ull << (bit % 64)) : word & ~(1ull << (bit % 64));
+    }
+
+    struct free_deleter_t {
+        void operator () (cell_t *p) const { std::free(p); }
+    };
+    std::unique_ptr<cell_t, free_deleter_t> owned;
+    std::vector<uint64_t> owned_obstacles;
+};
+
+#endif
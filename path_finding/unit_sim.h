@@ -0,0 +1,321 @@
+#ifndef UNIT_SIM_H
+#define UNIT_SIM_H
+
+#include "misc_utils.h"
+
+#include <cmath>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+# include <immintrin.h>
+#endif
+
+/* Many units following their own paths, moved in fixed steps. The state is kept as arrays of each
+field (x[], y[], vx[], ...), one entry per unit, so a step moves all the units with a few vector
+operations per 8 (AVX2) or 4 (SSE2) units, instead of a call per unit like waypoint_walker_t.
+
+    unit_sim_t(tick_s) - the length of a step, in seconds
+    add_unit(x, y) - a unit that doesn't move, returns it's id
+    set_path(unit, path, speed, loop) - the unit walks path (in the a_star_path format, goal to
+            start) from the start at speed cells per second, if loop is set it starts again from
+            the start at the end, otherwise it stops on the goal
+    advance(dt) - runs the steps that fit in dt plus what was left from the last call, returns
+            how far the sim is into the next step, in [0, 1), to interpolate with
+    render_x(unit, alpha), render_y(), angle() - where to draw the unit, between the last two steps
+
+Each unit walks toward it's target (tx, ty), the next waypoint of it's path. A step is one pass of
+the kernel over all the units: the units that don't reach their target move by speed * tick_s
+toward it, the others are put on it and listed. The listed ones (a few per step) then go on to the
+next waypoint in plain code, with what was left of their step. The kernel is picked like the one of
+grid_kernel.h, AVX2, SSE2 or plain loops, the three give the same results.
+
+The waypoints of all the paths are in one pool, a new path is added at the end and the pool is
+compacted when most of it belongs to old paths.
+*/
+
+struct unit_sim_t {
+    static constexpr uint32_t lanes = 8;        /* the arrays are padded to a multiple of this */
+
+    float tick_s;
+    double accum = 0;                           /* the time not simulated yet */
+    uint32_t max_ticks = 16;                    /* per advance(), the rest of the time is dropped */
+    uint64_t ticks = 0;
+    uint32_t unit_cnt = 0;
+
+    /* per unit, a stopped unit has speed 0 */
+    std::vector<float> x, y;
+    std::vector<float> prev_x, prev_y;          /* at the step before, for the interpolation */
+    std::vector<float> vx, vy;                  /* in cells per second */
+    std::vector<float> tx, ty;
+    std::vector<float> speed;
+    std::vector<uint32_t> cursor;               /* the waypoint of the target in the pool */
+    std::vector<uint32_t> path_begin, path_end;
+    std::vector<uint8_t> loop;
+
+    std::vector<float> wx, wy;                  /* the pool of the waypoints */
+
+    unit_sim_t(float tick_s = 1 / 60.f) : tick_s(tick_s) {}
+
+    uint32_t add_unit(float ux, float uy) {
+        uint32_t id = unit_cnt++;
+        if (id >= x.size())
+            resize((id / lanes + 1) * lanes);
+        x[id] = prev_x[id] = tx[id] = ux;
+        y[id] = prev_y[id] = ty[id] = uy;
+        vx[id] = vy[id] = speed[id] = 0;
+        cursor[id] = path_begin[id] = path_end[id] = 0;
+        loop[id] = 0;
+        return id;
+    }
+
+    template <typename node_t>
+    void set_path(uint32_t unit, const std::vector<node_t>& path, float unit_speed,
+            bool loop_path = false)
+    {
+        if (wx.size() > 1024 && wx.size() > 2 * live_waypoints())
+            compact();
+        /* a waypoint equal to the one before it is dropped, a segment of length 0 would never
+        use any of the step */
+        path_begin[unit] = wx.size();
+        for (size_t i = path.size(); i-- > 0;) {
+            if (wx.size() > path_begin[unit] && wx.back() == float(path[i].x) &&
+                    wy.back() == float(path[i].y))
+                continue;
+            wx.push_back(path[i].x);
+            wy.push_back(path[i].y);
+        }
+        path_end[unit] = wx.size();
+        loop[unit] = loop_path;
+        vx[unit] = vy[unit] = 0;
+        if (path.empty()) {
+            speed[unit] = 0;
+            return;
+        }
+
+        /* from the start of the path, not from where the unit is */
+        uint32_t b = path_begin[unit];
+        x[unit] = prev_x[unit] = tx[unit] = wx[b];
+        y[unit] = prev_y[unit] = ty[unit] = wy[b];
+        cursor[unit] = b;
+        speed[unit] = path_end[unit] - b > 1 ? unit_speed : 0;
+        if (speed[unit] > 0)
+            next_target(unit);
+    }
+
+    float advance(double dt) {
+        accum += dt;
+        uint32_t cnt = 0;
+        while (accum >= tick_s && cnt < max_ticks) {
+            tick();
+            accum -= tick_s;
+            cnt++;
+        }
+        if (accum >= tick_s)
+            accum = std::fmod(accum, tick_s);
+        return accum / tick_s;
+    }
+
+    void tick() {
+        arrived.clear();
+        uint32_t n = x.size();
+        float dt = tick_s;
+#if defined(__AVX2__)
+        for (uint32_t i = 0; i < n; i += 8)
+            tick_avx2(i, dt);
+#elif defined(__SSE2__)
+        for (uint32_t i = 0; i < n; i += 4)
+            tick_sse2(i, dt);
+#else
+        for (uint32_t i = 0; i < n; i++)
+            tick_one(i, dt);
+#endif
+        for (uint32_t u : arrived)
+            on_arrive(u);
+        ticks++;
+    }
+
+    float render_x(uint32_t unit, float alpha) const {
+        return prev_x[unit] + (x[unit] - prev_x[unit]) * alpha;
+    }
+    float render_y(uint32_t unit, float alpha) const {
+        return prev_y[unit] + (y[unit] - prev_y[unit]) * alpha;
+    }
+    float angle(uint32_t unit) const {
+        return vx[unit] || vy[unit] ? std::atan2(vy[unit], vx[unit]) : float(M_PI / 4);
+    }
+
+    bool moving(uint32_t unit) const { return speed[unit] > 0; }
+
+private:
+    std::vector<uint32_t> arrived;
+
+    void resize(uint32_t n) {
+        for (auto v : {&x, &y, &prev_x, &prev_y, &vx, &vy, &tx, &ty, &speed})
+            v->resize(n, 0);
+        for (auto v : {&cursor, &path_begin, &path_end})
+            v->resize(n, 0);
+        loop.resize(n, 0);
+    }
+
+    /* the unit is on it's target, the next waypoint becomes the target, false at the end */
+    bool next_target(uint32_t u) {
+        cursor[u]++;
+        if (cursor[u] >= path_end[u]) {
+            if (!loop[u]) {
+                speed[u] = 0;
+                vx[u] = vy[u] = 0;
+                return false;
+            }
+            /* back to the start, drawn there, not on the way to it */
+            cursor[u] = path_begin[u];
+            x[u] = prev_x[u] = wx[cursor[u]];
+            y[u] = prev_y[u] = wy[cursor[u]];
+            cursor[u]++;
+        }
+        tx[u] = wx[cursor[u]];
+        ty[u] = wy[cursor[u]];
+        return true;
+    }
+
+    /* the kernel put the unit on it's target, it goes on toward the next ones with the rest of
+    the step. A looped path starts a new lap when the cursor comes back to the first target, once
+    a whole lap was walked the other whole laps that fit in the rest are skipped, and if the lap
+    didn't use any of the step (the float rounding of tiny segments) the unit stays on the start
+    until the next step. */
+    void on_arrive(uint32_t u) {
+        float left = speed[u] * tick_s;
+        float sx = prev_x[u], sy = prev_y[u];
+        left -= std::hypot(x[u] - sx, y[u] - sy);
+        float lap_left = -1;
+        while (next_target(u)) {
+            if (cursor[u] == path_begin[u] + 1) {
+                if (lap_left >= 0) {
+                    float lap = lap_left - left;
+                    if (lap <= 0)
+                        return;
+                    left = std::fmod(left, lap);
+                }
+                lap_left = left;
+            }
+            float dx = tx[u] - x[u], dy = ty[u] - y[u];
+            float dist = std::sqrt(dx * dx + dy * dy);
+            if (dist >= left) {
+                if (dist > 0) {
+                    x[u] += dx * (left / dist);
+                    y[u] += dy * (left / dist);
+                    vx[u] = dx * (speed[u] / dist);
+                    vy[u] = dy * (speed[u] / dist);
+                }
+                return;
+            }
+            left -= dist;
+            x[u] = tx[u];
+            y[u] = ty[u];
+        }
+    }
+
+    void tick_one(uint32_t i, float dt) {
+        prev_x[i] = x[i];
+        prev_y[i] = y[i];
+        float dx = tx[i] - x[i], dy = ty[i] - y[i];
+        float dist = std::sqrt(dx * dx + dy * dy);
+        float step = speed[i] * dt;
+        if (step > dist) {
+            x[i] = tx[i];
+            y[i] = ty[i];
+            arrived.push_back(i);
+            return;
+        }
+        float inv = speed[i] / std::max(dist, 1e-6f);
+        vx[i] = dx * inv;
+        vy[i] = dy * inv;
+        x[i] += vx[i] * dt;
+        y[i] += vy[i] * dt;
+    }
+
+    void push_arrived(uint32_t first, uint32_t mask) {
+        while (mask) {
+            arrived.push_back(first + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+
+#if defined(__AVX2__)
+    void tick_avx2(uint32_t i, float dt) {
+        __m256 px = _mm256_loadu_ps(&x[i]), py = _mm256_loadu_ps(&y[i]);
+        _mm256_storeu_ps(&prev_x[i], px);
+        _mm256_storeu_ps(&prev_y[i], py);
+        __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(&tx[i]), px);
+        __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(&ty[i]), py);
+        __m256 dist = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)));
+        __m256 sp = _mm256_loadu_ps(&speed[i]);
+        __m256 vdt = _mm256_set1_ps(dt);
+        __m256 step = _mm256_mul_ps(sp, vdt);
+        __m256 arrive = _mm256_cmp_ps(step, dist, _CMP_GT_OQ);
+        __m256 inv = _mm256_div_ps(sp, _mm256_max_ps(dist, _mm256_set1_ps(1e-6f)));
+        __m256 nvx = _mm256_mul_ps(dx, inv), nvy = _mm256_mul_ps(dy, inv);
+        __m256 nx = _mm256_add_ps(px, _mm256_mul_ps(nvx, vdt));
+        __m256 ny = _mm256_add_ps(py, _mm256_mul_ps(nvy, vdt));
+
+        /* the arrived lanes keep their velocity and land on the target */
+        _mm256_storeu_ps(&vx[i], _mm256_blendv_ps(nvx, _mm256_loadu_ps(&vx[i]), arrive));
+        _mm256_storeu_ps(&vy[i], _mm256_blendv_ps(nvy, _mm256_loadu_ps(&vy[i]), arrive));
+        _mm256_storeu_ps(&x[i], _mm256_blendv_ps(nx, _mm256_loadu_ps(&tx[i]), arrive));
+        _mm256_storeu_ps(&y[i], _mm256_blendv_ps(ny, _mm256_loadu_ps(&ty[i]), arrive));
+        push_arrived(i, _mm256_movemask_ps(arrive));
+    }
+#endif
+
+#if defined(__SSE2__)
+    static __m128 select4(__m128 mask, __m128 a, __m128 b) {
+        return _mm_or_ps(_mm_and_ps(mask, b), _mm_andnot_ps(mask, a));
+    }
+
+    void tick_sse2(uint32_t i, float dt) {
+        __m128 px = _mm_loadu_ps(&x[i]), py = _mm_loadu_ps(&y[i]);
+        _mm_storeu_ps(&prev_x[i], px);
+        _mm_storeu_ps(&prev_y[i], py);
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(&tx[i]), px);
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(&ty[i]), py);
+        __m128 dist = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+        __m128 sp = _mm_loadu_ps(&speed[i]);
+        __m128 vdt = _mm_set1_ps(dt);
+        __m128 step = _mm_mul_ps(sp, vdt);
+        __m128 arrive = _mm_cmpgt_ps(step, dist);
+        __m128 inv = _mm_div_ps(sp, _mm_max_ps(dist, _mm_set1_ps(1e-6f)));
+        __m128 nvx = _mm_mul_ps(dx, inv), nvy = _mm_mul_ps(dy, inv);
+        __m128 nx = _mm_add_ps(px, _mm_mul_ps(nvx, vdt));
+        __m128 ny = _mm_add_ps(py, _mm_mul_ps(nvy, vdt));
+
+        _mm_storeu_ps(&vx[i], select4(arrive, nvx, _mm_loadu_ps(&vx[i])));
+        _mm_storeu_ps(&vy[i], select4(arrive, nvy, _mm_loadu_ps(&vy[i])));
+        _mm_storeu_ps(&x[i], select4(arrive, nx, _mm_loadu_ps(&tx[i])));
+        _mm_storeu_ps(&y[i], select4(arrive, ny, _mm_loadu_ps(&ty[i])));
+        push_arrived(i, _mm_movemask_ps(arrive));
+    }
+#endif
+
+    size_t live_waypoints() const {
+        size_t ret = 0;
+        for (uint32_t u = 0; u < unit_cnt; u++)
+            ret += path_end[u] - path_begin[u];
+        return ret;
+    }
+
+    void compact() {
+        std::vector<float> nwx, nwy;
+        nwx.reserve(live_waypoints());
+        nwy.reserve(live_waypoints());
+        for (uint32_t u = 0; u < unit_cnt; u++) {
+            uint32_t b = nwx.size();
+            nwx.insert(nwx.end(), wx.begin() + path_begin[u], wx.begin() + path_end[u]);
+            nwy.insert(nwy.end(), wy.begin() + path_begin[u], wy.begin() + path_end[u]);
+            cursor[u] = cursor[u] - path_begin[u] + b;
+            path_begin[u] = b;
+            path_end[u] = nwx.size();
+        }
+        wx = std::move(nwx);
+        wy = std::move(nwy);
+    }
+};
+
+#endif